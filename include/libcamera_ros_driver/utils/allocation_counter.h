@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+// heap allocations made by the calling thread so far, counted by the allocation counting library
+// (libLibcameraRosDriver_AllocationCounter.so) when it is loaded with LD_PRELOAD, empty without it
+std::optional<uint64_t>
+thread_allocations();
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/control_command.h>
+#include <libcamera_ros_driver/utils/frame.h>
+#include <libcamera_ros_driver/utils/latency_histogram.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <libcamera/controls.h>
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+
+// requested stream configuration, empty values are selected by the backend
+struct StreamRequest
+{
+  std::string     camera_name;
+  int             camera_id = 0;
+  std::string     stream_role;
+  std::string     pixel_format;
+  libcamera::Size size;
+};
+
+// source of camera frames used by the driver, the frames of every backend take the same processing path
+class CameraBackend {
+public:
+  using FrameCallback  = std::function<void(const FrameView &)>;
+  using CancelCallback = std::function<void(const std::string &)>;
+
+  virtual ~CameraBackend() = default;
+
+  // open the camera and configure its stream, returns the layout of the delivered frames,
+  // throws if the stream can not be configured; called again after stop() it reconfigures the stream
+  virtual StreamInfo configure(const StreamRequest &request) = 0;
+
+  // pixel formats the stream can be configured with, known after configure(), empty if the format is fixed
+  virtual std::vector<libcamera::PixelFormat> formats() const {
+    return {};
+  }
+
+  // controls supported by the camera, empty if it can not be controlled
+  virtual const libcamera::ControlInfoMap &controls() const = 0;
+
+  // control values applied to the first requests, they have to be validated against controls() before
+  virtual void setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &values) = 0;
+
+  // control values for the next request queued to the camera, replacing the values of the same controls that
+  // were not applied yet; may be called from any thread, the values have to be validated before, backends that
+  // can not be controlled per request ignore them
+  virtual void queueControls([[maybe_unused]] const ControlCommandValues &values) {
+  }
+
+  // start delivering frames, 'on_frame' is called for every completed frame and 'on_cancel' for every
+  // request that did not produce one, both from a thread of the backend, throws if the camera can not be started
+  virtual void start(const FrameCallback &on_frame, const CancelCallback &on_cancel) = 0;
+
+  // no callback is called after it returns
+  virtual void stop() = 0;
+
+  // identifier of the camera or the frame source
+  virtual std::string id() const = 0;
+
+  // requests queued to the camera and waiting for a frame, -1 if the backend has no request queue
+  virtual int queuedRequests() const {
+    return -1;
+  }
+
+  // receives the latencies of the steps of the backend, such as requeueing, has to be set before start()
+  void setHistograms(LatencyHistograms *histograms) {
+    histograms_ = histograms;
+  }
+
+protected:
+  LatencyHistograms *histograms_ = nullptr;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// capture file layout, all blocks are aligned to 'capture_alignment' so that the file can be written with O_DIRECT:
+//
+//   CaptureFileHeader   stream configuration and the serialized sensor_msgs/CameraInfo, 'header_size' bytes
+//   record 0..n-1       FrameRecordHeader followed by the frame data, 'record_size' bytes each
+//   index               CaptureIndexEntry for every written record, sorted by sequence number
+//   CaptureFileFooter   last bytes of the file, locates the index
+//
+// a file without footer (recording interrupted) can still be read by scanning the records
+
+static constexpr std::size_t capture_alignment = 4096;
+static constexpr uint32_t    capture_version   = 1;
+
+struct CaptureFileHeader
+{
+  char     magic[8];  // "LCRCAPT1"
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t record_size;
+  uint64_t frame_bytes;  // maximum frame size, data of every record is at most this long
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+  uint32_t fourcc;        // libcamera/DRM pixel format
+  uint64_t modifier;      // libcamera/DRM format modifier
+  char     encoding[32];  // ROS image encoding
+  char     frame_id[128];
+  uint32_t camera_info_offset;  // serialized sensor_msgs/CameraInfo inside the header block
+  uint32_t camera_info_size;
+  uint8_t  reserved[288];
+};
+
+static_assert(sizeof(CaptureFileHeader) == 512, "unexpected capture header size");
+
+// header at the start of every record, the frame data follows directly after it
+struct FrameRecordHeader
+{
+  char     magic[8];  // "LCRFRAME"
+  uint64_t sequence;
+  uint64_t timestamp;  // sensor timestamp [ns]
+  uint64_t record;     // position of the record in the file
+  uint32_t bytesused;
+  int32_t  exposure_time;    // [us], 0 if not reported
+  float    analogue_gain;    // 0 if not reported
+  int32_t  black_levels[4];  // R, Gr, Gb, B in 16-bit scale, 0 if not reported
+  uint32_t reserved;
+};
+
+static_assert(sizeof(FrameRecordHeader) == 64, "record header has to keep the frame data aligned");
+
+struct CaptureIndexEntry
+{
+  uint64_t sequence;
+  uint64_t timestamp;
+  uint64_t record;
+};
+
+struct CaptureFileFooter
+{
+  char     magic[8];  // "LCRINDEX"
+  uint64_t index_offset;
+  uint64_t count;
+  uint64_t reserved;
+};
+
+inline std::size_t
+capture_align(const std::size_t size)
+{
+  return (size + capture_alignment - 1) / capture_alignment * capture_alignment;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/capture_format.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sensor_msgs/CameraInfo.h>
+
+// view of a single frame inside the mapped capture file, valid as long as the reader exists
+struct CaptureFrame
+{
+  const FrameRecordHeader *header;
+  const uint8_t *          data;
+  std::size_t              size;
+};
+
+// read-only access to a capture file written by FrameRecorder, the file is memory-mapped and frames
+// are returned without copying, lookups by sequence number or timestamp are binary searches in the index
+class CaptureReader {
+public:
+  // throws if the file can not be mapped or is not a valid capture file
+  explicit CaptureReader(const std::string &path);
+  ~CaptureReader();
+
+  CaptureReader(const CaptureReader &) = delete;
+  CaptureReader &operator=(const CaptureReader &) = delete;
+
+  const CaptureFileHeader &header() const {
+    return *header_;
+  }
+
+  // number of frames, in the order of their sequence numbers
+  std::size_t size() const {
+    return count_;
+  }
+
+  // true if the index had to be rebuilt because the recording was interrupted
+  bool recovered() const {
+    return !recovered_index_.empty();
+  }
+
+  CaptureFrame frame(std::size_t index) const;
+
+  // frame with the given sequence number
+  std::optional<CaptureFrame> findSequence(uint64_t sequence) const;
+
+  // first frame with a timestamp at or after 'timestamp' [ns]
+  std::optional<CaptureFrame> findTimestamp(uint64_t timestamp) const;
+
+  // camera info recorded with the stream, empty if none was stored
+  std::optional<sensor_msgs::CameraInfo> cameraInfo() const;
+
+private:
+  void recoverIndex();
+
+  const uint8_t *          data_ = nullptr;
+  std::size_t              size_ = 0;
+  const CaptureFileHeader *header_;
+
+  const CaptureIndexEntry *      index_ = nullptr;
+  std::size_t                    count_ = 0;
+  std::vector<CaptureIndexEntry> recovered_index_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 3D colour look-up table stored in fixed point, as loaded from a .cube file
+struct ColorLut3D
+{
+  std::string  title;
+  unsigned int size = 0;  // number of grid points per axis
+
+  // grid entries {r, g, b} with red varying fastest, values scaled to [0, 255 << 8], followed by one zero element
+  // so that the SIMD kernels can load any entry with a 32-bit or 64-bit read
+  std::vector<uint16_t> table;
+
+  // per-channel grid offsets (in table elements) and interpolation weights (in [0, 256]) for every 8-bit input value
+  std::array<uint32_t, 256> offset_r;
+  std::array<uint32_t, 256> offset_g;
+  std::array<uint32_t, 256> offset_b;
+  std::array<uint32_t, 256> weight;
+};
+
+// vertices (as offsets into the table) and weights of the tetrahedron a pixel is interpolated from, the cell is
+// split along its main diagonal into six tetrahedra; the weights sum up to 256
+struct LutTetrahedron
+{
+  uint32_t c000, c1, c2, c111;
+  uint32_t w0, w1, w2, w3;
+};
+
+inline LutTetrahedron
+lut_tetrahedron(const ColorLut3D &lut, const uint8_t r, const uint8_t g, const uint8_t b)
+{
+  const uint32_t sr = 3;
+  const uint32_t sg = 3 * lut.size;
+  const uint32_t sb = 3 * lut.size * lut.size;
+
+  const uint32_t c000 = lut.offset_r[r] + lut.offset_g[g] + lut.offset_b[b];
+  const uint32_t fr   = lut.weight[r];
+  const uint32_t fg   = lut.weight[g];
+  const uint32_t fb   = lut.weight[b];
+
+  // the first step is along the axis of the largest weight, the second one along the axis of the middle weight
+  if (fr >= fg) {
+    if (fg >= fb)
+      return {c000, c000 + sr, c000 + sr + sg, c000 + sr + sg + sb, 256 - fr, fr - fg, fg - fb, fb};
+    if (fr >= fb)
+      return {c000, c000 + sr, c000 + sr + sb, c000 + sr + sg + sb, 256 - fr, fr - fb, fb - fg, fg};
+    return {c000, c000 + sb, c000 + sr + sb, c000 + sr + sg + sb, 256 - fb, fb - fr, fr - fg, fg};
+  }
+
+  if (fb >= fg)
+    return {c000, c000 + sb, c000 + sg + sb, c000 + sr + sg + sb, 256 - fb, fb - fg, fg - fr, fr};
+  if (fb >= fr)
+    return {c000, c000 + sg, c000 + sg + sb, c000 + sr + sg + sb, 256 - fg, fg - fb, fb - fr, fr};
+  return {c000, c000 + sg, c000 + sr + sg, c000 + sr + sg + sb, 256 - fg, fg - fr, fr - fb, fb};
+}
+
+ColorLut3D
+load_cube_lut(const std::string &path);
+
+// LUT of 'size' grid points per axis from its grid entries in the layout of ColorLut3D::table (without the padding),
+// throws if the number of entries does not match
+ColorLut3D
+make_color_lut(unsigned int size, std::vector<uint16_t> table);
+
+// apply the LUT to 'height' rows of 'width' interleaved 8-bit pixels with 'channels' (3 or 4) bytes each,
+// 'bgr' selects the channel order of the first three bytes, a fourth (alpha) channel is copied unchanged;
+// the rows are processed by the apply_lut_row kernel of kernels()
+void
+apply_color_lut(const ColorLut3D &lut, const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int width,
+                unsigned int height, unsigned int channels, bool bgr);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/frame.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class CompletionStatus
+{
+  COMPLETE,
+  CANCELLED,
+};
+
+// one completed request, the completion time and the sensor timestamp are both CLOCK_MONOTONIC so that
+// a replay keeps the delay between the exposure and the completion
+struct CompletionRecord
+{
+  uint64_t         completion = 0;  // [ns] time the frame reached the driver
+  uint64_t         sequence   = 0;  // frame sequence number, 0 for cancelled requests
+  CompletionStatus status     = CompletionStatus::COMPLETE;
+  std::size_t      bytesused  = 0;  // [bytes] 0 for cancelled requests
+  uint64_t         timestamp  = 0;  // [ns] sensor timestamp, 0 for cancelled requests
+};
+
+// writes the request completions as a text file with one comma separated record per line:
+//   completion,sequence,status,bytesused,timestamp
+// where the status is "complete" or "cancelled", lines starting with '#' are comments
+class CompletionTraceWriter {
+public:
+  // throws if the file can not be created
+  CompletionTraceWriter(const std::string &path, const std::string &comment);
+
+  // record a completed frame or a cancelled request at the current time, safe to call from any thread
+  void complete(const FrameView &frame);
+  void cancelled();
+
+  std::size_t records() const {
+    return records_;
+  }
+
+private:
+  void write(const CompletionRecord &record);
+
+  std::mutex    mutex_;
+  std::ofstream file_;
+  std::size_t   records_ = 0;
+};
+
+// reads a trace written by CompletionTraceWriter, throws on a malformed or empty file
+std::vector<CompletionRecord>
+load_completion_trace(const std::string &path);
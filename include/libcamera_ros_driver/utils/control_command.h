@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+#include <libcamera/controls.h>
+
+// controls that can be commanded for every frame, each maps to one libcamera control of a fixed type
+enum class ControlSlot
+{
+  EXPOSURE_TIME,          // int32 [us]
+  ANALOGUE_GAIN,          // float
+  FRAME_DURATION_LIMITS,  // int64[2] [us]
+  COLOUR_GAINS,           // float[2], red and blue
+};
+
+static constexpr std::size_t control_slot_count = 4;
+
+std::string
+to_string(ControlSlot slot);
+
+// libcamera control of a slot
+const libcamera::ControlId &
+control_slot_id(ControlSlot slot);
+
+// values of one command, only the slots that are set are applied, fixed size so that commands can be
+// passed between threads without allocating
+struct ControlCommandValues
+{
+  std::array<bool, control_slot_count>                  set{};
+  std::array<std::array<double, 2>, control_slot_count> values{};  // scalar slots only use the first element
+
+  bool empty() const;
+};
+
+// the value of a slot as a control value of the type of its libcamera control
+libcamera::ControlValue
+control_slot_value(ControlSlot slot, const std::array<double, 2> &value);
+
+// type, extent and limits of the slots, resolved once against the controls of a camera, so that a command
+// is validated in constant time without looking up the controls by name or comparing control values
+class ControlDescriptors {
+public:
+  explicit ControlDescriptors(const libcamera::ControlInfoMap &controls);
+
+  // whether the camera has the control of the slot with the expected type and extent
+  bool available(ControlSlot slot) const {
+    return descriptors_[std::size_t(slot)].available;
+  }
+
+  // drops the slots the camera does not have and clamps the others to the limits of the camera, returns the
+  // number of clamped values
+  unsigned int validate(ControlCommandValues &values) const;
+
+private:
+  struct descriptor_t
+  {
+    bool   available = false;
+    double min       = 0.0;
+    double max       = 0.0;  // not checked if it is not larger than the minimum, some cameras report 0 for unlimited
+  };
+
+  std::array<descriptor_t, control_slot_count> descriptors_;
+};
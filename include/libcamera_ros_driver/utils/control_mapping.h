@@ -10,3 +10,5 @@ libcamera::controls::AeMeteringModeEnum get_ae_metering_mode(const std::string &
 libcamera::controls::AeConstraintModeEnum get_ae_constraint_mode(const std::string &mode);
 
 libcamera::controls::AwbModeEnum get_awb_mode(const std::string &mode);
+
+libcamera::controls::draft::TestPatternModeEnum get_test_pattern_mode(const std::string &mode);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcamera/geometry.h>
+
+namespace libcamera
+{
+class PixelFormat;
+}
+
+enum class RawPacking
+{
+  NONE,   // one byte per sample up to 8 bits, two little-endian bytes otherwise
+  CSI2P,  // MIPI CSI-2 packed, 4 samples in 5 bytes for 10 bits, 2 in 3 for 12 bits and 4 in 7 for 14 bits
+};
+
+// sample layout of a raw Bayer pixel format
+struct RawLayout
+{
+  BayerOrder   order;
+  unsigned int bits;  // significant bits of a sample
+  RawPacking   packing;
+};
+
+// layout of the Bayer formats that can be written as DNG, empty for other formats
+std::optional<RawLayout>
+get_raw_layout(const libcamera::PixelFormat &pixelformat);
+
+// frames written by a DNG writer
+struct DngStream
+{
+  libcamera::Size size;
+  unsigned int    stride = 0;
+  RawLayout       layout;
+  std::string     camera_model;
+};
+
+// sensor metadata of a frame, stored in the tags of its file
+struct DngFrameInfo
+{
+  uint64_t sequence  = 0;
+  uint64_t timestamp = 0;  // sensor timestamp [ns]
+
+  std::optional<int32_t>                exposure_time;  // [us]
+  std::optional<float>                  analogue_gain;
+  std::optional<std::array<int32_t, 4>> black_levels;   // R, Gr, Gb, B in 16-bit scale
+  std::optional<std::array<float, 2>>   colour_gains;   // red, blue
+  std::optional<std::array<float, 9>>   colour_matrix;  // white balanced camera RGB to sRGB, row-major
+};
+
+// writes raw Bayer frames as uncompressed DNG files from a dedicated thread, frames are copied into a bounded
+// set of slots so that the camera buffer can be reused immediately, the writer streams the rows from the slot
+// into the file and unpacks CSI-2 packed samples to 16 bits on the way
+class DngWriter {
+public:
+  DngWriter(const DngStream &stream, std::size_t frame_bytes, unsigned int slots);
+
+  // the queued frames are written before it returns
+  ~DngWriter();
+
+  DngWriter(const DngWriter &) = delete;
+  DngWriter &operator=(const DngWriter &) = delete;
+
+  // copy a frame into a free slot and queue it to be written to 'path', the file appears under its name once
+  // it is complete; returns false and counts a drop if all slots are in use
+  bool push(const uint8_t *data, std::size_t size, const DngFrameInfo &info, const std::string &path);
+
+  const DngStream &stream() const {
+    return stream_;
+  }
+
+  uint64_t written() const {
+    return written_;
+  }
+
+  uint64_t dropped() const {
+    return dropped_;
+  }
+
+  uint64_t failed() const {
+    return failed_;
+  }
+
+private:
+  struct slot_t
+  {
+    std::vector<uint8_t> data;
+    std::size_t          size = 0;
+    DngFrameInfo         info;
+    std::string          path;
+  };
+
+  void writer();
+  bool write(const slot_t &slot);
+
+  const DngStream   stream_;
+  const std::size_t frame_bytes_;
+
+  std::vector<slot_t> slots_;
+
+  std::mutex              mutex_;
+  std::condition_variable filled_cv_;
+  std::vector<slot_t *>   free_;
+  std::deque<slot_t *>    filled_;
+  bool                    stop_ = false;
+
+  std::vector<uint8_t> chunk_;  // rows unpacked by the writer thread
+
+  std::thread thread_;
+
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> failed_{0};
+};
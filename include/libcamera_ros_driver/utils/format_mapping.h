@@ -2,6 +2,7 @@
 
 #include <libcamera/stream.h>
 #include <string>
+#include <vector>
 
 namespace libcamera
 {
@@ -13,6 +14,7 @@ enum class FormatType
   NONE,
   RAW,
   COMPRESSED,
+  PACKED,  // raw formats that are not published
 };
 
 std::string
@@ -21,5 +23,13 @@ get_ros_encoding(const libcamera::PixelFormat &pixelformat);
 FormatType
 format_type(const libcamera::PixelFormat &pixelformat);
 
+// size of a single pixel of a raw format in bytes, 0 for compressed and unsupported formats
+unsigned int
+get_bytes_per_pixel(const libcamera::PixelFormat &pixelformat);
+
+// raw formats that are published without conversion
+std::vector<libcamera::PixelFormat>
+get_raw_formats();
+
 libcamera::StreamFormats
 get_common_stream_formats(const libcamera::StreamFormats &formats);
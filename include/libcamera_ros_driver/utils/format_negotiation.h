@@ -0,0 +1,34 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <libcamera/pixel_format.h>
+
+// what the subscribers of the image stream need
+struct FormatDemand
+{
+  bool                     raw = false;  // the raw transport has subscribers
+  std::vector<std::string> encodings;    // ROS encodings the raw subscribers convert the images to
+  std::vector<std::string> transports;   // other image transports with subscribers, they encode 8-bit mono or BGR images
+  std::vector<std::string> derived;      // encodings outputs computed in the driver read best, such as the tensor
+
+  bool empty() const {
+    return !raw && transports.empty() && derived.empty();
+  }
+};
+
+// estimated CPU cost of converting one pixel between two ROS encodings, in bytes read and written, weighted by the
+// complexity of the conversion; conversions that lose colour are penalised far above any real conversion
+double
+conversion_cost(const std::string &from, const std::string &to);
+
+// estimated CPU cost per pixel of publishing 'format' and of every conversion the demand causes in the driver,
+// the transports and the subscribers
+double
+format_cost(const libcamera::PixelFormat &format, const FormatDemand &demand);
+
+// the cheapest of 'formats' for the demand, empty if there is no format or no demand
+std::optional<libcamera::PixelFormat>
+select_format(const std::vector<libcamera::PixelFormat> &formats, const FormatDemand &demand);
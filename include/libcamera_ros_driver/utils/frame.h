@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+
+// layout of the frames of the configured stream
+struct StreamInfo
+{
+  libcamera::PixelFormat format;
+  libcamera::Size        size;
+  unsigned int           stride      = 0;
+  std::size_t            frame_bytes = 0;  // size of the largest frame buffer
+};
+
+// completed frame handed to the processing pipeline, the data is only valid during the call
+struct FrameView
+{
+  const uint8_t *data      = nullptr;
+  std::size_t    size      = 0;  // bytes used
+  uint64_t       sequence  = 0;
+  uint64_t       timestamp = 0;  // sensor timestamp [ns]
+  const void *   request   = nullptr;  // identifies the request or buffer of the backend in traces
+
+  // metadata reported with the frame
+  std::optional<int32_t>                exposure_time;  // [us]
+  std::optional<float>                  analogue_gain;
+  std::optional<std::array<int32_t, 4>> black_levels;   // R, Gr, Gb, B in 16-bit scale
+  std::optional<std::array<float, 2>>   colour_gains;   // red, blue
+  std::optional<std::array<float, 9>>   colour_matrix;  // white balanced camera RGB to sRGB, row-major
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/capture_reader.h>
+#include <libcamera_ros_driver/utils/frame.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sensor_msgs/CameraInfo.h>
+
+enum class PlaybackPacing
+{
+  REALTIME,  // frames are delivered with their recorded timestamp differences
+  FAST,      // frames are delivered as fast as the callback returns
+};
+
+// replays recorded frames from a dedicated thread in place of a camera, the source is either a capture
+// file written by FrameRecorder or a directory of raw frame files (one frame per file, in file name order)
+class FramePlayback {
+public:
+  // a capture file carries its stream layout and metadata, raw files are described by 'raw_stream' and are
+  // timestamped with 'raw_fps', throws if the source can not be opened or does not match the layout
+  FramePlayback(const std::string &path, const StreamInfo &raw_stream, double raw_fps);
+  ~FramePlayback();
+
+  FramePlayback(const FramePlayback &) = delete;
+  FramePlayback &operator=(const FramePlayback &) = delete;
+
+  const StreamInfo &stream() const {
+    return stream_;
+  }
+
+  // camera info stored in the capture file
+  std::optional<sensor_msgs::CameraInfo> cameraInfo() const;
+
+  std::size_t frames() const {
+    return reader_ ? reader_->size() : files_.size();
+  }
+
+  // deliver all frames to 'callback', when looping the sequence numbers and timestamps continue across the repetitions
+  void start(const std::function<void(const FrameView &)> &callback, PlaybackPacing pacing, bool loop);
+
+  void stop();
+
+  bool running() const {
+    return running_;
+  }
+
+  uint64_t played() const {
+    return played_;
+  }
+
+  // frames that are shorter than the stream layout
+  uint64_t skipped() const {
+    return skipped_;
+  }
+
+private:
+  void player();
+  bool load(std::size_t index, FrameView &frame);
+
+  StreamInfo stream_;
+
+  std::unique_ptr<CaptureReader> reader_;
+  std::vector<std::string>       files_;
+  std::vector<uint8_t>           file_buffer_;
+  uint64_t                       file_interval_ = 0;  // [ns]
+
+  std::function<void(const FrameView &)> callback_;
+  PlaybackPacing                         pacing_ = PlaybackPacing::REALTIME;
+  bool                                   loop_   = false;
+
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable stop_cv_;
+  bool                    stop_ = false;
+  std::atomic<bool>       running_{false};
+
+  std::atomic<uint64_t> played_{0};
+  std::atomic<uint64_t> skipped_{0};
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/allocation_counter.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// stages of the frame path, in the order they are run
+enum class FrameStage
+{
+  RECORD,       // copy into the recorder
+  CONVERT,      // colour LUT, raw correction or copy into the message
+  DENOISE,      // temporal denoise
+  CAMERA_INFO,  // camera info message
+  PUBLISH,      // image transport publish
+  TOTAL,        // whole frame
+};
+
+static constexpr std::size_t frame_stage_count = 6;
+
+std::string
+to_string(FrameStage stage);
+
+std::optional<FrameStage>
+frame_stage_from_string(const std::string &name);
+
+struct StageStats
+{
+  uint64_t frames          = 0;
+  uint64_t nanoseconds     = 0;  // wall-clock time
+  uint64_t cpu_nanoseconds = 0;  // CPU time of the frame thread, without the time it was preempted or blocked
+  uint64_t bytes           = 0;
+  uint64_t max             = 0;  // [ns] slowest frame, wall-clock time
+  uint64_t allocations     = 0;  // heap allocations, only counted with the allocation counting library
+
+  double msPerFrame() const {
+    return frames ? 1e-6 * nanoseconds / frames : 0.0;
+  }
+
+  double cpuMsPerFrame() const {
+    return frames ? 1e-6 * cpu_nanoseconds / frames : 0.0;
+  }
+
+  double allocationsPerFrame() const {
+    return frames ? double(allocations) / frames : 0.0;
+  }
+
+  double bytesPerSecond() const {
+    return nanoseconds ? 1e9 * bytes / nanoseconds : 0.0;
+  }
+};
+
+// per-stage time and throughput of the frame path, stages are added from the frame thread and
+// collected from another one
+class FrameProfiler {
+public:
+  void add(FrameStage stage, uint64_t nanoseconds, uint64_t cpu_nanoseconds, std::size_t bytes, uint64_t allocations);
+
+  // whether the heap allocations of the stages are counted (see allocation_counter.h)
+  bool countsAllocations() const {
+    return counts_allocations_;
+  }
+
+  // statistics since the previous call
+  std::array<StageStats, frame_stage_count> collect();
+
+private:
+  struct counters_t
+  {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> cpu_nanoseconds{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> max{0};
+    std::atomic<uint64_t> allocations{0};
+  };
+
+  std::array<counters_t, frame_stage_count> counters_;
+  const bool                                counts_allocations_ = thread_allocations().has_value();
+};
+
+class LatencyHistograms;
+
+// measures consecutive stages of one frame into the profiler and the latency histograms, does nothing
+// without either of them; the histograms get the wall-clock time, the profiler also the CPU time of the thread
+class StageTimer {
+public:
+  StageTimer(FrameProfiler *profiler, LatencyHistograms *histograms);
+
+  // record the time since the previous lap as 'stage'
+  void lap(FrameStage stage, std::size_t bytes);
+
+  // record the time since the construction as the total of the frame
+  void finish(std::size_t bytes);
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  FrameProfiler *    profiler_;
+  LatencyHistograms *histograms_;
+  clock::time_point  start_;
+  clock::time_point  last_;
+  uint64_t           start_cpu_         = 0;
+  uint64_t           last_cpu_          = 0;
+  uint64_t           start_allocations_ = 0;
+  uint64_t           last_allocations_  = 0;
+};
+
+// reference timings of the frame path in one configuration, stages without a reference are 0
+struct PerformanceBaseline
+{
+  double                                calibration = 0.0;  // [ms] duration of calibrate_machine() where the baseline was taken
+  std::array<double, frame_stage_count> ms_per_frame{};     // CPU time
+};
+
+// runs a fixed workload with the memory and arithmetic profile of the frame conversions and returns
+// its fastest duration [ms], the ratio between two machines scales a baseline from one to the other
+double
+calibrate_machine();
+
+// writes the baseline as a parameter file loadable under the namespace of the driver
+void
+save_baseline(const std::string &path, const PerformanceBaseline &baseline, const std::string &comment);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/capture_format.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// writes frames into a capture file (see capture_format.h) from a dedicated thread, frames are copied into a
+// bounded set of page-aligned slots so that the camera buffer can be reused immediately, the slots are written
+// with io_uring and O_DIRECT when available
+class FrameRecorder {
+public:
+  FrameRecorder(std::size_t frame_bytes, unsigned int slots);
+  ~FrameRecorder();
+
+  FrameRecorder(const FrameRecorder &) = delete;
+  FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+  // open a new capture file and write its header, 'header' describes the stream and 'camera_info' is the
+  // serialized sensor_msgs/CameraInfo, throws if the file can not be created
+  void start(const std::string &path, const CaptureFileHeader &header, const std::vector<uint8_t> &camera_info);
+
+  // write all queued frames, the index and close the file
+  void stop();
+
+  bool recording() const {
+    return recording_;
+  }
+
+  // copy a frame into a free slot and queue it for writing, 'header' carries the frame metadata,
+  // returns false and counts a drop if all slots are in use
+  bool push(const uint8_t *data, std::size_t size, const FrameRecordHeader &header);
+
+  std::size_t recordSize() const {
+    return record_size_;
+  }
+
+  uint64_t written() const {
+    return written_;
+  }
+
+  uint64_t dropped() const {
+    return dropped_;
+  }
+
+  uint64_t failed() const {
+    return failed_;
+  }
+
+private:
+  struct slot_t
+  {
+    uint8_t *   data;
+    std::size_t length;
+  };
+
+  void writer();
+  void writeIndex(uint64_t records);
+
+  const std::size_t      frame_bytes_;
+  const std::size_t      record_size_;
+  std::vector<uint8_t *> buffers_;
+
+  std::mutex              mutex_;
+  std::condition_variable filled_cv_;
+  std::vector<uint8_t *>  free_;
+  std::deque<slot_t>      filled_;
+  bool                    stop_ = false;
+
+  std::vector<CaptureIndexEntry> index_;  // only accessed by the writer thread
+
+  std::thread       thread_;
+  int               fd_ = -1;
+  std::atomic<bool> recording_{false};
+
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> failed_{0};
+};
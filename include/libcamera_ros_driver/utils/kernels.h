@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ColorLut3D;
+
+enum class KernelBackend
+{
+  SCALAR,
+  SSE4,
+  AVX2,
+  NEON,
+};
+
+// table of pixel kernels of one instruction set, every entry has to produce the same output as the scalar reference,
+// which the test_kernels test checks for every backend compiled for and supported by the machine it runs on
+struct Kernels
+{
+  KernelBackend backend;
+
+  // copy 'height' rows of 'row_bytes' bytes between images of different strides
+  void (*copy_rows)(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, std::size_t row_bytes, unsigned int height);
+
+  // saturating subtraction of 'level_even' from the even and of 'level_odd' from the odd samples of a row
+  void (*subtract_row_u8)(const uint8_t *src, uint8_t *dst, unsigned int width, uint8_t level_even, uint8_t level_odd);
+  void (*subtract_row_u16)(const uint16_t *src, uint16_t *dst, unsigned int width, uint16_t level_even, uint16_t level_odd);
+
+  // motion-adaptive blend of a row with its history (see TemporalDenoise), the history is updated with the output
+  void (*blend_row_u8)(const uint8_t *src, uint8_t *dst, uint8_t *history, unsigned int n, uint8_t strength, uint8_t threshold, uint16_t slope);
+
+  // tetrahedral interpolation of a row of 'width' pixels with 'channels' (3 or 4) bytes in the 3D LUT (see apply_color_lut)
+  void (*apply_lut_row)(const ColorLut3D &lut, const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int channels, bool bgr);
+
+  // vertical step of a bilinear resize: row0 * (256 - weight) + row1 * weight with 8 fractional bits, 'weight' in [0, 256]
+  void (*lerp_rows_u8)(const uint8_t *row0, const uint8_t *row1, uint16_t *dst, unsigned int n, uint16_t weight);
+
+  // vertical step of a box downscale: adds a row of samples to the sums
+  void (*accumulate_row_u8)(const uint8_t *src, uint32_t *sums, unsigned int n);
+
+  // conversion to float: src * scale + offset per element as a fused multiply-add (rounded once)
+  void (*normalize_row_f32)(const uint16_t *src, float *dst, unsigned int n, const float *scale, const float *offset);
+};
+
+// backend tables, nullptr if the backend was not compiled for the current architecture
+const Kernels *
+kernels_scalar();
+const Kernels *
+kernels_sse4();
+const Kernels *
+kernels_avx2();
+const Kernels *
+kernels_neon();
+
+// table of a backend, nullptr if it was not compiled for the current architecture
+const Kernels *
+kernels_for(const KernelBackend backend);
+
+// kernels used by the frame path, the widest backend supported by the CPU unless overridden
+const Kernels &
+kernels();
+
+// force a backend ("auto", "scalar", "sse4", "avx2", "neon"), throws if it is unknown or unsupported by the CPU
+void
+select_kernel_backend(const std::string &name);
+
+// backends that are compiled in and supported by the CPU
+std::vector<KernelBackend>
+available_kernel_backends();
+
+std::string
+to_string(const KernelBackend backend);
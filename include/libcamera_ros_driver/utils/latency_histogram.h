@@ -0,0 +1,83 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/frame_profiler.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// stages with a latency distribution, the first ones are the stages of the frame profiler in the same order
+enum class LatencyStage
+{
+  RECORD,
+  CONVERT,
+  DENOISE,
+  CAMERA_INFO,
+  PUBLISH,
+  PROCESSING,          // whole frame path of the driver
+  SENSOR_TO_CALLBACK,  // sensor timestamp to the start of the frame path
+  END_TO_END,          // sensor timestamp to the end of publishing
+  REQUEUE,             // handing the request back to the camera
+};
+
+static constexpr std::size_t latency_stage_count = 9;
+
+static_assert(std::size_t(LatencyStage::PROCESSING) == std::size_t(FrameStage::TOTAL), "the frame stages have to map onto the latency stages");
+
+std::string
+to_string(LatencyStage stage);
+
+struct LatencySummary
+{
+  uint64_t count = 0;
+  uint64_t p50   = 0;  // [ns]
+  uint64_t p99   = 0;  // [ns]
+  uint64_t p999  = 0;  // [ns]
+  uint64_t max   = 0;  // [ns]
+};
+
+// lock-free log-linear histogram of durations in the style of HdrHistogram: every power of two is split
+// into 32 buckets, so the relative error is below 3 % from 1 ns up to 18 minutes; recording is a bucket
+// index computation and two relaxed atomic operations
+class LatencyHistogram {
+public:
+  void record(uint64_t nanoseconds);
+
+  // percentiles of the recorded values, concurrent records may or may not be included
+  LatencySummary summary() const;
+
+  void reset();
+
+private:
+  static constexpr unsigned int sub_bucket_bits = 5;
+  static constexpr unsigned int max_bits        = 40;
+  static constexpr std::size_t  bucket_count    = (max_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+  static std::size_t bucketIndex(uint64_t value);
+  static uint64_t    bucketValue(std::size_t index);
+
+  std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+  std::atomic<uint64_t>                           max_{0};
+};
+
+// one histogram per stage
+class LatencyHistograms {
+public:
+  void record(const LatencyStage stage, const uint64_t nanoseconds) {
+    histograms_[std::size_t(stage)].record(nanoseconds);
+  }
+
+  const LatencyHistogram &operator[](const LatencyStage stage) const {
+    return histograms_[std::size_t(stage)];
+  }
+
+  void reset() {
+    for (LatencyHistogram &histogram : histograms_) {
+      histogram.reset();
+    }
+  }
+
+private:
+  std::array<LatencyHistogram, latency_stage_count> histograms_;
+};
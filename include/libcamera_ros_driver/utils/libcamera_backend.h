@@ -0,0 +1,77 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/camera_backend.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <libcamera/libcamera.h>
+
+// frames of a libcamera camera, every buffer is memory-mapped once and handed out without copying
+class LibcameraBackend : public CameraBackend {
+public:
+  LibcameraBackend();
+  ~LibcameraBackend() override;
+
+  LibcameraBackend(const LibcameraBackend &) = delete;
+  LibcameraBackend &operator=(const LibcameraBackend &) = delete;
+
+  StreamInfo configure(const StreamRequest &request) override;
+
+  const libcamera::ControlInfoMap &controls() const override;
+
+  void setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &values) override;
+
+  void queueControls(const ControlCommandValues &values) override;
+
+  void start(const FrameCallback &on_frame, const CancelCallback &on_cancel) override;
+
+  void stop() override;
+
+  std::string id() const override;
+
+  std::vector<libcamera::PixelFormat> formats() const override {
+    return formats_;
+  }
+
+  int queuedRequests() const override {
+    return queued_;
+  }
+
+private:
+  void requestComplete(libcamera::Request *request);
+
+  // selects and acquires the camera of the request
+  void openCamera(const StreamRequest &request);
+
+  // unmaps and frees the buffers of the stream and their requests
+  void releaseBuffers();
+
+  std::unique_ptr<libcamera::CameraManager>        camera_manager_;
+  std::shared_ptr<libcamera::Camera>               camera_;
+  libcamera::Stream *                              stream_ = nullptr;
+  std::shared_ptr<libcamera::FrameBufferAllocator> allocator_;
+  std::vector<std::unique_ptr<libcamera::Request>> requests_;
+  std::mutex                                       request_lock_;
+  std::atomic<int>                                 queued_{0};
+  std::vector<libcamera::PixelFormat>              formats_;
+
+  // commanded controls for the next requeued request, the requests lose their controls when they are reused
+  ControlCommandValues pending_controls_;
+  std::mutex           pending_controls_mutex_;
+
+  struct buffer_info_t
+  {
+    void * data;
+    size_t size;
+  };
+  std::unordered_map<const libcamera::FrameBuffer *, buffer_info_t> buffer_info_;
+
+  FrameCallback  on_frame_;
+  CancelCallback on_cancel_;
+  bool           acquired_ = false;
+  bool           started_  = false;
+};
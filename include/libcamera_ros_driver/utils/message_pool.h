@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+// reusable messages for a publisher: a message is handed out again once every subscriber and the
+// publisher queue released it, so that its buffers keep their capacity and a steady stream of
+// messages of the same size does not allocate; publishing the shared pointer also lets intra-process
+// subscribers take the message without a copy
+//
+// acquire() has to be called from a single thread, the other holders only release messages
+template <typename M>
+class MessagePool {
+public:
+  explicit MessagePool(const std::size_t size) : size_(size) {
+    messages_.reserve(size_);
+  }
+
+  boost::shared_ptr<M> acquire() {
+    for (std::size_t i = 0; i < messages_.size(); i++) {
+      const std::size_t index = (next_ + i) % messages_.size();
+      if (messages_[index].use_count() == 1) {
+        next_ = index + 1;
+        return messages_[index];
+      }
+    }
+
+    boost::shared_ptr<M> message = boost::make_shared<M>();
+
+    // all messages are in flight, a full pool hands out a message that is not reused
+    if (messages_.size() < size_) {
+      messages_.push_back(message);
+      next_ = messages_.size();
+    }
+
+    return message;
+  }
+
+private:
+  const std::size_t                 size_;
+  std::vector<boost::shared_ptr<M>> messages_;
+  std::size_t                       next_ = 0;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// downscales 8-bit mono, RGB and BGR images (with or without alpha) by an integer factor with a box filter
+// and encodes them as JPEG, the buffers are reused between the frames; every image is encoded into one of
+// 'buffers' JPEG buffers that is no longer held by the server, so that handing it over does not copy or allocate
+class PreviewEncoder {
+public:
+  // throws if the driver was built without libjpeg
+  PreviewEncoder(unsigned int max_width, int quality, unsigned int buffers = 4);
+
+  // whether the driver was built with libjpeg
+  static bool available();
+
+  // whether images of a ROS encoding can be encoded
+  static bool supports(const std::string &encoding);
+
+  // the returned buffer is reused once it is released, throws if the encoding is not supported; has to be called from a
+  // single thread, the server only releases the buffers
+  std::shared_ptr<const std::vector<uint8_t>> encode(const uint8_t *src, std::size_t src_step, unsigned int width, unsigned int height,
+                                                     const std::string &encoding);
+
+private:
+  template <unsigned int SRC_CHANNELS, bool BGR>
+  void downscale(const uint8_t *src, std::size_t src_step, unsigned int factor, unsigned int dst_width, unsigned int dst_height);
+
+  // a buffer that only the encoder holds, a new one that is not reused if all of them are still sent
+  std::shared_ptr<std::vector<uint8_t>> acquire();
+
+  const unsigned int max_width_;
+  const int          quality_;
+
+  std::vector<uint32_t>                              sums_;    // of the source samples of one row of blocks
+  std::vector<uint8_t>                               pixels_;  // downscaled mono or RGB image
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> jpegs_;
+  std::size_t                                        next_jpeg_ = 0;
+};
+
+// minimal HTTP/1.0 server of a multipart MJPEG stream, the frames are handed over by publish() and sent by
+// one thread per client, slow clients skip frames instead of delaying the caller
+//
+//   /          the stream
+//   /stream    the stream
+//   /snapshot  the next frame as a single image
+class MjpegServer {
+public:
+  // throws if the socket can not be bound
+  MjpegServer(const std::string &address, uint16_t port, unsigned int max_clients);
+  ~MjpegServer();
+
+  MjpegServer(const MjpegServer &) = delete;
+  MjpegServer &operator=(const MjpegServer &) = delete;
+
+  // of the bound socket, the one chosen by the system for port 0
+  uint16_t port() const {
+    return port_;
+  }
+
+  // clients waiting for frames, nothing has to be encoded without them
+  unsigned int clients() const {
+    return clients_.load(std::memory_order_relaxed);
+  }
+
+  void publish(std::shared_ptr<const std::vector<uint8_t>> jpeg);
+
+private:
+  struct client_t
+  {
+    int               fd = -1;
+    std::thread       thread;
+    std::atomic<bool> done{false};
+  };
+
+  void acceptor();
+  void serve(client_t &client);
+
+  // waits for a frame newer than 'sequence', null once the server stops
+  std::shared_ptr<const std::vector<uint8_t>> next(uint64_t &sequence);
+
+  int          listen_fd_  = -1;
+  int          wake_fd_[2] = {-1, -1};  // pipe that interrupts the acceptor
+  uint16_t     port_       = 0;
+  unsigned int max_clients_;
+
+  std::thread               acceptor_;
+  std::list<client_t>       connections_;  // only touched by the acceptor until it is joined
+  std::atomic<unsigned int> clients_{0};
+
+  std::mutex                                  mutex_;
+  std::condition_variable                     frame_cv_;
+  std::shared_ptr<const std::vector<uint8_t>> frame_;
+  uint64_t                                    sequence_ = 0;
+  bool                                        stop_     = false;
+};
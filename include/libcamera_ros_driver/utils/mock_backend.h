@@ -0,0 +1,88 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/camera_backend.h>
+#include <libcamera_ros_driver/utils/completion_trace.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <libcamera/controls.h>
+#include <libcamera/pixel_format.h>
+
+struct MockBackendOptions
+{
+  std::vector<libcamera::PixelFormat> formats;                        // offered pixel formats, all raw formats of the node if empty
+  libcamera::Size                     default_size     = {1920, 1080};  // used if no resolution is requested
+  unsigned int                        stride_alignment = 64;            // [bytes] rows are padded to a multiple of it
+  unsigned int                        buffers          = 4;             // distinct frame contents cycled through
+  double                              jitter           = 0.0;           // [s] maximum deviation of a frame from its nominal time
+  double                              drop_rate        = 0.0;           // probability of a frame lost by the sensor (sequence gap)
+  double                              cancel_rate      = 0.0;           // probability of a cancelled request
+  bool                                fail_start       = false;         // start() throws like a camera that can not be started
+  uint32_t                            seed             = 0;
+  std::vector<CompletionRecord>       trace;                            // completions replayed instead of the regular frame rate
+  bool                                trace_loop       = false;         // restart the trace at its end
+};
+
+// in-memory camera producing synthetic frames at the rate of the FrameDurationLimits control, with
+// configurable formats, strides, timing jitter and injected failures, no hardware is needed; with a
+// completion trace it reproduces the recorded completion times, sequence numbers, statuses and sizes instead
+class MockBackend : public CameraBackend {
+public:
+  explicit MockBackend(const MockBackendOptions &options);
+  ~MockBackend() override;
+
+  MockBackend(const MockBackend &) = delete;
+  MockBackend &operator=(const MockBackend &) = delete;
+
+  StreamInfo configure(const StreamRequest &request) override;
+
+  const libcamera::ControlInfoMap &controls() const override {
+    return controls_;
+  }
+
+  void setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &values) override;
+
+  void queueControls(const ControlCommandValues &values) override;
+
+  void start(const FrameCallback &on_frame, const CancelCallback &on_cancel) override;
+
+  void stop() override;
+
+  std::string id() const override {
+    return "mock";
+  }
+
+  std::vector<libcamera::PixelFormat> formats() const override;
+
+private:
+  void generator();
+  void replayTrace();
+
+  const MockBackendOptions  options_;
+  libcamera::ControlInfoMap controls_;
+
+  StreamInfo                        stream_;
+  std::vector<std::vector<uint8_t>> buffers_;
+
+  // frame metadata, updated by setControls and by the commanded controls
+  int64_t frame_duration_ = 33333;  // [us]
+  int32_t exposure_time_  = 10000;  // [us]
+  float   analogue_gain_  = 1.0f;
+
+  // applied by the frame thread before the next frame, under the mutex
+  ControlCommandValues pending_controls_;
+
+  void applyPendingControls();
+
+  FrameCallback  on_frame_;
+  CancelCallback on_cancel_;
+
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable stop_cv_;
+  bool                    stop_ = false;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// CPU time [ns] used by the calling thread so far
+uint64_t
+thread_cpu_time();
+
+// cost of one output of the driver, a topic or one transport of an image topic
+struct OutputCounters
+{
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> bytes{0};   // serialized messages handed to the publisher, 0 where the transport produces them
+  std::atomic<uint64_t> cpu_ns{0};  // time of the publishing thread in the publish call
+};
+
+struct OutputUsage
+{
+  std::string topic;
+  std::string transport;
+  uint32_t    subscribers = 0;
+  uint64_t    frames      = 0;
+  uint64_t    bytes       = 0;
+  uint64_t    bytes_sent  = 0;    // to the remote subscribers, every connection counts
+  double      cpu_time    = 0.0;  // [s]
+};
+
+// counts the frames, bytes and CPU time of every output between two reports
+//
+// the outputs are registered at initialization or at runtime, their counters are updated without locking
+// from the publishing threads and read from another one
+class OutputAccounting {
+public:
+  // the counters stay valid until they are removed
+  OutputCounters &add(const std::string &topic, const std::string &transport, const std::function<uint32_t()> &subscribers);
+
+  // the output must not be published anymore
+  void remove(const OutputCounters &counters);
+
+  // usage since the previous call
+  std::vector<OutputUsage> collect();
+
+private:
+  struct output_t
+  {
+    std::string               topic;
+    std::string               transport;
+    std::function<uint32_t()> subscribers;
+    OutputCounters            counters;
+  };
+
+  // bytes sent and largest payload of one connection of a topic, from the bus statistics of roscpp
+  struct connection_t
+  {
+    uint32_t bytes   = 0;
+    uint32_t payload = 0;
+  };
+
+  std::mutex                            mutex_;
+  std::list<output_t>                   outputs_;
+  std::unordered_map<int, connection_t> connections_;
+};
+
+// publishes 'message' through 'publisher' if it has subscribers and counts the cost into 'counters'
+template <typename P, typename M>
+void
+publish_counted(P &publisher, const M &message, OutputCounters &counters, const uint64_t bytes)
+{
+  if (!publisher.getNumSubscribers())
+    return;
+
+  const uint64_t start = thread_cpu_time();
+  publisher.publish(message);
+
+  counters.cpu_ns.fetch_add(thread_cpu_time() - start, std::memory_order_relaxed);
+  counters.frames.fetch_add(1, std::memory_order_relaxed);
+  counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of worker threads that splits a range of rows into stripes and processes them in parallel
+class ParallelStripes {
+public:
+  explicit ParallelStripes(unsigned int threads);
+  ~ParallelStripes();
+
+  ParallelStripes(const ParallelStripes &) = delete;
+  ParallelStripes &operator=(const ParallelStripes &) = delete;
+
+  // call 'fn(begin, end)' for every stripe of the rows [0, rows) and block until all stripes are done,
+  // the calling thread processes the first stripe itself; 'fn' is passed by reference, a capturing lambda
+  // is not copied into a heap-allocated std::function on every call
+  template <typename F>
+  void run(unsigned int rows, const F &fn) {
+    runStripes(rows, [](const void *context, unsigned int begin, unsigned int end) { (*static_cast<const F *>(context))(begin, end); }, &fn);
+  }
+
+  unsigned int threads() const {
+    return workers_.size() + 1;
+  }
+
+private:
+  using stripe_fn_t = void (*)(const void *context, unsigned int begin, unsigned int end);
+
+  void runStripes(unsigned int rows, stripe_fn_t fn, const void *context);
+  void worker(unsigned int index);
+
+  std::vector<std::thread> workers_;
+  std::mutex               mutex_;
+  std::condition_variable  start_;
+  std::condition_variable  done_;
+
+  stripe_fn_t   fn_      = nullptr;
+  const void *  context_ = nullptr;
+  unsigned int  rows_    = 0;
+  unsigned long batch_   = 0;
+  unsigned int  pending_ = 0;
+  bool          stop_    = false;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/camera_backend.h>
+#include <libcamera_ros_driver/utils/frame_playback.h>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <sensor_msgs/CameraInfo.h>
+
+// replays a capture file or a directory of raw frame files (see FramePlayback) in place of a camera
+class PlaybackBackend : public CameraBackend {
+public:
+  // 'raw_stride' of 0 means rows without padding
+  PlaybackBackend(const std::string &source, PlaybackPacing pacing, bool loop, double raw_fps, unsigned int raw_stride);
+
+  // raw frame files take their pixel format and size from 'request', capture files ignore it
+  StreamInfo configure(const StreamRequest &request) override;
+
+  // recorded frames can not be controlled
+  const libcamera::ControlInfoMap &controls() const override {
+    return controls_;
+  }
+
+  void setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &) override {
+  }
+
+  void start(const FrameCallback &on_frame, const CancelCallback &on_cancel) override;
+
+  void stop() override;
+
+  std::string id() const override {
+    return source_;
+  }
+
+  // camera info stored in the capture file
+  std::optional<sensor_msgs::CameraInfo> cameraInfo() const;
+
+private:
+  const std::string    source_;
+  const PlaybackPacing pacing_;
+  const bool           loop_;
+  const double         raw_fps_;
+  const unsigned int   raw_stride_;
+
+  libcamera::ControlInfoMap      controls_;
+  std::unique_ptr<FramePlayback> playback_;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace libcamera
+{
+class PixelFormat;
+}
+
+enum class BayerOrder
+{
+  RGGB,
+  GRBG,
+  GBRG,
+  BGGR,
+};
+
+struct DefectPixel
+{
+  uint32_t x;
+  uint32_t y;
+};
+
+std::optional<BayerOrder>
+get_bayer_order(const libcamera::PixelFormat &pixelformat);
+
+// defect map file with one "x y" pixel coordinate per line, '#' starts a comment
+std::vector<DefectPixel>
+load_defect_map(const std::string &path);
+
+// copy 'height' rows of 8-bit or 16-bit Bayer samples, subtract the black levels (in the order R, Gr, Gb, B,
+// 16-bit scale, as reported by 'SensorBlackLevels') and replace the defect pixels by their same-colour neighbours
+void
+copy_raw_corrected(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int width, unsigned int height,
+                   unsigned int bits, BayerOrder order, const std::array<int32_t, 4> &black_levels, const std::vector<DefectPixel> &defects);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// rectangle of an image in pixels
+struct RoiRect
+{
+  unsigned int x      = 0;
+  unsigned int y      = 0;
+  unsigned int width  = 0;
+  unsigned int height = 0;
+};
+
+// crops a rectangle out of a packed image and scales it by nearest neighbour sampling, only the sampled
+// pixels are read
+//
+// the image is sampled in blocks of pixels that are kept together, 2x2 for Bayer images and 2x1 for packed
+// YUV 4:2:2 images, so that the crop and the scaled image keep the layout of the format
+class RoiSampler {
+public:
+  // the rectangle is clipped to the image and aligned to the blocks, throws if nothing is left of it
+  RoiSampler(const RoiRect &rect, double scale, unsigned int image_width, unsigned int image_height, unsigned int bytes_per_pixel, unsigned int block_width,
+             unsigned int block_height);
+
+  // clipped and aligned rectangle in the image
+  const RoiRect &rect() const {
+    return rect_;
+  }
+
+  unsigned int width() const {
+    return width_;
+  }
+  unsigned int height() const {
+    return height_;
+  }
+  std::size_t step() const {
+    return std::size_t(width_) * bytes_per_pixel_;
+  }
+
+  // 'dst' has height() rows of step() bytes
+  void sample(const uint8_t *src, std::size_t src_step, uint8_t *dst) const;
+
+private:
+  template <unsigned int BYTES>
+  void sampleRows(const uint8_t *src, std::size_t src_step, uint8_t *dst) const;
+
+  RoiRect      rect_;
+  unsigned int width_;
+  unsigned int height_;
+  unsigned int bytes_per_pixel_;
+  unsigned int block_width_;
+  unsigned int block_height_;
+
+  std::vector<uint32_t> x_offsets_;  // byte offset in the source row of every output block
+  std::vector<uint32_t> y_rows_;     // source row of every output row
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/parallel_stripes.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// recursive temporal filter for 8-bit samples, every sample is blended with the previous output
+// with a weight that decreases with the difference between both, so moving content is left untouched
+class TemporalDenoise {
+public:
+  // 'strength' is the history weight of static samples in [0, 1), differences of 'motion_threshold' and more are treated as motion
+  TemporalDenoise(double strength, unsigned int motion_threshold, unsigned int threads);
+
+  // filter 'height' rows of 'row_bytes' samples, 'src' and 'dst' may point to the same image,
+  // the history is reset whenever the image layout changes
+  void process(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int row_bytes, unsigned int height);
+
+  void reset();
+
+private:
+  uint8_t  strength_;
+  uint8_t  threshold_;
+  uint16_t slope_;  // weight decrease per unit of difference, 4 fractional bits
+
+  std::vector<uint8_t> history_;
+  unsigned int         row_bytes_ = 0;
+  unsigned int         height_    = 0;
+  bool                 valid_     = false;
+
+  ParallelStripes stripes_;
+};
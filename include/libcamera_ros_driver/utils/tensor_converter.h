@@ -0,0 +1,121 @@
+#pragma once
+
+#include <libcamera_ros_driver/utils/parallel_stripes.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TensorLayout
+{
+  NCHW,
+  NHWC,
+};
+
+enum class TensorType
+{
+  FLOAT32,
+  UINT8,
+  INT8,
+};
+
+std::string
+to_string(TensorLayout layout);
+std::string
+to_string(TensorType type);
+
+// parse the names of to_string(), case-insensitive, throws if the name is unknown
+TensorLayout
+tensor_layout_from_string(const std::string &name);
+TensorType
+tensor_type_from_string(const std::string &name);
+
+struct TensorConfig
+{
+  unsigned int         width            = 640;  // input size of the model, the image is letterboxed into it
+  unsigned int         height           = 640;
+  TensorLayout         layout           = TensorLayout::NCHW;
+  TensorType           type             = TensorType::FLOAT32;
+  bool                 rgb              = true;                               // channel order of colour tensors, BGR otherwise
+  std::array<float, 3> mean             = {0.0f, 0.0f, 0.0f};                 // per tensor channel, in pixel values
+  std::array<float, 3> scale            = {1 / 255.f, 1 / 255.f, 1 / 255.f};  // value = (pixel - mean) * scale
+  float                quant_scale      = 1.0f;                               // 8-bit types: q = round(value / quant_scale) + zero_point, saturated
+  int                  quant_zero_point = 0;
+  uint8_t              pad              = 114;  // pixel value of the letterbox borders, normalized like the image
+};
+
+// geometry of the letterbox: tensor pixel = image pixel * scale + offset
+struct Letterbox
+{
+  float        scale    = 1.0f;
+  unsigned int offset_x = 0;
+  unsigned int offset_y = 0;
+  unsigned int width    = 0;  // of the image inside of the tensor
+  unsigned int height   = 0;
+};
+
+// converts 8-bit mono, RGB and BGR images (with or without alpha) into the input tensor of a model in one pass:
+// letterboxed bilinear resize in fixed point, channel reordering, normalization of the interpolated values with a
+// fused multiply-add for float tensors or quantization through a per-channel table for 8-bit ones, and the layout
+// of the tensor; split into stripes of tensor rows, each processed in chunks of pixels with the kernels of kernels()
+class TensorConverter {
+public:
+  TensorConverter(const TensorConfig &config, unsigned int threads);
+
+  // whether images of a ROS encoding can be converted
+  static bool supports(const std::string &encoding);
+
+  // the tables are rebuilt whenever the image layout changes, throws if the encoding is not supported
+  void convert(const uint8_t *src, std::size_t src_step, unsigned int width, unsigned int height, const std::string &encoding, uint8_t *dst);
+
+  const TensorConfig &config() const {
+    return config_;
+  }
+
+  // of the last converted image
+  unsigned int channels() const {
+    return channels_;
+  }
+  const Letterbox &letterbox() const {
+    return letterbox_;
+  }
+  std::vector<uint32_t> shape() const;
+  std::size_t           bytes() const;
+
+private:
+  void prepare(unsigned int width, unsigned int height, const std::string &encoding);
+
+  template <TensorLayout LAYOUT, typename T>
+  void convertRows(const uint8_t *src, std::size_t src_step, T *dst, unsigned int begin, unsigned int end) const;
+
+  const TensorConfig config_;
+  ParallelStripes    stripes_;
+
+  // layout of the image the tables were built for
+  unsigned int src_width_  = 0;
+  unsigned int src_height_ = 0;
+  std::string  encoding_;
+
+  unsigned int                channels_     = 0;          // of the tensor
+  unsigned int                src_channels_ = 0;          // of the image
+  std::array<unsigned int, 3> src_channel_  = {0, 0, 0};  // image channel of every tensor channel
+  Letterbox                   letterbox_;
+
+  // per tensor column and row inside of the letterbox: first source pixel and weight of the second in 1/256
+  std::vector<uint32_t> x_offset_, x_next_;
+  std::vector<uint16_t> x_weight_;
+  std::vector<uint32_t> y_row_, y_next_;
+  std::vector<uint16_t> y_weight_;
+
+  // float types: per element of a chunk in the layout of the tensor, the normalization of its channel applied to the
+  // interpolated value with 8 fractional bits
+  std::vector<float> chunk_scale_, chunk_offset_;
+
+  // 8-bit types: quantized value of every pixel value per tensor channel
+  std::vector<uint8_t> lut_byte_;
+
+  // normalized pixel value of the letterbox borders per tensor channel
+  std::array<float, 3>   pad_float_ = {0.0f, 0.0f, 0.0f};
+  std::array<uint8_t, 3> pad_byte_  = {0, 0, 0};
+};
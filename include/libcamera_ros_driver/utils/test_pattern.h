@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// software test pattern whose every byte is known from the frame sequence number: byte 'i' of row 'y' of
+// frame 's' is (i + 7 * y + s) mod 256, except for the first bytes of the first row, which carry a
+// watermark with the sequence number, so that a receiver can verify the content without a reference
+
+// [bytes] magic "LCTP" followed by the sequence number as 64-bit little endian and 4 reserved bytes
+static constexpr std::size_t test_pattern_watermark_bytes = 16;
+
+// fill 'rows' rows of 'step' bytes, including the padding
+void
+write_test_pattern(uint8_t *data, std::size_t step, std::size_t rows, uint64_t sequence);
+
+// sequence number of the watermark, empty if there is none
+std::optional<uint64_t>
+read_test_pattern_watermark(const uint8_t *data, std::size_t size);
+
+// number of bytes outside of the watermark that differ from the pattern of 'sequence'
+std::size_t
+check_test_pattern(const uint8_t *data, std::size_t step, std::size_t rows, uint64_t sequence);
+
+// FNV-1a hash, used to compare frames with a constant content such as the test patterns of a sensor
+uint64_t
+hash_bytes(const uint8_t *data, std::size_t size);
@@ -0,0 +1,28 @@
+#pragma once
+
+// static tracepoints (USDT) of the frame path, provider "libcamera_ros_driver", every probe carries the
+// frame sequence number, a byte count and the request pointer; they are compiled in when sys/sdt.h is
+// available and are a single nop instruction each until a tracer (bpftrace, perf, SystemTap) attaches
+//
+//   request_complete  the backend got the frame from the camera
+//   request_cancelled the backend got a cancelled request
+//   frame_begin       the driver starts processing the frame
+//   record_end        the frame is queued for the recorder
+//   convert_end       the frame is converted into the image message
+//   denoise_end       the temporal denoise is done
+//   camera_info_end   the camera info message is ready
+//   publish_end       both messages are published
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define FRAME_TRACEPOINT(name, sequence, bytes, request) DTRACE_PROBE3(libcamera_ros_driver, name, uint64_t(sequence), uint64_t(bytes), (const void *)(request))
+
+#else
+
+#define FRAME_TRACEPOINT(name, sequence, bytes, request) \
+  do {                                                   \
+  } while (false)
+
+#endif
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Rebuilds a per-frame timeline from a trace of the frame path tracepoints (frame_trace.bt).
+
+For every frame it prints the time spent between consecutive stage boundaries, from the completion of
+the request in the backend to the end of the publishing, followed by the percentiles of every step and
+the interval between frames. Frames slower than --slow milliseconds are marked.
+
+example:
+  sudo bpftrace -p $(pgrep -f "nodelet manager") frame_trace.bt > trace.csv
+  rosrun libcamera_ros_driver frame_timeline.py trace.csv --slow 20
+"""
+
+import argparse
+import csv
+import sys
+
+# stage boundaries in the order they are passed, the optional ones are missing when the stage is disabled
+BOUNDARIES = ["request_complete", "frame_begin", "record_end", "convert_end", "denoise_end", "camera_info_end", "publish_end"]
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="per-frame timeline of the frame path tracepoints")
+    parser.add_argument("trace", help="csv written by frame_trace.bt, - for stdin")
+    parser.add_argument("--slow", type=float, default=0.0, help="[ms] mark frames whose whole path takes longer")
+    parser.add_argument("--summary", action="store_true", help="only print the summary")
+    args = parser.parse_args()
+
+    stream = sys.stdin if args.trace == "-" else open(args.trace)
+
+    # events of a frame are keyed by the sequence number, a restarted camera would start a new timeline
+    frames = {}
+    cancelled = 0
+
+    for row in csv.DictReader(line for line in stream if "," in line):
+        probe = row["probe"].split(":")[-1]
+        if probe == "request_cancelled":
+            cancelled += 1
+            continue
+        if probe not in BOUNDARIES:
+            continue
+        frames.setdefault(int(row["sequence"]), {})[probe] = (int(row["time"]), int(row["bytes"]))
+
+    if not frames:
+        print("no frames in the trace")
+        return 1
+
+    steps = {}
+    totals = []
+    starts = []
+    missing = 0
+    previous_sequence = None
+
+    if not args.summary:
+        header = ["sequence", "start [ms]"] + ["%s [ms]" % b for b in BOUNDARIES[1:]] + ["total [ms]"]
+        print(" ".join("%16s" % h for h in header))
+
+    first_time = min(min(t for t, _ in events.values()) for events in frames.values())
+
+    for sequence in sorted(frames):
+        events = frames[sequence]
+
+        if previous_sequence is not None and sequence > previous_sequence + 1:
+            missing += sequence - previous_sequence - 1
+        previous_sequence = sequence
+
+        # the time of every boundary is measured from the previous one that was passed
+        passed = [b for b in BOUNDARIES if b in events]
+        start = events[passed[0]][0]
+        starts.append(start)
+
+        durations = {}
+        for before, after in zip(passed, passed[1:]):
+            durations[after] = (events[after][0] - events[before][0]) / 1e6
+            steps.setdefault(after, []).append(durations[after])
+
+        total = (events[passed[-1]][0] - start) / 1e6
+        totals.append(total)
+
+        if not args.summary:
+            columns = ["%16d" % sequence, "%16.3f" % ((start - first_time) / 1e6)]
+            columns += ["%16.3f" % durations[b] if b in durations else "%16s" % "-" for b in BOUNDARIES[1:]]
+            columns.append("%16.3f" % total)
+            print(" ".join(columns) + ("  <- slow" if args.slow and total > args.slow else ""))
+
+    intervals = [(b - a) / 1e6 for a, b in zip(starts, starts[1:])]
+
+    print()
+    print("%d frames, %d missing, %d cancelled requests" % (len(frames), missing, cancelled))
+    print("%-16s %10s %10s %10s %10s" % ("step [ms]", "p50", "p90", "p99", "max"))
+    for boundary in BOUNDARIES[1:]:
+        if boundary in steps:
+            values = steps[boundary]
+            print("%-16s %10.3f %10.3f %10.3f %10.3f" % (boundary, percentile(values, 0.5), percentile(values, 0.9), percentile(values, 0.99), max(values)))
+    print("%-16s %10.3f %10.3f %10.3f %10.3f" % ("total", percentile(totals, 0.5), percentile(totals, 0.9), percentile(totals, 0.99), max(totals)))
+    if intervals:
+        print("%-16s %10.3f %10.3f %10.3f %10.3f" % ("frame interval", percentile(intervals, 0.5), percentile(intervals, 0.9), percentile(intervals, 0.99),
+                                                     max(intervals)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
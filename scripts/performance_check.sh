@@ -0,0 +1,75 @@
+#!/bin/bash
+# runs the mock camera frame path in the standard configurations and either records a baseline of every
+# configuration or checks the configurations against the recorded baselines with test/performance.test, exits
+# with 1 on a regression or on heap allocations in the stages of the driver (counted by the preloaded allocation
+# counter)
+#
+# usage: performance_check.sh record|check [baseline directory] [seconds per configuration]
+
+set -u
+
+MODE=${1:-check}
+DIRECTORY=${2:-$HOME/.ros/libcamera_ros_driver_baselines}
+DURATION=${3:-30}
+TOLERANCE=${TOLERANCE:-0.2}
+
+if [ "$MODE" != "record" ] && [ "$MODE" != "check" ]; then
+  echo "usage: $0 record|check [baseline directory] [seconds per configuration]"
+  exit 2
+fi
+
+mkdir -p "$DIRECTORY"
+
+FAILED=0
+
+for PRESET in lq hq uhq; do
+  for REMOVE_STRIDE in false true; do
+
+    NAME="${PRESET}_RGB888_stride_removed_${REMOVE_STRIDE}"
+    FILE="$DIRECTORY/$NAME.yaml"
+    LOG=$(mktemp)
+
+    if [ "$MODE" == "record" ]; then
+
+      echo "$NAME: recording for $DURATION s"
+
+      # written by the driver after every period past the warm-up, the previous baseline is kept when nothing is written
+      rm -f "$FILE.new"
+
+      # roslaunch is interrupted like with Ctrl+C so that the nodes shut down cleanly
+      timeout -s INT "$DURATION" roslaunch libcamera_ros_driver benchmark.launch preset:=$PRESET pixel_format:=RGB888 remove_stride:=$REMOVE_STRIDE count_allocations:=true baseline_output:="$FILE.new" >"$LOG" 2>&1
+
+      if [ ! -s "$FILE.new" ]; then
+        echo "$NAME: no baseline was written, see $LOG"
+        FAILED=1
+        continue
+      fi
+      mv "$FILE.new" "$FILE"
+
+    elif [ -f "$FILE" ]; then
+
+      echo "$NAME: checking for $DURATION s"
+
+      # the profiling reports of the driver checked by the rostest of the package, one report every 2 s after the warm-up
+      REPORTS=$((DURATION / 2 - 1))
+      if ! rostest libcamera_ros_driver performance.test preset:=$PRESET remove_stride:=$REMOVE_STRIDE baseline:="$FILE" tolerance:=$TOLERANCE reports:=$((REPORTS > 0 ? REPORTS : 1)) >"$LOG" 2>&1; then
+        grep -A 3 "Failure\|FAILED" "$LOG"
+        echo "$NAME: failed, see $LOG"
+        FAILED=1
+        continue
+      fi
+
+    else
+      echo "$NAME: no baseline in $DIRECTORY, skipped"
+      continue
+    fi
+
+    rm -f "$LOG"
+  done
+done
+
+if [ "$MODE" == "check" ]; then
+  [ $FAILED -eq 0 ] && echo "no regressions" || echo "regressions found"
+fi
+
+exit $FAILED
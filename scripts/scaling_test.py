@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""
+Multi-camera scaling test of the driver.
+
+Starts 1..N driver processes (launch/scaling_camera.launch) against the cameras of the vimc virtual camera
+driver or the mock camera, sweeps resolutions and frame rates and reports the frame rate, the lost frames,
+the CPU load and the memory of every camera as the number of cameras grows.
+
+Every driver runs in its own process, libcamera allows only one camera manager per process. vimc creates
+one camera per instance of the module, load it with more instances or use the mock backend beyond that.
+
+example:
+  rosrun libcamera_ros_driver scaling_test.py --cameras 1 2 4 --resolutions 640x480 1920x1080 --rates 30 60
+"""
+
+import argparse
+import csv
+import os
+import signal
+import subprocess
+import sys
+import threading
+import time
+
+import rospy
+from diagnostic_msgs.msg import DiagnosticArray
+from sensor_msgs.msg import CameraInfo
+
+
+CLOCK_TICKS = os.sysconf("SC_CLK_TCK")
+
+
+class CameraMonitor:
+    """Counts the frames of one camera from its camera info and takes the frames it lost from the diagnostics of
+    the driver: the camera info arrives serialized, its sequence number is the counter of the publisher and not the
+    one of the sensor. The images themselves are optionally received without deserialization."""
+
+    def __init__(self, index, subscribe_images):
+        self.lock = threading.Lock()
+        self.received = 0
+        self.lost = None  # total lost frames of the last diagnostics
+        self.lost_start = None
+        self.status_name = "/scaling/camera_%d: frames" % index
+        topic = "/scaling/camera_%d" % index
+        self.subscribers = [rospy.Subscriber(topic + "/camera_info", CameraInfo, self.callback, queue_size=10),
+                            rospy.Subscriber("/diagnostics", DiagnosticArray, self.callback_diagnostics, queue_size=10)]
+        if subscribe_images:
+            self.subscribers.append(rospy.Subscriber(topic + "/image_raw", rospy.AnyMsg, lambda msg: None, queue_size=10))
+
+    def callback(self, msg):
+        with self.lock:
+            self.received += 1
+
+    def callback_diagnostics(self, msg):
+        for status in msg.status:
+            if status.name != self.status_name:
+                continue
+            for entry in status.values:
+                if entry.key == "total lost frames":
+                    with self.lock:
+                        self.lost = int(entry.value)
+                        if self.lost_start is None:
+                            self.lost_start = self.lost
+
+    def reset(self):
+        with self.lock:
+            self.received = 0
+            self.lost_start = self.lost
+
+    def counts(self):
+        """Frames received and lost since the reset, the lost frames are counted up to the last diagnostics."""
+        with self.lock:
+            missing = self.lost - self.lost_start if self.lost is not None else 0
+            return self.received, missing
+
+    def close(self):
+        for subscriber in self.subscribers:
+            subscriber.unregister()
+
+
+def find_driver_pid(index):
+    """Process of the driver node of camera 'index', started by roslaunch."""
+    name = "__name:=camera_%d" % index
+    for pid in os.listdir("/proc"):
+        if not pid.isdigit():
+            continue
+        try:
+            with open("/proc/%s/cmdline" % pid, "rb") as f:
+                cmdline = f.read().split(b"\0")
+        except OSError:
+            continue
+        if name.encode() in cmdline and any(arg.endswith(b"nodelet") for arg in cmdline[:2]):
+            return int(pid)
+    return None
+
+
+def cpu_seconds(pid):
+    with open("/proc/%d/stat" % pid) as f:
+        # the command may contain spaces, the fields after it are fixed
+        fields = f.read().rsplit(")", 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / CLOCK_TICKS
+
+
+def rss_megabytes(pid):
+    with open("/proc/%d/status" % pid) as f:
+        for line in f:
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1]) / 1024.0
+    return 0.0
+
+
+def run_configuration(args, cameras, width, height, fps):
+    launches = []
+    monitors = []
+    results = []
+
+    try:
+        for index in range(cameras):
+            command = ["roslaunch", "libcamera_ros_driver", "scaling_camera.launch",
+                       "index:=%d" % index,
+                       "backend:=%s" % args.backend,
+                       "preset:=%s" % args.preset,
+                       "pixel_format:=%s" % args.pixel_format,
+                       "width:=%d" % width,
+                       "height:=%d" % height,
+                       "fps:=%g" % fps]
+            launches.append(subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, start_new_session=True))
+            monitors.append(CameraMonitor(index, args.subscribe_images))
+
+        time.sleep(args.warmup)
+
+        pids = [find_driver_pid(index) for index in range(cameras)]
+        for monitor in monitors:
+            monitor.reset()
+        cpu_start = [cpu_seconds(pid) if pid else 0.0 for pid in pids]
+        start = time.monotonic()
+
+        time.sleep(args.duration)
+
+        elapsed = time.monotonic() - start
+        for index, (monitor, pid) in enumerate(zip(monitors, pids)):
+            received, missing = monitor.counts()
+            alive = pid is not None and os.path.exists("/proc/%d" % pid)
+            results.append({
+                "cameras": cameras,
+                "camera": index,
+                "width": width,
+                "height": height,
+                "target_fps": fps,
+                "fps": received / elapsed,
+                "received": received,
+                "missing": missing,
+                "drop_percent": 100.0 * missing / (received + missing) if received + missing else 0.0,
+                "cpu_percent": 100.0 * (cpu_seconds(pid) - cpu_start[index]) / elapsed if alive else 0.0,
+                "rss_mb": rss_megabytes(pid) if alive else 0.0,
+                "running": alive,
+            })
+
+    finally:
+        for monitor in monitors:
+            monitor.close()
+        # roslaunch shuts the nodes down cleanly on SIGINT
+        for launch in launches:
+            if launch.poll() is None:
+                os.killpg(launch.pid, signal.SIGINT)
+        for launch in launches:
+            try:
+                launch.wait(timeout=15)
+            except subprocess.TimeoutExpired:
+                os.killpg(launch.pid, signal.SIGKILL)
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="multi-camera scaling test of the driver")
+    parser.add_argument("--backend", default="libcamera", choices=["libcamera", "mock"], help="vimc cameras through libcamera or the mock camera")
+    parser.add_argument("--cameras", type=int, nargs="+", default=[1, 2, 4], help="numbers of cameras to test")
+    parser.add_argument("--resolutions", nargs="+", default=["640x480", "1280x720", "1920x1080"], help="WIDTHxHEIGHT")
+    parser.add_argument("--rates", type=float, nargs="+", default=[30.0, 60.0], help="[Hz] frame rates")
+    parser.add_argument("--preset", default="lq", help="configuration the processing stages are taken from")
+    parser.add_argument("--pixel-format", default="RGB888")
+    parser.add_argument("--subscribe-images", action="store_true", help="also receive the images, not only the camera info")
+    parser.add_argument("--warmup", type=float, default=5.0, help="[s] time for the drivers to start")
+    parser.add_argument("--duration", type=float, default=10.0, help="[s] measurement time of a configuration")
+    parser.add_argument("--output", help="csv file for the results of every camera")
+    args = parser.parse_args(rospy.myargv()[1:])
+
+    rospy.init_node("scaling_test", anonymous=True, disable_signals=True)
+
+    rows = []
+    print("%7s %11s %6s | %9s %9s %9s %9s %9s" % ("cameras", "resolution", "fps", "fps/cam", "min fps", "drops %", "cpu %/cam", "rss MB"))
+
+    for width, height in (tuple(int(v) for v in r.split("x")) for r in args.resolutions):
+        for fps in args.rates:
+            for cameras in args.cameras:
+                results = run_configuration(args, cameras, width, height, fps)
+                rows.extend(results)
+
+                running = [r for r in results if r["running"]]
+                if not running:
+                    print("%7d %11s %6g | no camera started" % (cameras, "%dx%d" % (width, height), fps))
+                    continue
+
+                received = sum(r["received"] for r in running)
+                missing = sum(r["missing"] for r in running)
+                print("%7d %11s %6g | %9.1f %9.1f %9.2f %9.1f %9.1f%s" % (
+                    cameras, "%dx%d" % (width, height), fps,
+                    sum(r["fps"] for r in running) / len(running),
+                    min(r["fps"] for r in running),
+                    100.0 * missing / (received + missing) if received + missing else 0.0,
+                    sum(r["cpu_percent"] for r in running) / len(running),
+                    sum(r["rss_mb"] for r in running) / len(running),
+                    "" if len(running) == cameras else "  (%d of %d cameras failed)" % (cameras - len(running), cameras)))
+                sys.stdout.flush()
+
+    if args.output and rows:
+        with open(args.output, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()))
+            writer.writeheader()
+            writer.writerows(rows)
+
+    rospy.signal_shutdown("done")
+
+
+if __name__ == "__main__":
+    main()
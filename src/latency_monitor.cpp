@@ -0,0 +1,163 @@
+/* includes //{ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+
+#include <sensor_msgs/Image.h>
+
+//}
+
+namespace libcamera_ros_driver
+{
+
+/* class LatencyMonitor //{ */
+
+// subscribes to the images of the driver and reports the latency from the capture timestamp to the
+// subscriber callback and the frames lost on the way, detected from gaps in the sequence numbers; these are the ones
+// of the sensor only in the manager of the driver, a serialized image has the counter of the publisher instead
+class LatencyMonitor : public nodelet::Nodelet {
+public:
+  virtual void onInit();
+
+private:
+  ros::NodeHandle nh_;
+
+  image_transport::Subscriber subscriber_image_;
+  std::string                 transport_;
+  std::string                 label_;
+  std::string                 output_file_;
+  bool                        sequence_gaps_ = true;  // the header has the sequence numbers of the sensor
+
+  std::mutex          mutex_;
+  std::vector<double> latencies_;  // [ms] of the current period
+  uint64_t            received_ = 0;
+  uint64_t            missing_  = 0;
+  uint64_t            last_seq_ = 0;
+  bool                got_seq_  = false;
+
+  ros::Timer    timer_report_;
+  ros::WallTime last_report_;
+
+  void callbackImage(const sensor_msgs::ImageConstPtr &msg);
+  void timerReport(const ros::TimerEvent &event);
+};
+
+//}
+
+/* LatencyMonitor::onInit() //{ */
+
+void LatencyMonitor::onInit() {
+
+  nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
+
+  ros::Time::waitForValid();
+
+  double period;
+  nh_.param("transport", transport_, std::string("raw"));
+  nh_.param("label", label_, transport_);
+  nh_.param("output_file", output_file_, std::string());
+  nh_.param("sequence_gaps", sequence_gaps_, true);
+  nh_.param("period", period, 5.0);
+
+  ROS_INFO_STREAM("[LatencyMonitor]: measuring \"" << label_ << "\" over the " << transport_ << " transport"
+                                                    << (sequence_gaps_ ? "" : " without counting the lost frames")
+                                                    << (output_file_.empty() ? "" : ", appending the results to \"" + output_file_ + "\""));
+
+  image_transport::ImageTransport it(nh_);
+  subscriber_image_ = it.subscribe("image", 5, &LatencyMonitor::callbackImage, this, image_transport::TransportHints(transport_));
+
+  last_report_  = ros::WallTime::now();
+  timer_report_ = nh_.createTimer(ros::Duration(std::max(period, 0.1)), &LatencyMonitor::timerReport, this);
+
+  ROS_INFO("[LatencyMonitor]: initialized");
+}
+
+//}
+
+/* LatencyMonitor::callbackImage() //{ */
+
+void LatencyMonitor::callbackImage(const sensor_msgs::ImageConstPtr &msg) {
+
+  // the driver has to stamp the images in ROS time (use_ros_time) for the difference to be meaningful
+  const double latency = (ros::Time::now() - msg->header.stamp).toSec() * 1e3;
+
+  std::scoped_lock lock(mutex_);
+
+  latencies_.push_back(latency);
+  received_++;
+
+  if (!sequence_gaps_) {
+    return;
+  }
+
+  // the driver sets the sequence number of the sensor, every gap is a lost frame
+  if (got_seq_ && msg->header.seq > last_seq_) {
+    missing_ += msg->header.seq - last_seq_ - 1;
+  }
+  last_seq_ = msg->header.seq;
+  got_seq_  = true;
+}
+
+//}
+
+/* LatencyMonitor::timerReport() //{ */
+
+void LatencyMonitor::timerReport([[maybe_unused]] const ros::TimerEvent &event) {
+
+  std::vector<double> latencies;
+  uint64_t            received, missing;
+
+  {
+    std::scoped_lock lock(mutex_);
+    latencies.swap(latencies_);
+    received  = received_;
+    missing   = missing_;
+    received_ = 0;
+    missing_  = 0;
+  }
+
+  if (latencies.empty()) {
+    ROS_WARN_STREAM("[LatencyMonitor]: " << label_ << ": no images received");
+    return;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  const auto percentile = [&](const double p) { return latencies[std::min(latencies.size() - 1, std::size_t(p * latencies.size()))]; };
+
+  const ros::WallTime now       = ros::WallTime::now();
+  const double        rate      = received / (now - last_report_).toSec();
+  const double        drop_rate = double(missing) / (received + missing);
+  last_report_                  = now;
+
+  if (sequence_gaps_) {
+    ROS_INFO("[LatencyMonitor]: %s: %" PRIu64 " images (%.1f Hz), %" PRIu64 " missing (%.2f %%), latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms",
+             label_.c_str(), received, rate, missing, 100.0 * drop_rate, percentile(0.5), percentile(0.9), percentile(0.99), latencies.back());
+  } else {
+    ROS_INFO("[LatencyMonitor]: %s: %" PRIu64 " images (%.1f Hz), latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms", label_.c_str(), received,
+             rate, percentile(0.5), percentile(0.9), percentile(0.99), latencies.back());
+  }
+
+  // the missing frames are left empty if they are not counted
+  if (!output_file_.empty()) {
+    std::ofstream file(output_file_, std::ios::app);
+    file << label_ << "," << transport_ << "," << received << "," << (sequence_gaps_ ? std::to_string(missing) : std::string()) << "," << percentile(0.5)
+         << "," << percentile(0.9) << "," << percentile(0.99) << "," << latencies.back() << std::endl;
+  }
+}
+
+//}
+
+}  // namespace libcamera_ros_driver
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(libcamera_ros_driver::LatencyMonitor, nodelet::Nodelet);
@@ -2,17 +2,24 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <deque>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <sys/mman.h>
@@ -33,14 +40,56 @@
 #include <libcamera_ros_driver/utils/types.h>
 #include <libcamera_ros_driver/utils/pv_to_cv.h>
 #include <libcamera_ros_driver/utils/is_vector.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <libcamera_ros_driver/utils/temporal_denoise.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/frame_recorder.h>
+#include <libcamera_ros_driver/utils/frame.h>
+#include <libcamera_ros_driver/utils/camera_backend.h>
+#include <libcamera_ros_driver/utils/libcamera_backend.h>
+#include <libcamera_ros_driver/utils/mock_backend.h>
+#include <libcamera_ros_driver/utils/playback_backend.h>
+#include <libcamera_ros_driver/utils/frame_profiler.h>
+#include <libcamera_ros_driver/utils/completion_trace.h>
+#include <libcamera_ros_driver/utils/test_pattern.h>
+#include <libcamera_ros_driver/utils/message_pool.h>
+#include <libcamera_ros_driver/utils/tracepoints.h>
+#include <libcamera_ros_driver/utils/latency_histogram.h>
+#include <libcamera_ros_driver/utils/output_accounting.h>
+#include <libcamera_ros_driver/utils/format_negotiation.h>
+#include <libcamera_ros_driver/utils/tensor_converter.h>
+#include <libcamera_ros_driver/utils/mjpeg_server.h>
+#include <libcamera_ros_driver/utils/roi_sampler.h>
+#include <libcamera_ros_driver/utils/control_command.h>
+#include <libcamera_ros_driver/utils/dng_writer.h>
+
+#include <libcamera_ros_driver/SetColorLut.h>
+#include <libcamera_ros_driver/GetLatencyStats.h>
+#include <libcamera_ros_driver/GetOutputStats.h>
+#include <libcamera_ros_driver/OutputStatsArray.h>
+#include <libcamera_ros_driver/ProfilingReport.h>
+#include <libcamera_ros_driver/Tensor.h>
+#include <libcamera_ros_driver/RegisterRoi.h>
+#include <libcamera_ros_driver/UnregisterRoi.h>
+#include <libcamera_ros_driver/ControlCommand.h>
+#include <libcamera_ros_driver/CaptureDng.h>
 
 #include <ros/ros.h>
 #include <nodelet/nodelet.h>
 #include <camera_info_manager/camera_info_manager.h>
+#include <diagnostic_updater/diagnostic_updater.h>
 #include <image_transport/image_transport.h>
+#include <image_transport/camera_common.h>
+#include <image_transport/publisher_plugin.h>
+#include <pluginlib/class_loader.h>
 
 #include <std_msgs/Header.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/image_encodings.h>
+#include <std_srvs/SetBool.h>
+
+#include <ros/serialization.h>
 
 //}
 
@@ -100,40 +149,235 @@ public:
 private:
   ros::NodeHandle nh_;
 
-  libcamera::CameraManager                         camera_manager_;
-  std::shared_ptr<libcamera::Camera>               camera_;
-  libcamera::Stream *                              stream_;
-  std::shared_ptr<libcamera::FrameBufferAllocator> allocator_;
-  std::vector<std::unique_ptr<libcamera::Request>> requests_;
-  std::mutex                                       request_lock_;
+  // source of the frames, a libcamera camera, the mock camera or a recording
+  std::unique_ptr<CameraBackend> backend_;
 
   std::string frame_id_;
 
+  // layout of the published frames, reported by the backend
+  StreamInfo stream_info_;
+
   bool _use_ros_time_ = false;
   bool remove_stride_ = false;
 
   ros::Duration start_time_offset_;
   bool          start_time_offset_obtained_ = false;
 
-  struct buffer_info_t
-  {
-    void * data;
-    size_t size;
-  };
-  std::unordered_map<const libcamera::FrameBuffer *, buffer_info_t> buffer_info_;
-
   std::shared_ptr<camera_info_manager::CameraInfoManager> cinfo_;
 
-  image_transport::CameraPublisher image_pub_;
-  std::mutex                       image_pub_mutex_;
+  // every image transport is published on its own, like image_transport::CameraPublisher does it, to account for its cost
+  struct image_output_t
+  {
+    boost::shared_ptr<image_transport::PublisherPlugin> publisher;
+    OutputCounters *                                    counters;
+    bool                                                raw;
+  };
+  std::unique_ptr<pluginlib::ClassLoader<image_transport::PublisherPlugin>> transport_loader_;
+  std::vector<image_output_t>                                               image_outputs_;
+  ros::Publisher                                                            camera_info_pub_;
+  OutputCounters *                                                          camera_info_counters_ = nullptr;
+  std::mutex                                                                image_pub_mutex_;
+
+  // optional model input computed from the camera buffer, only while it has subscribers
+  std::unique_ptr<TensorConverter>          tensor_converter_;
+  ros::Publisher                            tensor_pub_;
+  OutputCounters *                          tensor_counters_ = nullptr;
+  MessagePool<libcamera_ros_driver::Tensor> tensor_pool_{4};
+
+  // optional MJPEG preview over HTTP, encoded from the published image while a client is connected
+  std::unique_ptr<MjpegServer>          preview_server_;
+  std::unique_ptr<PreviewEncoder>       preview_encoder_;
+  OutputCounters *                      preview_counters_ = nullptr;
+  std::chrono::steady_clock::duration   preview_interval_{};
+  std::chrono::steady_clock::time_point preview_last_;
+
+  // regions registered by clients, each cropped and scaled from the camera buffer onto its own topic, an
+  // output is removed when it is unregistered or its subscribers are gone
+  struct roi_output_t
+  {
+    std::string                           name;
+    RoiRect                               rect;  // as registered, the sampler is rebuilt when the pixel format changes
+    double                                scale = 1.0;
+    std::optional<RoiSampler>             sampler;
+    libcamera::PixelFormat                format;  // the sampler was built for
+    ros::Publisher                        publisher;
+    OutputCounters *                      counters = nullptr;
+    MessagePool<sensor_msgs::Image>       pool{4};
+    std::chrono::steady_clock::duration   interval{};
+    std::chrono::steady_clock::time_point last;
+    ros::WallTime                         registered;
+    bool                                  subscribed = false;  // had a subscriber since it was registered
+  };
+  std::list<roi_output_t> roi_outputs_;
+  std::mutex              roi_mutex_;
+  int                     roi_max_outputs_       = 8;
+  double                  roi_subscribe_timeout_ = 10.0;  // [s] for the client to subscribe after registering
+  ros::Timer              timer_rois_;
+  ros::ServiceServer      service_server_register_roi_;
+  ros::ServiceServer      service_server_unregister_roi_;
+
+  // frames, bytes, subscribers and CPU time of every output
+  OutputAccounting                       output_accounting_;
+  ros::Publisher                         output_stats_pub_;
+  ros::Timer                             timer_output_stats_;
+  ros::WallTime                          output_stats_start_;
+  libcamera_ros_driver::OutputStatsArray output_stats_;  // last report
+  std::mutex                             output_stats_mutex_;
+  ros::ServiceServer                     service_server_output_stats_;
+
+  // the published messages are reused once they are released, the frame path does not allocate after the first frames
+  MessagePool<sensor_msgs::Image>      image_pool_{8};
+  MessagePool<sensor_msgs::CameraInfo> camera_info_pool_{8};
+
+  // copy of the calibration, refreshed by a timer so that the frame path does not copy it out of the manager
+  sensor_msgs::CameraInfo camera_info_;
+  std::mutex              camera_info_mutex_;
+  ros::Timer              timer_camera_info_;
 
   // map parameter names to libcamera control id
   std::unordered_map<std::string, const libcamera::ControlId *> parameter_ids_;
   // parameters that are to be set for every request
   std::unordered_map<unsigned int, libcamera::ControlValue> parameters_;
 
+  // per-frame control commands of an external controller, validated against descriptors resolved at the start
+  std::optional<ControlDescriptors> control_descriptors_;
+  ros::Subscriber                   subscriber_control_command_;
+
+  // optional colour correction of RGB outputs, replaced at runtime by the service
+  std::shared_ptr<const ColorLut3D> color_lut_;
+  std::mutex                        color_lut_mutex_;
+  unsigned int                      color_lut_channels_ = 0;  // 0 if the output format can not be corrected
+  bool                              color_lut_bgr_      = false;
+  ros::ServiceServer                service_server_set_color_lut_;
+
+  // optional black level and defect pixel correction of Bayer outputs
+  bool                      raw_correction_ = false;
+  std::optional<BayerOrder> bayer_order_;
+  std::array<int32_t, 4>    black_levels_ = {0, 0, 0, 0};
+  std::vector<DefectPixel>  defect_pixels_;
+
+  // optional temporal noise filter of 8-bit outputs
+  std::unique_ptr<TemporalDenoise> temporal_denoise_;
+  bool                             temporal_denoise_format_ = false;  // the output has 8-bit samples
+
+  // pixel_format "auto": the stream is reconfigured to the cheapest format for the subscribers, once a
+  // clearly cheaper one has been the best for the hold time
+  bool                                  auto_format_ = false;
+  StreamRequest                         stream_request_;
+  std::vector<std::string>              auto_format_encodings_  = {sensor_msgs::image_encodings::BGR8};
+  double                                auto_format_hold_       = 10.0;  // [s]
+  double                                auto_format_hysteresis_ = 0.2;   // relative cost saving
+  std::optional<libcamera::PixelFormat> auto_format_candidate_;
+  ros::WallTime                         auto_format_candidate_since_;
+  ros::Timer                            timer_auto_format_;
+  bool                                  reconfiguring_ = false;  // no recording or capture is started, written with both the
+                                                                 // recorder and the DNG lock held, read with either
+
+  // raw frame recorder, created with the first recording
+  std::unique_ptr<FrameRecorder> recorder_;
+  std::mutex                     recorder_mutex_;
+  std::string                    recorder_directory_ = "/tmp";
+  int                            recorder_slots_     = 4;
+  bool                           recorder_publish_   = true;
+  std::string                    camera_name_;
+  ros::ServiceServer             service_server_recorder_;
+
+  // DNG stills of the next raw frames, the writer is created with the first capture
+  std::unique_ptr<DngWriter> dng_writer_;
+  std::mutex                 dng_mutex_;
+  std::deque<std::string>    dng_paths_;        // files of the frames that are still to be captured
+  uint64_t                   dng_skipped_ = 0;  // frames of the current capture that found all slots in use
+  std::atomic<bool>          dng_pending_{false};
+  std::string                dng_directory_ = "/tmp";
+  int                        dng_slots_     = 2;
+  ros::ServiceServer         service_server_capture_dng_;
+
+  // optional per-stage timing of the frame path, logged periodically
+  std::unique_ptr<FrameProfiler> profiler_;
+  ros::Timer                     timer_profiling_;
+
+  // the published images are replaced by a pattern that can be verified by the receiver
+  bool software_test_pattern_ = false;
+
+  // latency distributions of the stages since the start of the window
+  std::unique_ptr<LatencyHistograms> histograms_;
+  ros::WallTime                      histograms_window_start_;
+  std::mutex                         histograms_mutex_;
+  bool                               sensor_clock_monotonic_ = true;
+  ros::ServiceServer                 service_server_latency_stats_;
+
+  // health of the frame stream, counted by the frame path and evaluated by the diagnostic task
+  std::unique_ptr<diagnostic_updater::Updater> diagnostics_;
+  ros::Timer                                   timer_diagnostics_;
+  double                                       target_fps_ = 0.0;
+  std::atomic<uint64_t>                        frames_{0};
+  std::atomic<uint64_t>                        frames_missing_{0};
+  std::atomic<uint64_t>                        frames_failed_{0};
+  std::atomic<uint64_t>                        requests_cancelled_{0};
+  std::atomic<uint64_t>                        processing_ns_{0};
+  std::optional<uint64_t>                      last_sequence_;
+
+  struct diagnostics_snapshot_t
+  {
+    ros::WallTime stamp;
+    uint64_t      frames        = 0;
+    uint64_t      missing       = 0;
+    uint64_t      failed        = 0;
+    uint64_t      cancelled     = 0;
+    uint64_t      processing_ns = 0;
+  };
+  diagnostics_snapshot_t diagnostics_last_;
+
+  // thresholds of the warning and error levels
+  double diagnostics_fps_warn_       = 0.9;   // achieved / target frame rate
+  double diagnostics_fps_error_      = 0.5;
+  double diagnostics_loss_warn_      = 0.01;  // lost / expected frames
+  double diagnostics_loss_error_     = 0.1;
+  double diagnostics_headroom_warn_  = 0.2;   // 1 - processing time / frame interval
+  double diagnostics_headroom_error_ = 0.0;
+
+  // optional trace of the request completions, replayable by the mock camera
+  std::unique_ptr<CompletionTraceWriter> trace_writer_;
+
+  // regression check of the profiled stages against a baseline scaled to this machine
+  PerformanceBaseline profiling_baseline_;
+  PerformanceBaseline profiling_best_;
+  double              profiling_tolerance_ = 0.2;
+  int                 profiling_warmup_    = 1;
+  int                 profiling_reports_   = 0;
+  std::string         profiling_baseline_output_;
+  ros::Publisher      profiling_pub_;
+  ros::WallTime       profiling_start_;
+
   void declareControlParameters();
-  void requestComplete(libcamera::Request *request);
+  void applyStreamFormat();
+  void startBackend();
+  bool reconfigureFormat(const libcamera::PixelFormat &format);  // false if it has to wait for the end of a recording
+  FormatDemand formatDemand();
+  void processFrame(const FrameView &frame);
+  void publishTensor(const FrameView &frame, const std_msgs::Header &header);
+  void publishPreview(const sensor_msgs::Image &image);
+  void publishRois(const FrameView &frame, const std_msgs::Header &header);
+  RoiSampler roiSampler(const RoiRect &rect, double scale) const;  // for the current stream, throws if the region does not fit, with roi_mutex_ held
+  std::list<roi_output_t>::iterator removeRoi(std::list<roi_output_t>::iterator it);
+
+  void callbackControlCommand(const libcamera_ros_driver::ControlCommand::ConstPtr &msg);
+
+  bool callbackSetColorLut(libcamera_ros_driver::SetColorLut::Request &req, libcamera_ros_driver::SetColorLut::Response &res);
+  bool callbackRecorder(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res);
+  bool callbackCaptureDng(libcamera_ros_driver::CaptureDng::Request &req, libcamera_ros_driver::CaptureDng::Response &res);
+  bool callbackGetLatencyStats(libcamera_ros_driver::GetLatencyStats::Request &req, libcamera_ros_driver::GetLatencyStats::Response &res);
+  bool callbackGetOutputStats(libcamera_ros_driver::GetOutputStats::Request &req, libcamera_ros_driver::GetOutputStats::Response &res);
+  bool callbackRegisterRoi(libcamera_ros_driver::RegisterRoi::Request &req, libcamera_ros_driver::RegisterRoi::Response &res);
+  bool callbackUnregisterRoi(libcamera_ros_driver::UnregisterRoi::Request &req, libcamera_ros_driver::UnregisterRoi::Response &res);
+
+  void timerProfiling(const ros::TimerEvent &event);
+  void timerCameraInfo(const ros::TimerEvent &event);
+  void timerDiagnostics(const ros::TimerEvent &event);
+  void timerOutputStats(const ros::TimerEvent &event);
+  void timerAutoFormat(const ros::TimerEvent &event);
+  void timerRois(const ros::TimerEvent &event);
+  void diagnosticsFrames(diagnostic_updater::DiagnosticStatusWrapper &status);
 
   bool updateControlParameter(const libcamera::ControlValue &value, const libcamera::ControlId *id);
 };
@@ -157,9 +401,61 @@ void LibcameraRosDriver::onInit() {
   std::string stream_role;
   std::string pixel_format;
   std::string calib_url;
+  std::string color_lut_file;
+  std::string defect_map_file;
+  std::string kernel_backend  = "auto";
+  std::string backend         = "libcamera";
+  std::string playback_source;
+  std::string playback_pacing = "realtime";
+  bool        playback_loop   = false;
+  double      playback_fps    = 30.0;
+  int         playback_stride = 0;
   int         camera_id;
   int         resolution_width;
   int         resolution_height;
+  bool        temporal_denoise          = false;
+  double      temporal_denoise_strength = 0.6;
+  int         temporal_denoise_motion   = 24;
+  int         temporal_denoise_threads  = 2;
+
+  std::vector<std::string> mock_formats;
+  MockBackendOptions       mock_options;
+  int                      mock_stride_alignment = mock_options.stride_alignment;
+  int                      mock_buffers          = mock_options.buffers;
+  int                      mock_seed             = mock_options.seed;
+  std::string              mock_trace;
+  std::string              trace_file;
+
+  std::string test_pattern        = "off";
+  std::string test_pattern_camera = "color-bars";
+  bool        camera_test_pattern = false;
+
+  bool   profiling           = false;
+  double profiling_period    = 5.0;
+  bool   histograms          = true;
+  double output_stats_period = 5.0;
+  double auto_format_period  = 2.0;
+
+  bool                tensor         = false;
+  int                 tensor_width   = 640;
+  int                 tensor_height  = 640;
+  std::string         tensor_layout  = "nchw";
+  std::string         tensor_dtype   = "float32";
+  std::string         tensor_order   = "rgb";
+  std::vector<double> tensor_mean    = {0.0, 0.0, 0.0};
+  std::vector<double> tensor_scale   = {1.0 / 255, 1.0 / 255, 1.0 / 255};
+  double              tensor_qscale  = 1.0;
+  int                 tensor_qzero   = 0;
+  int                 tensor_pad     = 114;
+  int                 tensor_threads = 1;
+
+  bool        preview             = false;
+  std::string preview_address     = "127.0.0.1";
+  int         preview_port        = 8080;
+  int         preview_width       = 640;
+  double      preview_fps         = 5.0;
+  int         preview_quality     = 75;
+  int         preview_max_clients = 4;
   
   remove_stride_ = false;
 
@@ -173,6 +469,82 @@ void LibcameraRosDriver::onInit() {
   success = success && getCompulsoryParamCheck(nh_, "LibcameraRosDriver", "resolution/height", resolution_height);
   success = success && getCompulsoryParamCheck(nh_, "LibcameraRosDriver", "use_ros_time", _use_ros_time_);
   success = success && getOptionalParamCheck(nh_, "LibcameraRosDriver", "remove_stride", remove_stride_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "color_lut/file", color_lut_file);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "raw_correction/enable", raw_correction_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "raw_correction/defect_map", defect_map_file);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "temporal_denoise/enable", temporal_denoise);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "temporal_denoise/strength", temporal_denoise_strength);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "temporal_denoise/motion_threshold", temporal_denoise_motion);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "temporal_denoise/threads", temporal_denoise_threads);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "kernel_backend", kernel_backend);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "recorder/directory", recorder_directory_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "recorder/slots", recorder_slots_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "recorder/publish", recorder_publish_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "dng/directory", dng_directory_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "dng/slots", dng_slots_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "backend", backend);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "playback/source", playback_source);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "playback/pacing", playback_pacing);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "playback/loop", playback_loop);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "playback/fps", playback_fps);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "playback/stride", playback_stride);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/formats", mock_formats);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/stride_alignment", mock_stride_alignment);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/buffers", mock_buffers);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/jitter", mock_options.jitter);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/drop_rate", mock_options.drop_rate);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/cancel_rate", mock_options.cancel_rate);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/fail_start", mock_options.fail_start);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/seed", mock_seed);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/trace", mock_trace);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "mock/trace_loop", mock_options.trace_loop);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "trace/file", trace_file);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "test_pattern/mode", test_pattern);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "test_pattern/camera_pattern", test_pattern_camera);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "profiling/enable", profiling);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "profiling/period", profiling_period);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "histograms/enable", histograms);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "output_stats/period", output_stats_period);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/enable", tensor);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/width", tensor_width);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/height", tensor_height);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/layout", tensor_layout);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/dtype", tensor_dtype);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/channel_order", tensor_order);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/mean", tensor_mean);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/scale", tensor_scale);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/quant_scale", tensor_qscale);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/zero_point", tensor_qzero);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/pad", tensor_pad);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "tensor/threads", tensor_threads);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/enable", preview);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/address", preview_address);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/port", preview_port);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/width", preview_width);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/fps", preview_fps);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/quality", preview_quality);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "preview/max_clients", preview_max_clients);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "roi/max_outputs", roi_max_outputs_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "roi/subscribe_timeout", roi_subscribe_timeout_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "pixel_format_auto/encodings", auto_format_encodings_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "pixel_format_auto/period", auto_format_period);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "pixel_format_auto/hold", auto_format_hold_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "pixel_format_auto/hysteresis", auto_format_hysteresis_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/fps_warn", diagnostics_fps_warn_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/fps_error", diagnostics_fps_error_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/loss_warn", diagnostics_loss_warn_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/loss_error", diagnostics_loss_error_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/headroom_warn", diagnostics_headroom_warn_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "diagnostics/headroom_error", diagnostics_headroom_error_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "profiling/tolerance", profiling_tolerance_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "profiling/warmup_periods", profiling_warmup_);
+  getOptionalParamCheck(nh_, "LibcameraRosDriver", "profiling/baseline_output", profiling_baseline_output_);
+
+  // the baseline lists only the stages that were measured
+  nh_.getParam("profiling/baseline/calibration", profiling_baseline_.calibration);
+  for (std::size_t i = 0; i < frame_stage_count; i++) {
+    nh_.getParam("profiling/baseline/" + to_string(FrameStage(i)), profiling_baseline_.ms_per_frame[i]);
+  }
 
 
   if (!success) {
@@ -181,309 +553,556 @@ void LibcameraRosDriver::onInit() {
     return;
   }
 
+  camera_name_ = camera_name;
+
   //}
 
-  // start camera manager and check for cameras
-  camera_manager_.start();
-  if (camera_manager_.cameras().empty()) {
-    ROS_ERROR("[LibcameraRosDriver]: no cameras available");
+  /* pixel kernels //{ */
+
+  try {
+    select_kernel_backend(kernel_backend);
+  }
+  catch (const std::runtime_error &e) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: " << e.what());
     ros::shutdown();
     return;
   }
 
-  if (!camera_name.empty()) {
-    std::vector<std::string> available_cameras;
-    ROS_INFO_STREAM("[LibcameraRosDriver]: Available cameras:");
-    for (int i = 0; i < camera_manager_.cameras().size(); i++) {
-      available_cameras.push_back(camera_manager_.cameras().at(i)->id());
+  {
+    std::string available;
+    for (const KernelBackend backend : available_kernel_backends()) {
+      available += (available.empty() ? "" : ", ") + to_string(backend);
+    }
+    ROS_INFO_STREAM("[LibcameraRosDriver]: using " << to_string(kernels().backend) << " pixel kernels (available: " << available << ")");
+  }
+
+  //}
+
+  /* camera backend //{ */
+
+  PlaybackBackend *playback = nullptr;
+
+  if (backend == "libcamera") {
+    backend_ = std::make_unique<LibcameraBackend>();
+  } else if (backend == "mock") {
+
+    for (const std::string &format : mock_formats) {
+      mock_options.formats.push_back(libcamera::PixelFormat::fromString(format));
     }
-    for (int i = 0; i < available_cameras.size(); i++) {
-      if (available_cameras.at(i).find(camera_name) != std::string::npos) {
-        ROS_INFO_STREAM("[LibcameraRosDriver]: found camera: " << camera_name << " index: " << i << " at: " << available_cameras.at(i));
-        camera_id = i;
-        break;
+    mock_options.stride_alignment = std::max(mock_stride_alignment, 1);
+    mock_options.buffers          = std::max(mock_buffers, 1);
+    mock_options.seed             = mock_seed;
+
+    if (!mock_trace.empty()) {
+      try {
+        mock_options.trace = load_completion_trace(mock_trace);
+      }
+      catch (const std::runtime_error &e) {
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: " << e.what());
+        ros::shutdown();
+        return;
       }
+      ROS_INFO_STREAM("[LibcameraRosDriver]: replaying " << mock_options.trace.size() << " request completions from \"" << mock_trace << "\""
+                                                         << (mock_options.trace_loop ? " in a loop" : ""));
     }
-  }
 
-  if (camera_id >= camera_manager_.cameras().size()) {
-    ROS_INFO_STREAM(camera_manager_);
-    ROS_ERROR_STREAM("[LibcameraRosDriver]: camera with id " << camera_name << " does not exist");
+    backend_ = std::make_unique<MockBackend>(mock_options);
+  } else if (backend == "playback") {
+
+    if (playback_pacing != "realtime" && playback_pacing != "fast") {
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: invalid playback pacing: \"" << playback_pacing << "\"");
+      ros::shutdown();
+      return;
+    }
+
+    auto playback_backend = std::make_unique<PlaybackBackend>(playback_source, playback_pacing == "fast" ? PlaybackPacing::FAST : PlaybackPacing::REALTIME,
+                                                              playback_loop, playback_fps, std::max(playback_stride, 0));
+    playback = playback_backend.get();
+    backend_ = std::move(playback_backend);
+
+    // the fast pacing has no frame rate to keep
+    if (playback_pacing == "realtime") {
+      target_fps_ = playback_fps;
+    }
+  } else {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: invalid backend: \"" << backend << "\"");
     ros::shutdown();
     return;
   }
-  camera_ = camera_manager_.cameras().at(camera_id);
-  ROS_INFO_STREAM("[LibcameraRosDriver]: Use camera by id: " << camera_id);
 
-  if (!camera_) {
-    ROS_INFO_STREAM("[LibcameraRosDriver]: " << camera_manager_);
-    ROS_ERROR_STREAM("[LibcameraRosDriver]: "
-                     << "camera with name " << camera_name << " does not exist");
+  // the automatic format starts from the default of the camera, the formats it offers are known once it is configured
+  auto_format_ = pixel_format == "auto";
+
+  stream_request_.camera_name  = camera_name;
+  stream_request_.camera_id    = camera_id;
+  stream_request_.stream_role  = stream_role;
+  stream_request_.pixel_format = auto_format_ ? "" : pixel_format;
+  stream_request_.size         = libcamera::Size(resolution_width, resolution_height);
+
+  try {
+    stream_info_ = backend_->configure(stream_request_);
+
+    if (auto_format_ && backend_->formats().size() < 2) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: the " << backend << " backend offers no choice of pixel formats, keeping \"" << stream_info_.format << "\"");
+      auto_format_ = false;
+    }
+
+    // until there are subscribers the format is chosen for raw subscribers of the expected encodings
+    if (auto_format_) {
+      FormatDemand initial;
+      initial.raw       = true;
+      initial.encodings = auto_format_encodings_;
+
+      const std::optional<libcamera::PixelFormat> format = select_format(backend_->formats(), initial);
+      if (format && *format != stream_info_.format) {
+        stream_request_.pixel_format = format->toString();
+        stream_info_                 = backend_->configure(stream_request_);
+      }
+      ROS_INFO_STREAM("[LibcameraRosDriver]: pixel format negotiated from the demand of the subscribers, starting with \"" << stream_info_.format << "\"");
+    }
+  }
+  catch (const std::runtime_error &e) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to configure the " << backend << " backend: " << e.what());
     ros::shutdown();
     return;
   }
 
-  if (camera_->acquire()) {
-    ROS_ERROR("[LibcameraRosDriver]: failed to acquire camera");
+  if (format_type(stream_info_.format) == FormatType::PACKED) {
+    ROS_WARN_STREAM("[LibcameraRosDriver]: packed pixel format \"" << stream_info_.format << "\" is not published, its frames are only recorded and written as DNG files");
+  } else if (format_type(stream_info_.format) != FormatType::RAW) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: unsupported pixel format: \"" << stream_info_.format << "\"");
     ros::shutdown();
     return;
   }
 
-  // configure camera stream
-  std::unique_ptr<libcamera::CameraConfiguration> cfg = camera_->generateConfiguration({get_role(stream_role)});
+  //}
+
+  /* colour LUT //{ */
 
-  if (!cfg) {
-    ROS_ERROR("[LibcameraRosDriver]: failed to generate configuration");
-    ros::shutdown();
-    return;
+  applyStreamFormat();
+
+  // with the automatic format the stages are kept for the formats they apply to
+  if (!color_lut_file.empty()) {
+
+    if (!color_lut_channels_ && !auto_format_) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: colour LUT can not be applied to \"" << get_ros_encoding(stream_info_.format) << "\" images, ignoring it");
+    } else {
+
+      try {
+        color_lut_ = std::make_shared<const ColorLut3D>(load_cube_lut(color_lut_file));
+      }
+      catch (const std::runtime_error &e) {
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to load colour LUT: " << e.what());
+        ros::shutdown();
+        return;
+      }
+
+      ROS_INFO_STREAM("[LibcameraRosDriver]: loaded " << color_lut_->size << "^3 colour LUT \"" << color_lut_->title << "\"");
+    }
   }
 
-  libcamera::StreamConfiguration &scfg = cfg->at(0);
+  //}
 
-  // get common pixel formats that are supported by the camera and the node
-  const libcamera::StreamFormats            stream_formats = get_common_stream_formats(scfg.formats());
-  const std::vector<libcamera::PixelFormat> common_fmt     = stream_formats.pixelformats();
+  /* raw correction //{ */
 
-  if (common_fmt.empty()) {
-    ROS_ERROR("[LibcameraRosDriver]: camera does not provide any of the supported pixel formats");
-    ros::shutdown();
-    return;
+  if (raw_correction_) {
+
+    if (!bayer_order_ && !auto_format_) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: raw correction requires a Bayer pixel format, got \"" << stream_info_.format << "\", ignoring it");
+      raw_correction_ = false;
+    } else if (!defect_map_file.empty()) {
+
+      try {
+        defect_pixels_ = load_defect_map(defect_map_file);
+      }
+      catch (const std::runtime_error &e) {
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to load defect map: " << e.what());
+        ros::shutdown();
+        return;
+      }
+
+      ROS_INFO_STREAM("[LibcameraRosDriver]: loaded " << defect_pixels_.size() << " defect pixels");
+    }
   }
 
-  if (pixel_format.empty()) {
+  //}
 
-    // auto select first common pixel format
-    scfg.pixelFormat = common_fmt.front();  // get pixel format from provided string
-    ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
-    ROS_WARN_STREAM("[LibcameraRosDriver]: no pixel format selected, using default: \"" << scfg.pixelFormat << "\"");
-    ROS_WARN_STREAM("[LibcameraRosDriver]: set parameter 'pixel_format' to silent this warning");
-  } else {
+  /* temporal denoise //{ */
 
-    // get pixel format from provided string
-    const libcamera::PixelFormat format_requested = libcamera::PixelFormat::fromString(pixel_format);
+  if (temporal_denoise) {
 
-    if (!format_requested.isValid()) {
-      ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: invalid pixel format: \"" << pixel_format << "\"");
-      ros::shutdown();
-      return;
+    if (!temporal_denoise_format_ && !auto_format_) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: temporal denoise requires 8-bit samples, got \"" << stream_info_.format << "\", ignoring it");
+    } else {
+      temporal_denoise_ = std::make_unique<TemporalDenoise>(temporal_denoise_strength, std::max(temporal_denoise_motion, 1),
+                                                            std::max(temporal_denoise_threads, 1));
     }
+  }
 
-    // check that the requested format is supported by camera and the node
-    if (std::find(common_fmt.begin(), common_fmt.end(), format_requested) == common_fmt.end()) {
-      ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: unsupported pixel format \"" << pixel_format << "\"");
-      ros::shutdown();
-      return;
+  //}
+
+  /* tensor output //{ */
+
+  if (tensor) {
+
+    if (!TensorConverter::supports(get_ros_encoding(stream_info_.format)) && !auto_format_) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: tensors can only be computed from 8-bit mono, RGB and BGR images, got \"" << stream_info_.format
+                                                                                                                      << "\", ignoring the tensor output");
+    } else {
+
+      TensorConfig config;
+      config.width            = std::max(tensor_width, 1);
+      config.height           = std::max(tensor_height, 1);
+      config.rgb              = tensor_order != "bgr";
+      config.quant_scale      = tensor_qscale;
+      config.quant_zero_point = tensor_qzero;
+      config.pad              = uint8_t(std::clamp(tensor_pad, 0, 255));
+
+      // a single value applies to every channel
+      for (std::size_t c = 0; c < 3; c++) {
+        if (!tensor_mean.empty()) {
+          config.mean[c] = tensor_mean[std::min(c, tensor_mean.size() - 1)];
+        }
+        if (!tensor_scale.empty()) {
+          config.scale[c] = tensor_scale[std::min(c, tensor_scale.size() - 1)];
+        }
+      }
+
+      try {
+        config.layout     = tensor_layout_from_string(tensor_layout);
+        config.type       = tensor_type_from_string(tensor_dtype);
+        tensor_converter_ = std::make_unique<TensorConverter>(config, std::max(tensor_threads, 1));
+      }
+      catch (const std::runtime_error &e) {
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: invalid tensor output: " << e.what());
+        ros::shutdown();
+        return;
+      }
+
+      ROS_INFO_STREAM("[LibcameraRosDriver]: publishing " << to_string(config.layout) << " " << to_string(config.type) << " tensors of " << config.width << "x"
+                                                          << config.height);
     }
+  }
 
-    scfg.pixelFormat = format_requested;
+  //}
+
+  /* MJPEG preview //{ */
+
+  if (preview) {
+
+    if (!PreviewEncoder::available()) {
+      ROS_WARN("[LibcameraRosDriver]: the driver was built without libjpeg, ignoring the preview");
+    } else if (!PreviewEncoder::supports(get_ros_encoding(stream_info_.format)) && !auto_format_) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: the preview can only be encoded from 8-bit mono, RGB and BGR images, got \"" << stream_info_.format
+                                                                                                                          << "\", ignoring it");
+    } else {
+
+      try {
+        preview_encoder_ = std::make_unique<PreviewEncoder>(std::max(preview_width, 1), preview_quality);
+        preview_server_  = std::make_unique<MjpegServer>(preview_address, uint16_t(std::clamp(preview_port, 0, 65535)), std::max(preview_max_clients, 1));
+      }
+      catch (const std::runtime_error &e) {
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to start the preview: " << e.what());
+        ros::shutdown();
+        return;
+      }
+
+      preview_interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / std::max(preview_fps, 0.1)));
+
+      ROS_INFO_STREAM("[LibcameraRosDriver]: serving the preview on http://" << preview_address << ":" << preview_server_->port() << "/stream");
+    }
   }
 
-  const libcamera::Size size(resolution_width, resolution_height);
+  //}
+
+  /* control parameters //{ */
 
-  if (size.isNull()) {
-    ROS_INFO_STREAM(scfg);
-    scfg.size = scfg.formats().sizes(scfg.pixelFormat).back();
-    ROS_WARN_STREAM("[LibcameraRosDriver]: no dimensions selected, auto-selecting: \"" << scfg.size << "\"");
-    ROS_WARN_STREAM("[LibcameraRosDriver]: set parameters 'resolution/width' and 'resolution/height' to silent this warning");
+  if (backend_->controls().empty()) {
+    ROS_WARN_STREAM("[LibcameraRosDriver]: the " << backend << " backend has no controls, ignoring the control parameters");
   } else {
-    scfg.size = size;
-  }
 
-  // store selected stream configuration
-  const libcamera::StreamConfiguration selected_scfg = scfg;
+    declareControlParameters();
 
-  switch (cfg->validate()) {
+    int              param_int;
+    float            param_float;
+    std::string      param_string;
+    bool             param_bool;
+    std::vector<int> param_vector_int;
 
-    case libcamera::CameraConfiguration::Valid: {
-      break;
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/exposure_time", param_int)) {
+      updateControlParameter(pv_to_cv(param_int, parameter_ids_["ExposureTime"]->type()), parameter_ids_["ExposureTime"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/fps", param_float)) {
+      target_fps_        = param_float;
+      int64_t frame_time = 1000000 / param_float;
+      updateControlParameter(pv_to_cv(std::vector<int64_t>{frame_time, frame_time}, parameter_ids_["FrameDurationLimits"]->type()),
+                             parameter_ids_["FrameDurationLimits"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_constraint_mode", param_string)) {
+      updateControlParameter(pv_to_cv(get_ae_constraint_mode(param_string), parameter_ids_["AeConstraintMode"]->type()), parameter_ids_["AeConstraintMode"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/brightness", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["Brightness"]->type()), parameter_ids_["Brightness"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/sharpness", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["Sharpness"]->type()), parameter_ids_["Sharpness"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/awb_enable", param_bool)) {
+      if (parameter_ids_["AwbEnable"])  // if the parameter is set when not available, we would get a segmentation fault upon extracting its ->type()
+        updateControlParameter(pv_to_cv(param_bool, parameter_ids_["AwbEnable"]->type()), parameter_ids_["AwbEnable"]);
+      else
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: Parameter AwbEnable is not available! Maybe the selected camera is grayscale");
+    }
+    /* updateControlParameter<std::vector<float>>(std::string("control/colour_gains"), parameter_ids_["ColourGains"]); */
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_enable", param_bool)) {
+      updateControlParameter(pv_to_cv(param_bool, parameter_ids_["AeEnable"]->type()), parameter_ids_["AeEnable"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/saturation", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["Saturation"]->type()), parameter_ids_["Saturation"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/contrast", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["Contrast"]->type()), parameter_ids_["Contrast"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/exposure_value", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["ExposureValue"]->type()), parameter_ids_["ExposureValue"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/analogue_gain", param_float)) {
+      updateControlParameter(pv_to_cv(param_float, parameter_ids_["AnalogueGain"]->type()), parameter_ids_["AnalogueGain"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/awb_mode", param_string)) {
+      updateControlParameter(pv_to_cv(get_awb_mode(param_string), parameter_ids_["AwbMode"]->type()), parameter_ids_["AwbMode"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_metering_mode", param_string)) {
+      updateControlParameter(pv_to_cv(get_ae_metering_mode(param_string), parameter_ids_["AeMeteringMode"]->type()), parameter_ids_["AeMeteringMode"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/scaler_crop", param_vector_int)) {
+      updateControlParameter(pv_to_cv(std::vector<int64_t>{param_vector_int.begin(), param_vector_int.end()}, parameter_ids_["ScalerCrop"]->type()),
+                             parameter_ids_["ScalerCrop"]);
+    }
+    if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/control", param_string)) {
+      updateControlParameter(pv_to_cv(get_ae_exposure_mode(param_string), parameter_ids_["AeExposureMode"]->type()), parameter_ids_["AeExposureMode"]);
     }
 
-    case libcamera::CameraConfiguration::Adjusted: {
-
-      if (selected_scfg.pixelFormat != scfg.pixelFormat) {
-        ROS_INFO_STREAM(stream_formats);
+    // the pattern of the sensor still passes through all processing stages
+    if ((test_pattern == "camera" || test_pattern == "auto") && parameter_ids_.count("TestPatternMode")) {
+      if (!updateControlParameter(pv_to_cv(get_test_pattern_mode(test_pattern_camera), parameter_ids_["TestPatternMode"]->type()),
+                                  parameter_ids_["TestPatternMode"])) {
+        ros::shutdown();
+        return;
       }
+      camera_test_pattern = true;
+      ROS_INFO_STREAM("[LibcameraRosDriver]: the camera produces the \"" << test_pattern_camera << "\" test pattern");
+    }
 
-      if (selected_scfg.size != scfg.size) {
-        ROS_INFO_STREAM(scfg);
-      }
+    backend_->setControls(parameters_);
 
-      ROS_WARN_STREAM("[LibcameraRosDriver]: stream configuration adjusted from \"" << selected_scfg.toString() << "\" to \"" << scfg.toString() << "\"");
+    control_descriptors_.emplace(backend_->controls());
 
-      break;
+    std::string commanded;
+    for (std::size_t i = 0; i < control_slot_count; i++) {
+      if (control_descriptors_->available(ControlSlot(i))) {
+        commanded += (commanded.empty() ? "" : ", ") + to_string(ControlSlot(i));
+      }
     }
+    ROS_INFO_STREAM("[LibcameraRosDriver]: controls accepted on control_command: " << (commanded.empty() ? "none" : commanded));
+  }
 
-    case libcamera::CameraConfiguration::Invalid: {
+  //}
 
-      ROS_ERROR("[LibcameraRosDriver]: failed to valid stream configuration");
-      ros::shutdown();
+  /* test pattern //{ */
 
-      return;
-      break;
-    }
+  if (test_pattern != "off" && test_pattern != "auto" && test_pattern != "camera" && test_pattern != "software") {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: invalid test pattern mode: \"" << test_pattern << "\"");
+    ros::shutdown();
+    return;
   }
 
-  if (camera_->configure(cfg.get()) < 0) {
-    ROS_ERROR("[LibcameraRosDriver]: failed to configure streams");
+  if (test_pattern == "camera" && !camera_test_pattern) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: the " << backend_->id() << " camera has no test pattern control");
     ros::shutdown();
     return;
   }
 
-  ROS_INFO_STREAM("[LibcameraRosDriver]: camera \"" << camera_->id() << "\" configured with " << scfg.toString() << " stream");
+  // without a sensor pattern every published image is replaced by a sequence-dependent software pattern
+  software_test_pattern_ = test_pattern == "software" || (test_pattern == "auto" && !camera_test_pattern);
+  if (software_test_pattern_) {
+    ROS_WARN("[LibcameraRosDriver]: publishing a software test pattern instead of the camera images");
+  }
 
-  declareControlParameters();
+  //}
 
-  int              param_int;
-  float            param_float;
-  std::string      param_string;
-  bool             param_bool;
-  std::vector<int> param_vector_int;
+  cinfo_ = std::make_shared<camera_info_manager::CameraInfoManager>(nh_, camera_name, calib_url);
 
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/exposure_time", param_int)) {
-    updateControlParameter(pv_to_cv(param_int, parameter_ids_["ExposureTime"]->type()), parameter_ids_["ExposureTime"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/fps", param_float)) {
-    int64_t frame_time = 1000000 / param_float;
-    updateControlParameter(pv_to_cv(std::vector<int64_t>{frame_time, frame_time}, parameter_ids_["FrameDurationLimits"]->type()),
-                           parameter_ids_["FrameDurationLimits"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_constraint_mode", param_string)) {
-    updateControlParameter(pv_to_cv(get_ae_constraint_mode(param_string), parameter_ids_["AeConstraintMode"]->type()), parameter_ids_["AeConstraintMode"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/brightness", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["Brightness"]->type()), parameter_ids_["Brightness"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/sharpness", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["Sharpness"]->type()), parameter_ids_["Sharpness"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/awb_enable", param_bool)) {
-    if (parameter_ids_["AwbEnable"])  // if the parameter is set when not available, we would get a segmentation fault upon extracting its ->type()
-      updateControlParameter(pv_to_cv(param_bool, parameter_ids_["AwbEnable"]->type()), parameter_ids_["AwbEnable"]);
-    else
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: Parameter AwbEnable is not available! Maybe the selected camera is grayscale");
-  }
-  /* updateControlParameter<std::vector<float>>(std::string("control/colour_gains"), parameter_ids_["ColourGains"]); */
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_enable", param_bool)) {
-    updateControlParameter(pv_to_cv(param_bool, parameter_ids_["AeEnable"]->type()), parameter_ids_["AeEnable"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/saturation", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["Saturation"]->type()), parameter_ids_["Saturation"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/contrast", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["Contrast"]->type()), parameter_ids_["Contrast"]);
-  }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/exposure_value", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["ExposureValue"]->type()), parameter_ids_["ExposureValue"]);
+  // a capture file keeps the calibration it was recorded with
+  if (playback) {
+    const std::optional<sensor_msgs::CameraInfo> recorded = playback->cameraInfo();
+    if (recorded) {
+      cinfo_->setCameraInfo(*recorded);
+    }
   }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/analogue_gain", param_float)) {
-    updateControlParameter(pv_to_cv(param_float, parameter_ids_["AnalogueGain"]->type()), parameter_ids_["AnalogueGain"]);
+
+  camera_info_ = cinfo_->getCameraInfo();
+
+  /* initialize publishers //{ */
+
+  // the transports are loaded and advertised as image_transport does it, including its disable_pub_plugins parameter
+  const std::string image_topic = nh_.resolveName("image_raw");
+
+  std::vector<std::string> disabled_transports;
+  nh_.getParam(image_topic + "/disable_pub_plugins", disabled_transports);
+
+  transport_loader_ = std::make_unique<pluginlib::ClassLoader<image_transport::PublisherPlugin>>("image_transport", "image_transport::PublisherPlugin");
+
+  for (const std::string &lookup_name : transport_loader_->getDeclaredClasses()) {
+    if (std::find(disabled_transports.begin(), disabled_transports.end(), lookup_name) != disabled_transports.end()) {
+      continue;
+    }
+
+    try {
+      image_output_t output;
+      output.publisher = transport_loader_->createInstance(lookup_name);
+      output.publisher->advertise(nh_, image_topic, 5);
+
+      const boost::shared_ptr<image_transport::PublisherPlugin> publisher = output.publisher;
+      output.counters = &output_accounting_.add(publisher->getTopic(), publisher->getTransportName(), [publisher] { return publisher->getNumSubscribers(); });
+      output.raw      = publisher->getTransportName() == "raw";
+
+      image_outputs_.push_back(output);
+    }
+    catch (const pluginlib::PluginlibException &e) {
+      ROS_WARN_STREAM("[LibcameraRosDriver]: failed to load the image transport \"" << lookup_name << "\": " << e.what());
+    }
   }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/awb_mode", param_string)) {
-    updateControlParameter(pv_to_cv(get_awb_mode(param_string), parameter_ids_["AwbMode"]->type()), parameter_ids_["AwbMode"]);
+
+  if (image_outputs_.empty()) {
+    ROS_ERROR("[LibcameraRosDriver]: no image transport could be loaded");
+    ros::shutdown();
+    return;
   }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/ae_metering_mode", param_string)) {
-    updateControlParameter(pv_to_cv(get_ae_metering_mode(param_string), parameter_ids_["AeMeteringMode"]->type()), parameter_ids_["AeMeteringMode"]);
+
+  camera_info_pub_      = nh_.advertise<sensor_msgs::CameraInfo>(image_transport::getCameraInfoTopic(image_topic), 5);
+  camera_info_counters_ = &output_accounting_.add(camera_info_pub_.getTopic(), "", [this] { return camera_info_pub_.getNumSubscribers(); });
+
+  if (tensor_converter_) {
+    tensor_pub_      = nh_.advertise<libcamera_ros_driver::Tensor>("tensor", 2);
+    tensor_counters_ = &output_accounting_.add(tensor_pub_.getTopic(), "", [this] { return tensor_pub_.getNumSubscribers(); });
   }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/scaler_crop", param_vector_int)) {
-    updateControlParameter(pv_to_cv(std::vector<int64_t>{param_vector_int.begin(), param_vector_int.end()}, parameter_ids_["ScalerCrop"]->type()),
-                           parameter_ids_["ScalerCrop"]);
+
+  if (preview_server_) {
+    const std::string url = "http://" + preview_address + ":" + std::to_string(preview_server_->port()) + "/stream";
+    preview_counters_     = &output_accounting_.add(url, "mjpeg", [this] { return preview_server_->clients(); });
   }
-  if (getOptionalParamCheck(nh_, "LibcameraRosDriver", "control/control", param_string)) {
-    updateControlParameter(pv_to_cv(get_ae_exposure_mode(param_string), parameter_ids_["AeExposureMode"]->type()), parameter_ids_["AeExposureMode"]);
+
+  output_stats_pub_ = nh_.advertise<libcamera_ros_driver::OutputStatsArray>("output_stats", 1, true);
+
+  //}
+
+  /* initialize subscribers //{ */
+
+  // the latest command is the one that counts, without delaying it for batching
+  if (control_descriptors_) {
+    subscriber_control_command_ =
+        nh_.subscribe("control_command", 1, &LibcameraRosDriver::callbackControlCommand, this, ros::TransportHints().tcpNoDelay());
   }
 
-  // allocate stream buffers and create one request per buffer
-  stream_ = scfg.stream();
+  //}
 
-  allocator_ = std::make_shared<libcamera::FrameBufferAllocator>(camera_);
-  allocator_->allocate(stream_);
+  /* initialize services //{ */
 
-  for (const std::unique_ptr<libcamera::FrameBuffer> &buffer : allocator_->buffers(stream_)) {
+  service_server_set_color_lut_ = nh_.advertiseService("set_color_lut", &LibcameraRosDriver::callbackSetColorLut, this);
+  service_server_recorder_      = nh_.advertiseService("recorder/set_recording", &LibcameraRosDriver::callbackRecorder, this);
+  service_server_capture_dng_   = nh_.advertiseService("dng/capture", &LibcameraRosDriver::callbackCaptureDng, this);
 
-    std::unique_ptr<libcamera::Request> request = camera_->createRequest();
+  if (histograms) {
+    service_server_latency_stats_ = nh_.advertiseService("get_latency_stats", &LibcameraRosDriver::callbackGetLatencyStats, this);
+  }
 
-    if (!request) {
-      ROS_ERROR("[LibcameraRosDriver]: Can't create request");
-      ros::shutdown();
-      return;
-    }
+  service_server_output_stats_ = nh_.advertiseService("get_output_stats", &LibcameraRosDriver::callbackGetOutputStats, this);
 
-    // multiple planes of the same buffer use the same file descriptor
-    size_t buffer_length = 0;
-    int    fd            = -1;
-    for (const libcamera::FrameBuffer::Plane &plane : buffer->planes()) {
+  service_server_register_roi_   = nh_.advertiseService("register_roi", &LibcameraRosDriver::callbackRegisterRoi, this);
+  service_server_unregister_roi_ = nh_.advertiseService("unregister_roi", &LibcameraRosDriver::callbackUnregisterRoi, this);
 
-      if (plane.offset == libcamera::FrameBuffer::Plane::kInvalidOffset) {
-        ROS_ERROR("[LibcameraRosDriver]: invalid offset");
-        ros::shutdown();
-        return;
-      }
+  //}
 
-      buffer_length = std::max<size_t>(buffer_length, plane.offset + plane.length);
+  /* initialize timers //{ */
 
-      if (!plane.fd.isValid()) {
-        ROS_ERROR("[LibcameraRosDriver]: file descriptor is not valid");
-        ros::shutdown();
-        return;
-      }
+  // published on /diagnostics with the period of the diagnostic_period parameter
+  diagnostics_ = std::make_unique<diagnostic_updater::Updater>(nh_, nh_);
+  diagnostics_->setHardwareID(backend_->id());
+  diagnostics_->add("frames", this, &LibcameraRosDriver::diagnosticsFrames);
+  diagnostics_last_.stamp = ros::WallTime::now();
+  timer_diagnostics_      = nh_.createTimer(ros::Duration(0.1), &LibcameraRosDriver::timerDiagnostics, this);
 
-      if (fd == -1) {
-        fd = plane.fd.get();
-      } else if (fd != plane.fd.get()) {
-        ROS_ERROR("[LibcameraRosDriver]: plane file descriptors differ");
-        ros::shutdown();
-        return;
-      }
-    }
+  output_stats_start_ = ros::WallTime::now();
+  timer_output_stats_ = nh_.createTimer(ros::Duration(std::max(output_stats_period, 0.1)), &LibcameraRosDriver::timerOutputStats, this);
 
-    // memory-map the frame buffer planes
-    void *data = mmap(nullptr, buffer_length, PROT_READ, MAP_SHARED, fd, 0);
+  // removes the regions of clients that are gone
+  timer_rois_ = nh_.createTimer(ros::Duration(1.0), &LibcameraRosDriver::timerRois, this);
 
-    if (data == MAP_FAILED) {
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: mmap failed: " << std::string(std::strerror(errno)));
-      ros::shutdown();
-      return;
-    }
+  // picks up calibrations set through the set_camera_info service
+  timer_camera_info_ = nh_.createTimer(ros::Duration(1.0), &LibcameraRosDriver::timerCameraInfo, this);
 
-    buffer_info_[buffer.get()] = {data, buffer_length};
+  if (profiling) {
 
-    if (request->addBuffer(stream_, buffer.get()) < 0) {
-      ROS_ERROR("[LibcameraRosDriver]: Can't set buffer for request");
-      ros::shutdown();
-      return;
-    }
+    // the baselines are scaled by the speed of this machine relative to the one they were taken on
+    profiling_best_.calibration = calibrate_machine();
+    profiling_best_.ms_per_frame.fill(0.0);
 
-    // set modified control parameters
-    for (const auto &[id, value] : parameters_) {
-      request->controls().set(id, value);
+    const bool has_baseline =
+        std::any_of(profiling_baseline_.ms_per_frame.begin(), profiling_baseline_.ms_per_frame.end(), [](const double ms) { return ms > 0.0; });
+    if (has_baseline) {
+      if (profiling_baseline_.calibration <= 0.0) {
+        ROS_WARN("[LibcameraRosDriver]: profiling: the baseline has no calibration, it is used unscaled");
+        profiling_baseline_.calibration = profiling_best_.calibration;
+      }
+      ROS_INFO_STREAM("[LibcameraRosDriver]: profiling: checking against a baseline with tolerance " << profiling_tolerance_ * 100.0
+                                                                                                     << " %, machine speed relative to the baseline "
+                                                                                                     << profiling_baseline_.calibration / profiling_best_.calibration);
     }
 
-    requests_.push_back(std::move(request));
+    profiling_pub_   = nh_.advertise<libcamera_ros_driver::ProfilingReport>("profiling", 10);
+    profiling_start_ = ros::WallTime::now();
+    profiler_        = std::make_unique<FrameProfiler>();
+    timer_profiling_ = nh_.createTimer(ros::Duration(std::max(profiling_period, 0.1)), &LibcameraRosDriver::timerProfiling, this);
   }
 
-  cinfo_ = std::make_shared<camera_info_manager::CameraInfoManager>(nh_, camera_name, calib_url);
-
-  /* initialize publishers //{ */
+  //}
 
-  image_transport::ImageTransport it(nh_);
-  image_pub_ = it.advertiseCamera("image_raw", 5);
+  if (!trace_file.empty()) {
+    std::ostringstream comment;
+    comment << "request completions of " << backend_->id() << ", " << stream_info_.size.width << "x" << stream_info_.size.height << "-"
+            << stream_info_.format << ", stride " << stream_info_.stride;
+    try {
+      trace_writer_ = std::make_unique<CompletionTraceWriter>(trace_file, comment.str());
+    }
+    catch (const std::runtime_error &e) {
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: " << e.what());
+      ros::shutdown();
+      return;
+    }
+    ROS_INFO_STREAM("[LibcameraRosDriver]: tracing the request completions to \"" << trace_file << "\"");
+  }
 
-  //}
+  if (histograms) {
+    histograms_              = std::make_unique<LatencyHistograms>();
+    histograms_window_start_ = ros::WallTime::now();
+    backend_->setHistograms(histograms_.get());
 
-  // register callback
-  camera_->requestCompleted.connect(this, &LibcameraRosDriver::requestComplete);
+    // recordings keep the timestamps of the time they were taken
+    sensor_clock_monotonic_ = backend != "playback";
+  }
 
-  // start camera and queue all requests
-  if (camera_->start()) {
-    ROS_ERROR("[LibcameraRosDriver]: failed to start camera");
+  try {
+    startBackend();
+  }
+  catch (const std::runtime_error &e) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: " << e.what());
     ros::shutdown();
     return;
   }
 
-  for (std::unique_ptr<libcamera::Request> &request : requests_) {
-    camera_->queueRequest(request.get());
+  if (auto_format_) {
+    timer_auto_format_ = nh_.createTimer(ros::Duration(std::max(auto_format_period, 0.1)), &LibcameraRosDriver::timerAutoFormat, this);
   }
 
   // | --------------------- finish the init -------------------- |
@@ -496,25 +1115,23 @@ void LibcameraRosDriver::onInit() {
 
 LibcameraRosDriver::~LibcameraRosDriver() {
 
-  camera_->requestCompleted.disconnect();
+  // stop the frame source first, no frame is processed afterwards
+  if (backend_) {
+    backend_->stop();
+  }
 
   {
-    std::scoped_lock lock(request_lock_);
-
-    if (camera_->stop()) {
-      ROS_ERROR("[LibcameraRosDriver]: failed to stop camera");
-    }
+    std::scoped_lock lock(recorder_mutex_);
+    recorder_.reset();
   }
 
-  camera_->release();
-  camera_manager_.stop();
-
-  for (const auto &e : buffer_info_) {
-    if (munmap(e.second.data, e.second.size) == -1) {
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: "
-                       << "munmap failed: " << std::strerror(errno));
-    }
+  // the queued stills are written first
+  {
+    std::scoped_lock lock(dng_mutex_);
+    dng_writer_.reset();
   }
+
+  backend_.reset();
 }
 
 //}
@@ -525,7 +1142,7 @@ void LibcameraRosDriver::declareControlParameters() {
 
   ROS_INFO("[LibcameraRosDriver]: available control parameters:");
 
-  for (const auto &[id, info] : camera_->controls()) {
+  for (const auto &[id, info] : backend_->controls()) {
 
     std::size_t extent;
     try {
@@ -563,7 +1180,7 @@ bool LibcameraRosDriver::updateControlParameter(const libcamera::ControlValue &v
   }
 
   // verify parameter type and dimension against default
-  const libcamera::ControlInfo &ci = camera_->controls().at(id);
+  const libcamera::ControlInfo &ci = backend_->controls().at(id);
 
   if (value.type() != id->type()) {
     ROS_ERROR_STREAM("[LibcameraRosDriver]: " << id->name().c_str() << " : parameter types mismatch, expected '" << std::to_string(id->type()).c_str()
@@ -594,93 +1211,1289 @@ bool LibcameraRosDriver::updateControlParameter(const libcamera::ControlValue &v
 
 //}
 
-/* LibcameraRosDriver::requestComplete() //{ */
+/* LibcameraRosDriver::applyStreamFormat() //{ */
 
-void LibcameraRosDriver::requestComplete(libcamera::Request *request) {
+// the processing stages that depend on the pixel format of the stream
+void LibcameraRosDriver::applyStreamFormat() {
 
-  std::scoped_lock lock(request_lock_);
+  namespace enc = sensor_msgs::image_encodings;
 
-  if (request->status() == libcamera::Request::RequestComplete) {
+  const std::string encoding = get_ros_encoding(stream_info_.format);
+
+  color_lut_channels_ = 0;
+  color_lut_bgr_      = false;
+  if (encoding == enc::BGR8 || encoding == enc::RGB8 || encoding == enc::BGRA8 || encoding == enc::RGBA8) {
+    color_lut_channels_ = enc::numChannels(encoding);
+    color_lut_bgr_      = (encoding == enc::BGR8 || encoding == enc::BGRA8);
+  }
 
-    assert(request->buffers().size() == 1);
+  bayer_order_             = get_bayer_order(stream_info_.format);
+  temporal_denoise_format_ = !encoding.empty() && enc::bitDepth(encoding) == 8;
+}
 
-    // get the stream and buffer from the request
-    const libcamera::FrameBuffer *  buffer    = request->findBuffer(stream_);
-    const libcamera::FrameMetadata &metadata  = buffer->metadata();
-    size_t                          bytesused = 0;
+//}
 
-    for (const libcamera::FrameMetadata::Plane &plane : metadata.planes()) {
-      bytesused += plane.bytesused;
-    }
+/* LibcameraRosDriver::startBackend() //{ */
 
-    // send image data
-    std_msgs::Header hdr;
+void LibcameraRosDriver::startBackend() {
 
-    hdr.stamp = ros::Time().fromNSec(metadata.timestamp);
-    if (_use_ros_time_) {
-      if (!start_time_offset_obtained_) {
-        start_time_offset_          = ros::Time::now() - hdr.stamp;
-        start_time_offset_obtained_ = true;
-      }
-      hdr.stamp += start_time_offset_;
-    }
-
-    hdr.frame_id                              = frame_id_;
-    const libcamera::StreamConfiguration &cfg = stream_->configuration();
-
-    sensor_msgs::Image image_msg;
-
-    if (format_type(cfg.pixelFormat) == FormatType::RAW) {
-      // raw uncompressed image
-      assert(buffer_info_[buffer].size == bytesused);
-      image_msg.header       = hdr;
-      image_msg.width        = cfg.size.width;
-      image_msg.height       = cfg.size.height;
-      image_msg.encoding     = get_ros_encoding(cfg.pixelFormat);
-      image_msg.is_bigendian = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
-      if (!remove_stride_)
-      {
-        image_msg.step = cfg.stride;
-        image_msg.data.resize(buffer_info_[buffer].size);
-        memcpy(image_msg.data.data(), buffer_info_[buffer].data, buffer_info_[buffer].size);
-      }
-      else{
-        // TODO: Change 3 by the number of bytes per pixel
-        // TODO: Little endian vs big endian
-        image_msg.step = cfg.size.width * 3;
-        image_msg.data.resize(cfg.size.width * cfg.size.height * 3);
-
-        // each row of the image is stored in memory as RGBRGBRGB...00000 with stride padding
-        // remove the padding to get the correct image
-        for (int i = 0; i < cfg.size.height; i++)
-        {
-          //memcpy(image_msg.data.data() + i * cfg.size.width * 3, buffer_info_[buffer].data + i * cfg.stride, cfg.size.width * 3);
-          // the previous line causes error arithmetic on a pointer to void
-          memcpy(image_msg.data.data() + i * cfg.size.width * 3, static_cast<uint8_t*>(buffer_info_[buffer].data) + i * cfg.stride, cfg.size.width * 3);
+  // frames of every backend take the same path
+  backend_->start(
+      [this](const FrameView &frame) {
+        if (trace_writer_) {
+          trace_writer_->complete(frame);
         }
-      }
+        processFrame(frame);
+      },
+      [this](const std::string &reason) {
+        requests_cancelled_++;
+        if (trace_writer_) {
+          trace_writer_->cancelled();
+        }
+        ROS_ERROR_STREAM("[LibcameraRosDriver]: " << reason);
+      });
+}
 
-    } else {
-      ROS_ERROR_STREAM("[LibcameraRosDriver]: unsupported pixel format: " << stream_->configuration().pixelFormat.toString());
-      return;
+//}
+
+/* LibcameraRosDriver::reconfigureFormat() //{ */
+
+bool LibcameraRosDriver::reconfigureFormat(const libcamera::PixelFormat &format) {
+
+  // a capture file has a single format, the recording and the pending stills are finished first, and neither can be
+  // started until the camera runs again
+  {
+    std::scoped_lock lock(recorder_mutex_, dng_mutex_);
+    if ((recorder_ && recorder_->recording()) || dng_pending_) {
+      return false;
     }
+    reconfiguring_ = true;
+  }
 
-    sensor_msgs::CameraInfo cinfo_msg = cinfo_->getCameraInfo();
-    cinfo_msg.header                  = hdr;
+  const StreamInfo previous = stream_info_;
 
-    {
-      std::scoped_lock lock(image_pub_mutex_);
+  // no frame is processed between stop() and start(), the frame path needs no lock for the stream state; the frame
+  // path takes the recorder lock, it is only held once the camera is stopped
+  backend_->stop();
+
+  std::scoped_lock lock(recorder_mutex_, dng_mutex_);
+
+  // the slots of the recorder have the size of the frames of the previous stream, the DNG writer also has its
+  // layout, the stills it has queued are written first
+  recorder_.reset();
+  dng_writer_.reset();
+
+  StreamRequest request = stream_request_;
+  request.pixel_format  = format.toString();
 
-      image_pub_.publish(image_msg, cinfo_msg);
+  // the region service reads the stream to validate new regions, the update is atomic to it
+  {
+    std::scoped_lock roi_lock(roi_mutex_);
+
+    try {
+      stream_info_ = backend_->configure(request);
+    }
+    catch (const std::runtime_error &e) {
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to reconfigure to \"" << format << "\": " << e.what() << ", restoring \"" << previous.format << "\"");
+      request.pixel_format = previous.format.toString();
+      stream_info_         = backend_->configure(request);
     }
 
-  } else if (request->status() == libcamera::Request::RequestCancelled) {
-    ROS_ERROR_STREAM("[LibcameraRosDriver]: request '" << request->toString() << "' cancelled");
+    stream_request_.pixel_format = request.pixel_format;
+    applyStreamFormat();
+  }
+
+  // the history has the layout of the previous format, also if the size of the frames is the same
+  if (temporal_denoise_) {
+    temporal_denoise_->reset();
   }
 
-  // queue the request again for the next frame
-  request->reuse(libcamera::Request::ReuseBuffers);
-  camera_->queueRequest(request);
+  // the controls are set on the new requests, the sequence numbers of the new stream start over
+  backend_->setControls(parameters_);
+  last_sequence_.reset();
+
+  startBackend();
+  reconfiguring_ = false;
+
+  ROS_INFO_STREAM("[LibcameraRosDriver]: stream reconfigured from \"" << previous.format << "\" to \"" << stream_info_.format << "\"");
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::formatDemand() //{ */
+
+FormatDemand LibcameraRosDriver::formatDemand() {
+
+  FormatDemand demand;
+
+  // the expected encodings can be changed at runtime
+  nh_.getParam("pixel_format_auto/encodings", auto_format_encodings_);
+  demand.encodings = auto_format_encodings_;
+
+  // the tensor is cheapest from an image of its own channel order
+  if (tensor_converter_ && tensor_pub_.getNumSubscribers()) {
+    demand.derived.push_back(tensor_converter_->config().rgb ? sensor_msgs::image_encodings::RGB8 : sensor_msgs::image_encodings::BGR8);
+  }
+
+  // the preview is encoded from the published image, JPEG stores RGB
+  if (preview_server_ && preview_server_->clients()) {
+    demand.derived.push_back(sensor_msgs::image_encodings::RGB8);
+  }
+
+  // the regions are published in the pixel format of the stream, like the raw image
+  {
+    std::scoped_lock lock(roi_mutex_);
+    for (const roi_output_t &output : roi_outputs_) {
+      demand.raw = demand.raw || output.publisher.getNumSubscribers();
+    }
+  }
+
+  std::scoped_lock lock(image_pub_mutex_);
+
+  for (const image_output_t &output : image_outputs_) {
+    if (!output.publisher->getNumSubscribers()) {
+      continue;
+    }
+
+    if (output.raw) {
+      demand.raw = true;
+    } else {
+      demand.transports.push_back(output.publisher->getTransportName());
+    }
+  }
+
+  return demand;
+}
+
+//}
+
+/* LibcameraRosDriver::processFrame() //{ */
+
+void LibcameraRosDriver::processFrame(const FrameView &frame) {
+
+  StageTimer timer(profiler_.get(), histograms_.get());
+
+  // the sensor timestamps are CLOCK_MONOTONIC like the steady clock
+  const auto since_exposure = [&frame]() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - int64_t(frame.timestamp);
+  };
+
+  if (histograms_ && sensor_clock_monotonic_) {
+    histograms_->record(LatencyStage::SENSOR_TO_CALLBACK, std::max<int64_t>(since_exposure(), 0));
+  }
+
+  const std::chrono::steady_clock::time_point processing_start = std::chrono::steady_clock::now();
+
+  // every gap in the sequence numbers of the sensor is a frame lost before it reached the driver
+  frames_++;
+  if (last_sequence_ && frame.sequence > *last_sequence_ + 1) {
+    frames_missing_ += frame.sequence - *last_sequence_ - 1;
+  }
+  last_sequence_ = frame.sequence;
+
+  FRAME_TRACEPOINT(frame_begin, frame.sequence, frame.size, frame.request);
+
+  // hand the frame to the recorder first, its copy is done before the buffer is reused
+  bool publish = true;
+  {
+    std::scoped_lock lock(recorder_mutex_);
+
+    if (recorder_ && recorder_->recording()) {
+      FrameRecordHeader record = {};
+      record.sequence          = frame.sequence;
+      record.timestamp         = frame.timestamp;
+      record.exposure_time     = frame.exposure_time.value_or(0);
+      record.analogue_gain     = frame.analogue_gain.value_or(0.0f);
+
+      if (frame.black_levels) {
+        std::copy(frame.black_levels->begin(), frame.black_levels->end(), record.black_levels);
+      }
+
+      recorder_->push(frame.data, frame.size, record);
+      publish = recorder_publish_;
+
+      timer.lap(FrameStage::RECORD, frame.size);
+      FRAME_TRACEPOINT(record_end, frame.sequence, frame.size, frame.request);
+    }
+  }
+
+  // raw stills are copied before the buffer is reused as well, also from the packed formats that are not published
+  if (dng_pending_) {
+    std::scoped_lock lock(dng_mutex_);
+
+    if (dng_writer_ && !dng_paths_.empty()) {
+      DngFrameInfo info;
+      info.sequence      = frame.sequence;
+      info.timestamp     = frame.timestamp;
+      info.exposure_time = frame.exposure_time;
+      info.analogue_gain = frame.analogue_gain;
+      info.black_levels  = frame.black_levels;
+      info.colour_gains  = frame.colour_gains;
+      info.colour_matrix = frame.colour_matrix;
+
+      // the file of a frame that finds all slots in use is written from the next one, every listed file appears
+      if (dng_writer_->push(frame.data, frame.size, info, dng_paths_.front())) {
+        dng_paths_.pop_front();
+      } else {
+        dng_skipped_++;
+        ROS_WARN_STREAM_THROTTLE(1.0, "[LibcameraRosDriver]: all DNG slots are in use, frame " << frame.sequence << " is skipped, \"" << dng_paths_.front()
+                                                                                                << "\" is written from a later one");
+      }
+
+      if (dng_paths_.empty()) {
+        dng_pending_ = false;
+        ROS_INFO_STREAM("[LibcameraRosDriver]: DNG capture queued, " << dng_skipped_ << " frames skipped with all slots in use");
+      }
+    }
+  }
+
+  if (!publish || format_type(stream_info_.format) == FormatType::PACKED) {
+    return;
+  }
+
+  // send image data, into a message of the pool whose buffers already have the size of a frame
+  const sensor_msgs::ImagePtr image_ptr = image_pool_.acquire();
+  sensor_msgs::Image &        image_msg = *image_ptr;
+  std_msgs::Header &          hdr       = image_msg.header;
+
+  hdr.seq   = frame.sequence;
+  hdr.stamp = ros::Time().fromNSec(frame.timestamp);
+  if (_use_ros_time_) {
+    if (!start_time_offset_obtained_) {
+      start_time_offset_          = ros::Time::now() - hdr.stamp;
+      start_time_offset_obtained_ = true;
+    }
+    hdr.stamp += start_time_offset_;
+  }
+
+  hdr.frame_id          = frame_id_;
+  const StreamInfo &cfg = stream_info_;
+
+  if (format_type(cfg.format) == FormatType::RAW) {
+    // raw uncompressed image
+    image_msg.width        = cfg.size.width;
+    image_msg.height       = cfg.size.height;
+    image_msg.encoding     = get_ros_encoding(cfg.format);
+    image_msg.is_bigendian = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+
+    const unsigned int bytes_per_pixel = get_bytes_per_pixel(cfg.format);
+
+    std::shared_ptr<const ColorLut3D> color_lut;
+    {
+      std::scoped_lock lock(color_lut_mutex_);
+      color_lut = color_lut_;
+    }
+
+    if (software_test_pattern_) {
+      // the camera data is discarded, the pattern and its watermark identify the frame
+      image_msg.step = remove_stride_ ? cfg.size.width * bytes_per_pixel : cfg.stride;
+      image_msg.data.resize(image_msg.step * cfg.size.height);
+      write_test_pattern(image_msg.data.data(), image_msg.step, cfg.size.height, frame.sequence);
+    }
+    else if (color_lut && color_lut_channels_) {
+      // the LUT reads the mapped buffer and writes the corrected pixels directly into the message
+      image_msg.step = remove_stride_ ? cfg.size.width * bytes_per_pixel : cfg.stride;
+      image_msg.data.resize(remove_stride_ ? image_msg.step * cfg.size.height : frame.size);
+      apply_color_lut(*color_lut, frame.data, cfg.stride, image_msg.data.data(), image_msg.step, cfg.size.width, cfg.size.height, color_lut_channels_,
+                      color_lut_bgr_);
+    }
+    else if (raw_correction_ && bayer_order_) {
+      // black levels are reported per frame, keep the last known ones if a frame comes without them
+      if (frame.black_levels) {
+        black_levels_ = *frame.black_levels;
+      }
+
+      // the correction is applied while copying out of the mapped buffer
+      image_msg.step = remove_stride_ ? cfg.size.width * bytes_per_pixel : cfg.stride;
+      image_msg.data.resize(remove_stride_ ? image_msg.step * cfg.size.height : frame.size);
+      copy_raw_corrected(frame.data, cfg.stride, image_msg.data.data(), image_msg.step, cfg.size.width, cfg.size.height, 8 * bytes_per_pixel, *bayer_order_,
+                         black_levels_, defect_pixels_);
+    }
+    else if (!remove_stride_)
+    {
+      image_msg.step = cfg.stride;
+      image_msg.data.resize(frame.size);
+      memcpy(image_msg.data.data(), frame.data, frame.size);
+    }
+    else{
+      // TODO: Little endian vs big endian
+      image_msg.step = cfg.size.width * bytes_per_pixel;
+      image_msg.data.resize(image_msg.step * cfg.size.height);
+
+      // each row of the image is stored in memory as RGBRGBRGB...00000 with stride padding
+      // remove the padding to get the correct image
+      kernels().copy_rows(frame.data, cfg.stride, image_msg.data.data(), image_msg.step, image_msg.step, cfg.size.height);
+    }
+
+    timer.lap(FrameStage::CONVERT, image_msg.data.size());
+    FRAME_TRACEPOINT(convert_end, frame.sequence, image_msg.data.size(), frame.request);
+
+    if (temporal_denoise_ && temporal_denoise_format_ && !software_test_pattern_) {
+      // filtered in place, the history keeps the previous output
+      temporal_denoise_->process(image_msg.data.data(), image_msg.step, image_msg.data.data(), image_msg.step, cfg.size.width * bytes_per_pixel,
+                                 cfg.size.height);
+
+      timer.lap(FrameStage::DENOISE, image_msg.data.size());
+      FRAME_TRACEPOINT(denoise_end, frame.sequence, image_msg.data.size(), frame.request);
+    }
+
+  } else {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: unsupported pixel format: " << cfg.format.toString());
+    frames_failed_++;
+    return;
+  }
+
+  // the assignment reuses the buffers of the pooled message
+  const sensor_msgs::CameraInfoPtr cinfo_ptr = camera_info_pool_.acquire();
+  {
+    std::scoped_lock lock(camera_info_mutex_);
+    *cinfo_ptr = camera_info_;
+  }
+  cinfo_ptr->header = hdr;
+
+  timer.lap(FrameStage::CAMERA_INFO, 0);
+  FRAME_TRACEPOINT(camera_info_end, frame.sequence, 0, frame.request);
+
+  {
+    std::scoped_lock lock(image_pub_mutex_);
+
+    // outputs without subscribers are skipped
+    for (const image_output_t &output : image_outputs_) {
+      publish_counted(*output.publisher, image_ptr, *output.counters, output.raw ? ros::serialization::serializationLength(image_msg) : 0);
+    }
+    publish_counted(camera_info_pub_, cinfo_ptr, *camera_info_counters_, ros::serialization::serializationLength(*cinfo_ptr));
+  }
+
+  // the preview shows the published image, after the colour correction and the denoise
+  if (preview_server_ && preview_server_->clients()) {
+    publishPreview(image_msg);
+  }
+
+  // the tensor is computed from the camera buffer, not from the converted image
+  if (tensor_converter_ && tensor_pub_.getNumSubscribers()) {
+    publishTensor(frame, hdr);
+  }
+
+  publishRois(frame, hdr);
+
+  timer.lap(FrameStage::PUBLISH, image_msg.data.size());
+  FRAME_TRACEPOINT(publish_end, frame.sequence, image_msg.data.size(), frame.request);
+  timer.finish(image_msg.data.size());
+
+  if (histograms_ && sensor_clock_monotonic_) {
+    histograms_->record(LatencyStage::END_TO_END, std::max<int64_t>(since_exposure(), 0));
+  }
+
+  processing_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processing_start).count();
+}
+
+//}
+
+/* LibcameraRosDriver::publishTensor() //{ */
+
+void LibcameraRosDriver::publishTensor(const FrameView &frame, const std_msgs::Header &header) {
+
+  const std::string encoding = get_ros_encoding(stream_info_.format);
+  if (!TensorConverter::supports(encoding)) {
+    ROS_WARN_THROTTLE(10.0, "[LibcameraRosDriver]: no tensor can be computed from \"%s\" images", encoding.c_str());
+    return;
+  }
+
+  const uint64_t cpu_start = thread_cpu_time();
+
+  const boost::shared_ptr<libcamera_ros_driver::Tensor> tensor_ptr = tensor_pool_.acquire();
+  libcamera_ros_driver::Tensor &                        tensor     = *tensor_ptr;
+
+  // the size only depends on the configuration and the channels of the image, the pooled buffers are not reallocated
+  const TensorConfig &config = tensor_converter_->config();
+  tensor.data.resize(std::size_t(config.width) * config.height * 3 * (config.type == TensorType::FLOAT32 ? sizeof(float) : 1));
+  tensor_converter_->convert(frame.data, stream_info_.stride, stream_info_.size.width, stream_info_.size.height, encoding, tensor.data.data());
+  tensor.data.resize(tensor_converter_->bytes());
+
+  const Letterbox &letterbox = tensor_converter_->letterbox();
+  tensor.header              = header;
+  tensor.layout              = to_string(config.layout);
+  tensor.dtype               = to_string(config.type);
+  tensor.shape               = tensor_converter_->shape();
+  tensor.channel_order       = tensor_converter_->channels() == 1 ? "mono" : (config.rgb ? "rgb" : "bgr");
+  tensor.quant_scale         = config.quant_scale;
+  tensor.zero_point          = config.quant_zero_point;
+  tensor.scale               = letterbox.scale;
+  tensor.offset_x            = letterbox.offset_x;
+  tensor.offset_y            = letterbox.offset_y;
+
+  tensor_counters_->cpu_ns.fetch_add(thread_cpu_time() - cpu_start, std::memory_order_relaxed);
+  publish_counted(tensor_pub_, tensor_ptr, *tensor_counters_, ros::serialization::serializationLength(tensor));
+}
+
+//}
+
+/* LibcameraRosDriver::publishPreview() //{ */
+
+void LibcameraRosDriver::publishPreview(const sensor_msgs::Image &image) {
+
+  // the frames in between are skipped, the preview is for looking at the camera, not for processing
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - preview_last_ < preview_interval_) {
+    return;
+  }
+  preview_last_ = now;
+
+  if (!PreviewEncoder::supports(image.encoding)) {
+    ROS_WARN_THROTTLE(10.0, "[LibcameraRosDriver]: no preview can be encoded from \"%s\" images", image.encoding.c_str());
+    return;
+  }
+
+  const uint64_t cpu_start = thread_cpu_time();
+
+  std::shared_ptr<const std::vector<uint8_t>> jpeg;
+  try {
+    jpeg = preview_encoder_->encode(image.data.data(), image.step, image.width, image.height, image.encoding);
+  }
+  catch (const std::runtime_error &e) {
+    ROS_WARN_THROTTLE(10.0, "[LibcameraRosDriver]: %s", e.what());
+    return;
+  }
+
+  const std::size_t bytes = jpeg->size();
+  preview_server_->publish(std::move(jpeg));
+
+  preview_counters_->cpu_ns.fetch_add(thread_cpu_time() - cpu_start, std::memory_order_relaxed);
+  preview_counters_->frames.fetch_add(1, std::memory_order_relaxed);
+  preview_counters_->bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+//}
+
+/* LibcameraRosDriver::publishRois() //{ */
+
+void LibcameraRosDriver::publishRois(const FrameView &frame, const std_msgs::Header &header) {
+
+  std::scoped_lock lock(roi_mutex_);
+
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const StreamInfo &                          cfg = stream_info_;
+
+  for (roi_output_t &output : roi_outputs_) {
+
+    if (!output.publisher.getNumSubscribers() || now - output.last < output.interval) {
+      continue;
+    }
+
+    // the pixel format changes with pixel_format "auto", the region is aligned to the new one
+    if (output.format != cfg.format) {
+      try {
+        output.sampler.emplace(roiSampler(output.rect, output.scale));
+        output.format = cfg.format;
+      }
+      catch (const std::runtime_error &e) {
+        ROS_WARN_THROTTLE(10.0, "[LibcameraRosDriver]: region \"%s\": %s", output.name.c_str(), e.what());
+        continue;
+      }
+    }
+
+    output.last = now;
+
+    const uint64_t cpu_start = thread_cpu_time();
+
+    const sensor_msgs::ImagePtr image_ptr = output.pool.acquire();
+    sensor_msgs::Image &        image     = *image_ptr;
+
+    image.header       = header;
+    image.width        = output.sampler->width();
+    image.height       = output.sampler->height();
+    image.encoding     = get_ros_encoding(cfg.format);
+    image.is_bigendian = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+    image.step         = output.sampler->step();
+    image.data.resize(image.step * image.height);
+
+    // only the sampled pixels are read from the mapped buffer
+    output.sampler->sample(frame.data, cfg.stride, image.data.data());
+
+    output.counters->cpu_ns.fetch_add(thread_cpu_time() - cpu_start, std::memory_order_relaxed);
+    publish_counted(output.publisher, image_ptr, *output.counters, ros::serialization::serializationLength(image));
+  }
+}
+
+//}
+
+/* LibcameraRosDriver::roiSampler() //{ */
+
+RoiSampler LibcameraRosDriver::roiSampler(const RoiRect &rect, const double scale) const {
+
+  const StreamInfo &cfg = stream_info_;
+
+  // Bayer images are cropped in 2x2 blocks and YUV 4:2:2 images in pixel pairs, which share their chroma
+  const bool         bayer        = get_bayer_order(cfg.format).has_value();
+  const unsigned int block_width  = bayer || get_ros_encoding(cfg.format) == sensor_msgs::image_encodings::YUV422 ? 2 : 1;
+  const unsigned int block_height = bayer ? 2 : 1;
+
+  return RoiSampler(rect, scale, cfg.size.width, cfg.size.height, get_bytes_per_pixel(cfg.format), block_width, block_height);
+}
+
+//}
+
+/* LibcameraRosDriver::removeRoi() //{ */
+
+std::list<LibcameraRosDriver::roi_output_t>::iterator LibcameraRosDriver::removeRoi(std::list<roi_output_t>::iterator it) {
+
+  output_accounting_.remove(*it->counters);
+  it->publisher.shutdown();
+
+  return roi_outputs_.erase(it);
+}
+
+//}
+
+/* LibcameraRosDriver::timerRois() //{ */
+
+void LibcameraRosDriver::timerRois([[maybe_unused]] const ros::TimerEvent &event) {
+
+  std::scoped_lock lock(roi_mutex_);
+
+  const ros::WallTime now = ros::WallTime::now();
+
+  for (auto it = roi_outputs_.begin(); it != roi_outputs_.end();) {
+
+    if (it->publisher.getNumSubscribers()) {
+      it->subscribed = true;
+      it++;
+      continue;
+    }
+
+    // the client disconnected or never subscribed
+    if (it->subscribed || (now - it->registered).toSec() > roi_subscribe_timeout_) {
+      ROS_INFO_STREAM("[LibcameraRosDriver]: removing region \"" << it->name << "\", "
+                                                                 << (it->subscribed ? "its subscribers disconnected" : "nobody subscribed to it"));
+      it = removeRoi(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+//}
+
+/* LibcameraRosDriver::timerCameraInfo() //{ */
+
+void LibcameraRosDriver::timerCameraInfo([[maybe_unused]] const ros::TimerEvent &event) {
+
+  const sensor_msgs::CameraInfo camera_info = cinfo_->getCameraInfo();
+
+  std::scoped_lock lock(camera_info_mutex_);
+  camera_info_ = camera_info;
+}
+
+//}
+
+/* LibcameraRosDriver::timerDiagnostics() //{ */
+
+void LibcameraRosDriver::timerDiagnostics([[maybe_unused]] const ros::TimerEvent &event) {
+
+  // publishes only once per diagnostic period
+  diagnostics_->update();
+}
+
+//}
+
+/* LibcameraRosDriver::timerAutoFormat() //{ */
+
+void LibcameraRosDriver::timerAutoFormat([[maybe_unused]] const ros::TimerEvent &event) {
+
+  // without subscribers there is nothing to optimize for, the stream keeps its format
+  const FormatDemand demand = formatDemand();
+  if (demand.empty()) {
+    auto_format_candidate_.reset();
+    return;
+  }
+
+  const std::optional<libcamera::PixelFormat> best = select_format(backend_->formats(), demand);
+  if (!best || *best == stream_info_.format) {
+    auto_format_candidate_.reset();
+    return;
+  }
+
+  // small savings do not justify interrupting the stream
+  const double current = format_cost(stream_info_.format, demand);
+  const double cost    = format_cost(*best, demand);
+  if (cost > current * (1.0 - auto_format_hysteresis_)) {
+    auto_format_candidate_.reset();
+    return;
+  }
+
+  // the demand has to be stable for the hold time, subscribers that come and go do not cause reconfigurations
+  const ros::WallTime now = ros::WallTime::now();
+  if (!auto_format_candidate_ || *auto_format_candidate_ != *best) {
+    auto_format_candidate_       = *best;
+    auto_format_candidate_since_ = now;
+    ROS_INFO_STREAM("[LibcameraRosDriver]: \"" << *best << "\" is cheaper for the current subscribers than \"" << stream_info_.format << "\" (cost "
+                                                << cost << " instead of " << current << " per pixel), switching if it stays so for " << auto_format_hold_
+                                                << " s");
+    return;
+  }
+
+  if ((now - auto_format_candidate_since_).toSec() < auto_format_hold_) {
+    return;
+  }
+
+  try {
+    if (!reconfigureFormat(*best)) {
+      ROS_INFO_THROTTLE(60.0, "[LibcameraRosDriver]: the pixel format is not changed while recording");
+      return;
+    }
+  }
+  catch (const std::runtime_error &e) {
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to restart the camera: " << e.what());
+    ros::shutdown();
+    return;
+  }
+
+  auto_format_candidate_.reset();
+}
+
+//}
+
+/* LibcameraRosDriver::timerOutputStats() //{ */
+
+void LibcameraRosDriver::timerOutputStats([[maybe_unused]] const ros::TimerEvent &event) {
+
+  const ros::WallTime now = ros::WallTime::now();
+
+  libcamera_ros_driver::OutputStatsArray msg;
+  msg.header.stamp    = ros::Time::now();
+  msg.header.frame_id = frame_id_;
+  msg.window          = (now - output_stats_start_).toSec();
+  output_stats_start_ = now;
+
+  for (const OutputUsage &usage : output_accounting_.collect()) {
+    libcamera_ros_driver::OutputStats &output = msg.outputs.emplace_back();
+    output.topic                              = usage.topic;
+    output.transport                          = usage.transport;
+    output.subscribers                        = usage.subscribers;
+    output.frames                             = usage.frames;
+    output.bytes                              = usage.bytes;
+    output.bytes_sent                         = usage.bytes_sent;
+    output.cpu_time                           = usage.cpu_time;
+  }
+
+  {
+    std::scoped_lock lock(output_stats_mutex_);
+    output_stats_ = msg;
+  }
+
+  output_stats_pub_.publish(msg);
+}
+
+//}
+
+/* LibcameraRosDriver::diagnosticsFrames() //{ */
+
+void LibcameraRosDriver::diagnosticsFrames(diagnostic_updater::DiagnosticStatusWrapper &status) {
+
+  diagnostics_snapshot_t now;
+  now.stamp         = ros::WallTime::now();
+  now.frames        = frames_;
+  now.missing       = frames_missing_;
+  now.failed        = frames_failed_;
+  now.cancelled     = requests_cancelled_;
+  now.processing_ns = processing_ns_;
+
+  // the checks cover the time since the previous report
+  const diagnostics_snapshot_t &last       = diagnostics_last_;
+  const double                  elapsed    = (now.stamp - last.stamp).toSec();
+  const uint64_t                frames     = now.frames - last.frames;
+  const uint64_t                missing    = now.missing - last.missing;
+  const uint64_t                failed     = now.failed - last.failed;
+  const uint64_t                cancelled  = now.cancelled - last.cancelled;
+  const double                  fps        = elapsed > 0.0 ? frames / elapsed : 0.0;
+  const double                  loss       = frames + missing ? double(missing) / (frames + missing) : 0.0;
+  const double                  processing = frames ? 1e-9 * (now.processing_ns - last.processing_ns) / frames : 0.0;
+  const int                     queued     = backend_->queuedRequests();
+
+  diagnostics_last_ = now;
+
+  status.summary(diagnostic_msgs::DiagnosticStatus::OK, "frames are published");
+
+  if (!frames) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "no frames");
+  }
+
+  if (target_fps_ > 0.0 && frames) {
+    const double ratio = fps / target_fps_;
+    if (ratio < diagnostics_fps_error_) {
+      status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "frame rate far below the target");
+    } else if (ratio < diagnostics_fps_warn_) {
+      status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "frame rate below the target");
+    }
+  }
+
+  if (loss > diagnostics_loss_error_) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "many frames lost");
+  } else if (loss > diagnostics_loss_warn_) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "frames lost");
+  }
+
+  if (cancelled || failed) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "requests cancelled or frames failed");
+  }
+
+  if (queued == 0 && frames) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "no request queued to the camera");
+  }
+
+  // share of the frame interval left after processing a frame
+  const double interval = target_fps_ > 0.0 ? 1.0 / target_fps_ : (fps > 0.0 ? 1.0 / fps : 0.0);
+  const double headroom = interval > 0.0 && frames ? 1.0 - processing / interval : 1.0;
+  if (headroom < diagnostics_headroom_error_) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "processing slower than the frame rate");
+  } else if (headroom < diagnostics_headroom_warn_) {
+    status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "little processing headroom");
+  }
+
+  status.add("frame rate [Hz]", fps);
+  status.add("target frame rate [Hz]", target_fps_);
+  status.add("frames", frames);
+  status.add("lost frames (sequence gaps)", missing);
+  status.add("frame loss [%]", 100.0 * loss);
+  status.add("cancelled requests", cancelled);
+  status.add("failed frames", failed);
+  status.add("queued requests", queued);
+  status.add("processing time [ms]", 1e3 * processing);
+  status.add("processing headroom [%]", 100.0 * headroom);
+  status.add("total frames", now.frames);
+  status.add("total lost frames", now.missing);
+  status.add("total cancelled requests", now.cancelled);
+}
+
+//}
+
+/* LibcameraRosDriver::timerProfiling() //{ */
+
+void LibcameraRosDriver::timerProfiling([[maybe_unused]] const ros::TimerEvent &event) {
+
+  const std::array<StageStats, frame_stage_count> stats = profiler_->collect();
+
+  const ros::WallTime now    = ros::WallTime::now();
+  const double        period = (now - profiling_start_).toSec();
+  profiling_start_           = now;
+
+  const StageStats &total = stats[std::size_t(FrameStage::TOTAL)];
+  if (!total.frames) {
+    ROS_WARN("[LibcameraRosDriver]: profiling: no frames were published");
+    return;
+  }
+
+  // the first periods include the warm-up of the caches, the allocator and the subscribers
+  const bool warmup = ++profiling_reports_ <= profiling_warmup_;
+
+  const double scale = profiling_best_.calibration / (profiling_baseline_.calibration > 0.0 ? profiling_baseline_.calibration : profiling_best_.calibration);
+
+  libcamera_ros_driver::ProfilingReport report;
+  report.header.stamp       = ros::Time::now();
+  report.header.frame_id    = frame_id_;
+  report.period             = period;
+  report.warmup             = warmup;
+  report.counts_allocations = profiler_->countsAllocations();
+  report.has_baseline =
+      std::any_of(profiling_baseline_.ms_per_frame.begin(), profiling_baseline_.ms_per_frame.end(), [](const double ms) { return ms > 0.0; });
+  report.tolerance          = profiling_tolerance_;
+  report.machine_speed      = 1.0 / scale;
+
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(3);
+
+  for (std::size_t i = 0; i < frame_stage_count; i++) {
+    if (!stats[i].frames) {
+      continue;
+    }
+
+    const FrameStage                    stage   = FrameStage(i);
+    libcamera_ros_driver::StageProfile &profile = report.stages.emplace_back();
+    profile.stage                               = to_string(stage);
+    profile.frames                              = stats[i].frames;
+    profile.ms_per_frame                        = stats[i].cpuMsPerFrame();
+    profile.wall_ms_per_frame                   = stats[i].msPerFrame();
+    profile.max_ms                              = 1e-6 * stats[i].max;
+    profile.bytes_per_second                    = stats[i].bytesPerSecond();
+    profile.allocations_per_frame               = stats[i].allocationsPerFrame();
+
+    const double baseline = profiling_baseline_.ms_per_frame[i];
+    if (baseline > 0.0) {
+      profile.baseline_ms_per_frame  = baseline * scale;
+      profile.threshold_ms_per_frame = baseline * scale * (1.0 + profiling_tolerance_);
+    }
+
+    ss << "\n  " << std::setw(12) << std::left << profile.stage << std::right << std::setw(9) << profile.ms_per_frame << " ms/frame CPU"
+       << std::setw(9) << profile.wall_ms_per_frame << " ms/frame" << std::setw(10) << profile.bytes_per_second / 1e6 << " MB/s, max " << profile.max_ms
+       << " ms";
+    if (report.counts_allocations) {
+      ss << ", " << profile.allocations_per_frame << " allocations/frame";
+    }
+
+    if (warmup) {
+      continue;
+    }
+
+    // the best period is the least disturbed by the rest of the system
+    if (profiling_best_.ms_per_frame[i] <= 0.0 || profile.ms_per_frame < profiling_best_.ms_per_frame[i]) {
+      profiling_best_.ms_per_frame[i] = profile.ms_per_frame;
+    }
+
+    // publishing allocates inside of roscpp and the transport plugins, the stages of the driver must not
+    profile.allocates = stats[i].allocations && stage != FrameStage::PUBLISH && stage != FrameStage::TOTAL;
+    profile.regressed = baseline > 0.0 && profile.ms_per_frame > profile.threshold_ms_per_frame;
+  }
+
+  ROS_INFO_STREAM("[LibcameraRosDriver]: profiling of " << total.frames << " frames of " << stream_info_.size.width << "x" << stream_info_.size.height
+                                                        << "-" << stream_info_.format << (warmup ? " (warm-up)" : "") << ":" << ss.str());
+
+  for (const libcamera_ros_driver::StageProfile &profile : report.stages) {
+    if (profile.allocates) {
+      ROS_WARN("[LibcameraRosDriver]: profiling: the %s stage allocates %.2f times per frame after the warm-up", profile.stage.c_str(),
+               profile.allocations_per_frame);
+    }
+    if (profile.regressed) {
+      ROS_WARN("[LibcameraRosDriver]: profiling: the %s stage regressed, %.3f ms/frame of CPU time exceeds the baseline of %.3f ms/frame on this machine "
+               "by more than %.0f %%",
+               profile.stage.c_str(), profile.ms_per_frame, profile.baseline_ms_per_frame, profiling_tolerance_ * 100.0);
+    }
+  }
+
+  profiling_pub_.publish(report);
+
+  if (warmup) {
+    return;
+  }
+
+  if (!profiling_baseline_output_.empty()) {
+    std::ostringstream comment;
+    comment << "baseline of " << stream_info_.size.width << "x" << stream_info_.size.height << "-" << stream_info_.format
+            << (remove_stride_ ? ", stride removed" : "");
+    try {
+      save_baseline(profiling_baseline_output_, profiling_best_, comment.str());
+    }
+    catch (const std::runtime_error &e) {
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: profiling: " << e.what());
+    }
+  }
+}
+
+//}
+
+/* LibcameraRosDriver::callbackGetLatencyStats() //{ */
+
+bool LibcameraRosDriver::callbackGetLatencyStats(libcamera_ros_driver::GetLatencyStats::Request &req, libcamera_ros_driver::GetLatencyStats::Response &res) {
+
+  // serializes the readers, the frame path keeps recording without a lock
+  std::scoped_lock lock(histograms_mutex_);
+
+  const ros::WallTime now = ros::WallTime::now();
+  res.window              = (now - histograms_window_start_).toSec();
+
+  for (std::size_t i = 0; i < latency_stage_count; i++) {
+    const LatencySummary summary = (*histograms_)[LatencyStage(i)].summary();
+    if (!summary.count) {
+      continue;
+    }
+
+    res.stages.push_back(to_string(LatencyStage(i)));
+    res.count.push_back(summary.count);
+    res.p50.push_back(1e-6 * summary.p50);
+    res.p99.push_back(1e-6 * summary.p99);
+    res.p999.push_back(1e-6 * summary.p999);
+    res.max.push_back(1e-6 * summary.max);
+  }
+
+  if (req.reset) {
+    histograms_->reset();
+    histograms_window_start_ = now;
+  }
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackGetOutputStats() //{ */
+
+bool LibcameraRosDriver::callbackGetOutputStats(libcamera_ros_driver::GetOutputStats::Request &req, libcamera_ros_driver::GetOutputStats::Response &res) {
+
+  std::scoped_lock lock(output_stats_mutex_);
+
+  res.window = output_stats_.window;
+
+  for (const libcamera_ros_driver::OutputStats &output : output_stats_.outputs) {
+    if (req.filter.empty() || output.topic.find(req.filter) != std::string::npos || output.transport.find(req.filter) != std::string::npos) {
+      res.outputs.push_back(output);
+    }
+  }
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackRegisterRoi() //{ */
+
+bool LibcameraRosDriver::callbackRegisterRoi(libcamera_ros_driver::RegisterRoi::Request &req, libcamera_ros_driver::RegisterRoi::Response &res) {
+
+  // the name becomes a single segment of the topic
+  const bool valid_name = !req.name.empty() && std::isalpha(static_cast<unsigned char>(req.name[0])) &&
+                          std::all_of(req.name.begin(), req.name.end(), [](const unsigned char c) { return std::isalnum(c) || c == '_'; });
+  if (!valid_name) {
+    res.success = false;
+    res.message = "invalid region name \"" + req.name + "\", it has to start with a letter followed by letters, digits and underscores";
+    return true;
+  }
+
+  const RoiRect rect  = {req.roi.x_offset, req.roi.y_offset, req.roi.width, req.roi.height};
+  const double  scale = req.scale == 0.0 ? 1.0 : req.scale;
+
+  std::scoped_lock lock(roi_mutex_);
+
+  if (std::any_of(roi_outputs_.begin(), roi_outputs_.end(), [&req](const roi_output_t &output) { return output.name == req.name; })) {
+    res.success = false;
+    res.message = "region \"" + req.name + "\" is already registered";
+    return true;
+  }
+
+  if (int(roi_outputs_.size()) >= roi_max_outputs_) {
+    res.success = false;
+    res.message = "the maximum of " + std::to_string(roi_max_outputs_) + " regions is registered";
+    return true;
+  }
+
+  std::optional<RoiSampler> sampler;
+  try {
+    sampler.emplace(roiSampler(rect, scale));
+  }
+  catch (const std::runtime_error &e) {
+    res.success = false;
+    res.message = std::string("invalid region: ") + e.what();
+    return true;
+  }
+
+  roi_output_t &output = roi_outputs_.emplace_back();
+  output.name          = req.name;
+  output.rect          = rect;
+  output.scale         = scale;
+  output.sampler       = std::move(sampler);
+  output.format        = stream_info_.format;
+  output.publisher     = nh_.advertise<sensor_msgs::Image>("roi/" + req.name, 2);
+  output.registered    = ros::WallTime::now();
+
+  if (req.max_rate > 0.0) {
+    output.interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / req.max_rate));
+  }
+
+  const ros::Publisher publisher = output.publisher;
+  output.counters                = &output_accounting_.add(publisher.getTopic(), "", [publisher] { return publisher.getNumSubscribers(); });
+
+  const RoiRect &aligned = output.sampler->rect();
+  res.success            = true;
+  res.topic              = publisher.getTopic();
+  res.roi.x_offset       = aligned.x;
+  res.roi.y_offset       = aligned.y;
+  res.roi.width          = aligned.width;
+  res.roi.height         = aligned.height;
+  res.width              = output.sampler->width();
+  res.height             = output.sampler->height();
+
+  std::ostringstream message;
+  message << "publishing " << res.width << "x" << res.height << " images of the region " << aligned.width << "x" << aligned.height << "+" << aligned.x
+          << "+" << aligned.y << " on " << res.topic;
+  res.message = message.str();
+  ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackUnregisterRoi() //{ */
+
+bool LibcameraRosDriver::callbackUnregisterRoi(libcamera_ros_driver::UnregisterRoi::Request &req, libcamera_ros_driver::UnregisterRoi::Response &res) {
+
+  std::scoped_lock lock(roi_mutex_);
+
+  const auto it = std::find_if(roi_outputs_.begin(), roi_outputs_.end(), [&req](const roi_output_t &output) { return output.name == req.name; });
+  if (it == roi_outputs_.end()) {
+    res.success = false;
+    res.message = "region \"" + req.name + "\" is not registered";
+    return true;
+  }
+
+  removeRoi(it);
+
+  res.success = true;
+  res.message = "removed region \"" + req.name + "\"";
+  ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackControlCommand() //{ */
+
+void LibcameraRosDriver::callbackControlCommand(const libcamera_ros_driver::ControlCommand::ConstPtr &msg) {
+
+  // the command is translated into fixed slots, nothing is looked up by name and nothing is allocated
+  ControlCommandValues values;
+
+  const auto set = [&values](const ControlSlot slot, const double first, const double second) {
+    values.set[std::size_t(slot)]    = true;
+    values.values[std::size_t(slot)] = {first, second};
+  };
+
+  if (msg->exposure_time > 0) {
+    set(ControlSlot::EXPOSURE_TIME, msg->exposure_time, 0.0);
+  }
+  if (msg->analogue_gain > 0.0f) {
+    set(ControlSlot::ANALOGUE_GAIN, msg->analogue_gain, 0.0);
+  }
+  if (msg->frame_duration > 0) {
+    set(ControlSlot::FRAME_DURATION_LIMITS, msg->frame_duration, msg->frame_duration);
+  }
+  if (msg->colour_gains[0] > 0.0f && msg->colour_gains[1] > 0.0f) {
+    set(ControlSlot::COLOUR_GAINS, msg->colour_gains[0], msg->colour_gains[1]);
+  } else if (msg->colour_gains[0] > 0.0f || msg->colour_gains[1] > 0.0f) {
+    ROS_WARN_THROTTLE(5.0, "[LibcameraRosDriver]: control command: colour_gains needs both gains, ignoring them");
+  }
+
+  const unsigned int clamped = control_descriptors_->validate(values);
+  if (clamped) {
+    ROS_WARN_THROTTLE(5.0, "[LibcameraRosDriver]: control command: %u values clamped to the limits of the camera", clamped);
+  }
+
+  if (values.empty()) {
+    return;
+  }
+
+  backend_->queueControls(values);
+}
+
+//}
+
+/* LibcameraRosDriver::callbackSetColorLut() //{ */
+
+bool LibcameraRosDriver::callbackSetColorLut(libcamera_ros_driver::SetColorLut::Request &req, libcamera_ros_driver::SetColorLut::Response &res) {
+
+  if (req.path.empty()) {
+    {
+      std::scoped_lock lock(color_lut_mutex_);
+      color_lut_.reset();
+    }
+
+    res.success = true;
+    res.message = "colour LUT disabled";
+    ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  // the stream is reconfigured by the automatic format selection with the region lock held
+  {
+    std::scoped_lock lock(roi_mutex_);
+
+    if (!color_lut_channels_) {
+      res.success = false;
+      res.message = "colour LUT can not be applied to \"" + get_ros_encoding(stream_info_.format) + "\" images";
+      ROS_WARN_STREAM("[LibcameraRosDriver]: " << res.message);
+      return true;
+    }
+  }
+
+  std::shared_ptr<const ColorLut3D> color_lut;
+
+  // parse the file outside of the lock, the frame path keeps using the previous LUT meanwhile
+  try {
+    color_lut = std::make_shared<const ColorLut3D>(load_cube_lut(req.path));
+  }
+  catch (const std::runtime_error &e) {
+    res.success = false;
+    res.message = std::string("failed to load colour LUT: ") + e.what();
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  {
+    std::scoped_lock lock(color_lut_mutex_);
+    color_lut_ = color_lut;
+  }
+
+  res.success = true;
+  res.message = "loaded " + std::to_string(color_lut->size) + "^3 colour LUT \"" + color_lut->title + "\"";
+  ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackRecorder() //{ */
+
+bool LibcameraRosDriver::callbackRecorder(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res) {
+
+  std::scoped_lock lock(recorder_mutex_);
+
+  if (!req.data) {
+
+    if (!recorder_ || !recorder_->recording()) {
+      res.success = false;
+      res.message = "recorder is not running";
+      return true;
+    }
+
+    recorder_->stop();
+
+    res.success = true;
+    res.message = "recorded " + std::to_string(recorder_->written()) + " frames, dropped " + std::to_string(recorder_->dropped()) + ", failed " +
+                  std::to_string(recorder_->failed());
+    ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  if (recorder_ && recorder_->recording()) {
+    res.success = false;
+    res.message = "recorder is already running";
+    return true;
+  }
+
+  if (reconfiguring_) {
+    res.success = false;
+    res.message = "the stream is being reconfigured";
+    ROS_WARN_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  if (!recorder_) {
+    // every record holds a complete buffer
+    recorder_ = std::make_unique<FrameRecorder>(stream_info_.frame_bytes, std::max(recorder_slots_, 2));
+  }
+
+  char        stamp[32];
+  std::time_t now = std::time(nullptr);
+  std::tm     tm;
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime_r(&now, &tm));
+
+  const std::string path = recorder_directory_ + "/" + camera_name_ + "_" + stamp + ".lcrcap";
+
+  // describe the stream in the file header
+  const StreamInfo &cfg = stream_info_;
+
+  CaptureFileHeader header = {};
+  header.width             = cfg.size.width;
+  header.height            = cfg.size.height;
+  header.stride            = cfg.stride;
+  header.fourcc            = cfg.format.fourcc();
+  header.modifier          = cfg.format.modifier();
+  std::strncpy(header.encoding, get_ros_encoding(cfg.format).c_str(), sizeof(header.encoding) - 1);
+  std::strncpy(header.frame_id, frame_id_.c_str(), sizeof(header.frame_id) - 1);
+
+  sensor_msgs::CameraInfo cinfo_msg = cinfo_->getCameraInfo();
+  cinfo_msg.header.frame_id         = frame_id_;
+
+  std::vector<uint8_t>        camera_info(ros::serialization::serializationLength(cinfo_msg));
+  ros::serialization::OStream stream(camera_info.data(), camera_info.size());
+  ros::serialization::serialize(stream, cinfo_msg);
+
+  if (camera_info.size() > capture_alignment - sizeof(CaptureFileHeader)) {
+    ROS_WARN("[LibcameraRosDriver]: camera info is too large to be stored in the capture file");
+  }
+
+  try {
+    recorder_->start(path, header, camera_info);
+  }
+  catch (const std::runtime_error &e) {
+    res.success = false;
+    res.message = e.what();
+    ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to start recording: " << res.message);
+    return true;
+  }
+
+  res.success = true;
+  res.message = "recording to " + path;
+  ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+
+  return true;
+}
+
+//}
+
+/* LibcameraRosDriver::callbackCaptureDng() //{ */
+
+bool LibcameraRosDriver::callbackCaptureDng(libcamera_ros_driver::CaptureDng::Request &req, libcamera_ros_driver::CaptureDng::Response &res) {
+
+  std::scoped_lock lock(dng_mutex_);
+
+  if (reconfiguring_) {
+    res.success = false;
+    res.message = "the stream is being reconfigured";
+    ROS_WARN_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  const StreamInfo &             cfg    = stream_info_;
+  const std::optional<RawLayout> layout = get_raw_layout(cfg.format);
+
+  if (!layout) {
+    res.success = false;
+    res.message = "DNG files can only be written from raw Bayer streams, the stream has the format \"" + cfg.format.toString() + "\"";
+    ROS_WARN_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  if (!dng_paths_.empty()) {
+    res.success = false;
+    res.message = std::to_string(dng_paths_.size()) + " frames of the previous capture are still pending";
+    ROS_WARN_STREAM("[LibcameraRosDriver]: " << res.message);
+    return true;
+  }
+
+  if (!dng_writer_) {
+    DngStream stream;
+    stream.size         = cfg.size;
+    stream.stride       = cfg.stride;
+    stream.layout       = *layout;
+    stream.camera_model = backend_->id();
+
+    try {
+      // every slot holds a complete buffer
+      dng_writer_ = std::make_unique<DngWriter>(stream, cfg.frame_bytes, std::max(dng_slots_, 1));
+    }
+    catch (const std::runtime_error &e) {
+      res.success = false;
+      res.message = e.what();
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: failed to create the DNG writer: " << res.message);
+      return true;
+    }
+  }
+
+  char        stamp[32];
+  std::time_t now = std::time(nullptr);
+  std::tm     tm;
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime_r(&now, &tm));
+
+  // the next frames are written to these files in order
+  const uint32_t frames = std::max(req.frames, 1u);
+  for (uint32_t i = 0; i < frames; i++) {
+    std::ostringstream path;
+    path << dng_directory_ << "/" << camera_name_ << "_" << stamp << "_" << std::setw(4) << std::setfill('0') << i << ".dng";
+    dng_paths_.push_back(path.str());
+  }
+
+  res.paths.assign(dng_paths_.begin(), dng_paths_.end());
+  dng_skipped_ = 0;
+  dng_pending_ = true;
+
+  res.success = true;
+  res.message = "writing " + std::to_string(frames) + " frames to " + dng_directory_ + ", so far written " + std::to_string(dng_writer_->written()) + ", dropped " +
+                std::to_string(dng_writer_->dropped()) + ", failed " + std::to_string(dng_writer_->failed());
+  ROS_INFO_STREAM("[LibcameraRosDriver]: " << res.message);
+
+  return true;
 }
 
 //}
@@ -0,0 +1,197 @@
+/* includes //{ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+
+#include <sensor_msgs/Image.h>
+
+#include <libcamera_ros_driver/utils/test_pattern.h>
+
+//}
+
+namespace libcamera_ros_driver
+{
+
+/* class TestPatternChecker //{ */
+
+// verifies the content and the order of the test pattern images of the driver: the software pattern is
+// checked byte by byte against its watermark, a sensor pattern is compared with the first settled frame
+class TestPatternChecker : public nodelet::Nodelet {
+public:
+  virtual void onInit();
+
+private:
+  ros::NodeHandle nh_;
+
+  image_transport::Subscriber subscriber_image_;
+  std::string                 mode_;
+  int                         settle_ = 5;
+
+  struct counters_t
+  {
+    uint64_t received   = 0;
+    uint64_t corrupted  = 0;  // content differs from the expected one
+    uint64_t duplicated = 0;
+    uint64_t reordered  = 0;
+    uint64_t missing    = 0;
+  };
+
+  std::mutex              mutex_;
+  counters_t              period_;
+  counters_t              total_;
+  std::optional<uint64_t> last_sequence_;
+  std::optional<uint64_t> reference_hash_;
+  int                     settled_ = 0;
+
+  ros::Timer timer_report_;
+
+  void callbackImage(const sensor_msgs::ImageConstPtr &msg);
+  void timerReport(const ros::TimerEvent &event);
+};
+
+//}
+
+/* TestPatternChecker::onInit() //{ */
+
+void TestPatternChecker::onInit() {
+
+  nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
+
+  ros::Time::waitForValid();
+
+  std::string transport;
+  double      period;
+  nh_.param("mode", mode_, std::string("software"));
+  nh_.param("transport", transport, std::string("raw"));
+  nh_.param("settle", settle_, 5);
+  nh_.param("period", period, 5.0);
+
+  if (mode_ != "software" && mode_ != "constant") {
+    ROS_ERROR_STREAM("[TestPatternChecker]: invalid mode: \"" << mode_ << "\"");
+    ros::shutdown();
+    return;
+  }
+
+  ROS_INFO_STREAM("[TestPatternChecker]: checking the " << mode_ << " test pattern over the " << transport << " transport");
+
+  image_transport::ImageTransport it(nh_);
+  subscriber_image_ = it.subscribe("image", 5, &TestPatternChecker::callbackImage, this, image_transport::TransportHints(transport));
+
+  timer_report_ = nh_.createTimer(ros::Duration(std::max(period, 0.1)), &TestPatternChecker::timerReport, this);
+
+  ROS_INFO("[TestPatternChecker]: initialized");
+}
+
+//}
+
+/* TestPatternChecker::callbackImage() //{ */
+
+void TestPatternChecker::callbackImage(const sensor_msgs::ImageConstPtr &msg) {
+
+  const std::size_t rows = msg->step ? std::min<std::size_t>(msg->height, msg->data.size() / msg->step) : 0;
+
+  // the content is verified outside of the lock, the callbacks of a multi-threaded manager may overlap; the sequence
+  // number of the header is replaced by the counter of the publisher once the image is serialized, the one of the
+  // sensor is only known from the watermark
+  uint64_t sequence  = msg->header.seq;
+  bool     corrupted = false;
+  uint64_t hash      = 0;
+
+  if (mode_ == "software") {
+    const std::optional<uint64_t> watermark = read_test_pattern_watermark(msg->data.data(), msg->data.size());
+    if (!watermark) {
+      corrupted = true;
+    } else {
+      sequence  = *watermark;
+      corrupted = rows < msg->height || check_test_pattern(msg->data.data(), msg->step, rows, sequence) > 0;
+    }
+  } else {
+    hash = hash_bytes(msg->data.data(), msg->data.size());
+  }
+
+  std::scoped_lock lock(mutex_);
+
+  if (mode_ == "constant") {
+    // the first frames may still change while the sensor and the filters settle
+    if (settled_ < settle_) {
+      settled_++;
+      reference_hash_ = hash;
+    } else {
+      corrupted = hash != *reference_hash_;
+    }
+  }
+
+  period_.received++;
+  period_.corrupted += corrupted;
+
+  if (last_sequence_) {
+    if (sequence == *last_sequence_) {
+      period_.duplicated++;
+    } else if (sequence < *last_sequence_) {
+      period_.reordered++;
+    } else {
+      period_.missing += sequence - *last_sequence_ - 1;
+    }
+  }
+
+  // a reordered frame does not move the position back, the following frames would count as duplicates
+  if (!last_sequence_ || sequence > *last_sequence_) {
+    last_sequence_ = sequence;
+  }
+
+  if (corrupted) {
+    ROS_WARN_STREAM_THROTTLE(1.0, "[TestPatternChecker]: frame " << sequence << " is corrupted");
+  }
+}
+
+//}
+
+/* TestPatternChecker::timerReport() //{ */
+
+void TestPatternChecker::timerReport([[maybe_unused]] const ros::TimerEvent &event) {
+
+  counters_t period;
+  counters_t total;
+
+  {
+    std::scoped_lock lock(mutex_);
+    period  = period_;
+    period_ = {};
+
+    total_.received += period.received;
+    total_.corrupted += period.corrupted;
+    total_.duplicated += period.duplicated;
+    total_.reordered += period.reordered;
+    total_.missing += period.missing;
+    total = total_;
+  }
+
+  if (!period.received) {
+    ROS_WARN("[TestPatternChecker]: no images received");
+    return;
+  }
+
+  const bool failed = period.corrupted || period.duplicated || period.reordered;
+
+  const auto log = failed ? ros::console::levels::Warn : ros::console::levels::Info;
+  ROS_LOG(log, ROSCONSOLE_DEFAULT_NAME,
+          "[TestPatternChecker]: %" PRIu64 " images, %" PRIu64 " corrupted, %" PRIu64 " duplicated, %" PRIu64 " reordered, %" PRIu64
+          " missing (total: %" PRIu64 " images, %" PRIu64 " corrupted, %" PRIu64 " duplicated, %" PRIu64 " reordered, %" PRIu64 " missing)",
+          period.received, period.corrupted, period.duplicated, period.reordered, period.missing, total.received, total.corrupted, total.duplicated,
+          total.reordered, total.missing);
+}
+
+//}
+
+}  // namespace libcamera_ros_driver
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(libcamera_ros_driver::TestPatternChecker, nodelet::Nodelet);
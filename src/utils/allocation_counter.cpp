@@ -0,0 +1,15 @@
+#include <libcamera_ros_driver/utils/allocation_counter.h>
+
+
+// defined by the preloaded allocation counting library, null without it
+extern "C" uint64_t
+libcamera_ros_driver_thread_allocations() __attribute__((weak));
+
+std::optional<uint64_t>
+thread_allocations()
+{
+  if (!libcamera_ros_driver_thread_allocations)
+    return std::nullopt;
+
+  return libcamera_ros_driver_thread_allocations();
+}
@@ -0,0 +1,87 @@
+// counts the heap allocations of every thread, loaded with LD_PRELOAD in front of the C library, the
+// allocator of the C library still does the work; operator new is built on malloc and is counted as well
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+void *
+__libc_malloc(std::size_t size);
+void *
+__libc_calloc(std::size_t count, std::size_t size);
+void *
+__libc_realloc(void *ptr, std::size_t size);
+void *
+__libc_memalign(std::size_t alignment, std::size_t size);
+void
+__libc_free(void *ptr);
+}
+
+// initial-exec TLS is set up with the thread, a lazily allocated one would call malloc
+static __thread uint64_t allocations __attribute__((tls_model("initial-exec"))) = 0;
+
+extern "C" {
+
+uint64_t
+libcamera_ros_driver_thread_allocations()
+{
+  return allocations;
+}
+
+void *
+malloc(std::size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void *
+calloc(std::size_t count, std::size_t size)
+{
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+void *
+realloc(void *ptr, std::size_t size)
+{
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+void *
+memalign(std::size_t alignment, std::size_t size)
+{
+  allocations++;
+  return __libc_memalign(alignment, size);
+}
+
+void *
+aligned_alloc(std::size_t alignment, std::size_t size)
+{
+  allocations++;
+  return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(void **ptr, std::size_t alignment, std::size_t size)
+{
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+
+  allocations++;
+  void *p = __libc_memalign(alignment, size);
+  if (!p)
+    return ENOMEM;
+
+  *ptr = p;
+  return 0;
+}
+
+void
+free(void *ptr)
+{
+  __libc_free(ptr);
+}
+}
@@ -0,0 +1,132 @@
+#include <libcamera_ros_driver/utils/capture_reader.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ros/serialization.h>
+
+
+CaptureReader::CaptureReader(const std::string &path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("failed to open \"" + path + "\": " + std::strerror(errno));
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || std::size_t(st.st_size) < capture_alignment) {
+    close(fd);
+    throw std::runtime_error("\"" + path + "\" is not a capture file");
+  }
+
+  size_ = st.st_size;
+  void *data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    throw std::runtime_error("mmap of \"" + path + "\" failed: " + std::strerror(errno));
+
+  data_   = static_cast<const uint8_t *>(data);
+  header_ = reinterpret_cast<const CaptureFileHeader *>(data_);
+
+  if (std::memcmp(header_->magic, "LCRCAPT1", sizeof(header_->magic)) != 0 || header_->version != capture_version || header_->record_size == 0 ||
+      header_->header_size < sizeof(CaptureFileHeader) || header_->frame_bytes + sizeof(FrameRecordHeader) > header_->record_size) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    throw std::runtime_error("\"" + path + "\" is not a capture file of version " + std::to_string(capture_version));
+  }
+
+  // use the stored index if the footer is complete and consistent with the file
+  const CaptureFileFooter *footer = reinterpret_cast<const CaptureFileFooter *>(data_ + size_ - sizeof(CaptureFileFooter));
+
+  if (std::memcmp(footer->magic, "LCRINDEX", sizeof(footer->magic)) == 0 && footer->index_offset >= header_->header_size &&
+      footer->index_offset + footer->count * sizeof(CaptureIndexEntry) <= size_ - sizeof(CaptureFileFooter)) {
+    index_ = reinterpret_cast<const CaptureIndexEntry *>(data_ + footer->index_offset);
+    count_ = footer->count;
+  } else {
+    recoverIndex();
+  }
+
+  // madvise is only a hint, lookups work without it
+  madvise(const_cast<uint8_t *>(data_), size_, MADV_RANDOM);
+}
+
+CaptureReader::~CaptureReader()
+{
+  munmap(const_cast<uint8_t *>(data_), size_);
+}
+
+void
+CaptureReader::recoverIndex()
+{
+  const std::size_t records = (size_ - header_->header_size) / header_->record_size;
+
+  for (std::size_t i = 0; i < records; i++) {
+    const FrameRecordHeader *h = reinterpret_cast<const FrameRecordHeader *>(data_ + header_->header_size + i * header_->record_size);
+    if (std::memcmp(h->magic, "LCRFRAME", sizeof(h->magic)) == 0 && h->record == i)
+      recovered_index_.push_back({h->sequence, h->timestamp, h->record});
+  }
+
+  std::sort(recovered_index_.begin(), recovered_index_.end(),
+            [](const CaptureIndexEntry &a, const CaptureIndexEntry &b) { return a.sequence < b.sequence; });
+
+  index_ = recovered_index_.data();
+  count_ = recovered_index_.size();
+}
+
+CaptureFrame
+CaptureReader::frame(std::size_t index) const
+{
+  if (index >= count_)
+    throw std::out_of_range("frame " + std::to_string(index) + " out of " + std::to_string(count_));
+
+  const uint8_t *          record = data_ + header_->header_size + index_[index].record * header_->record_size;
+  const FrameRecordHeader *h      = reinterpret_cast<const FrameRecordHeader *>(record);
+
+  if (record + header_->record_size > data_ + size_)
+    throw std::runtime_error("record " + std::to_string(index_[index].record) + " is truncated");
+
+  return {h, record + sizeof(FrameRecordHeader), std::min<std::size_t>(h->bytesused, header_->frame_bytes)};
+}
+
+std::optional<CaptureFrame>
+CaptureReader::findSequence(uint64_t sequence) const
+{
+  const CaptureIndexEntry *it =
+      std::lower_bound(index_, index_ + count_, sequence, [](const CaptureIndexEntry &e, const uint64_t s) { return e.sequence < s; });
+
+  if (it == index_ + count_ || it->sequence != sequence)
+    return std::nullopt;
+
+  return frame(it - index_);
+}
+
+std::optional<CaptureFrame>
+CaptureReader::findTimestamp(uint64_t timestamp) const
+{
+  // sensor timestamps increase with the sequence number, so the index is sorted by both
+  const CaptureIndexEntry *it =
+      std::lower_bound(index_, index_ + count_, timestamp, [](const CaptureIndexEntry &e, const uint64_t t) { return e.timestamp < t; });
+
+  if (it == index_ + count_)
+    return std::nullopt;
+
+  return frame(it - index_);
+}
+
+std::optional<sensor_msgs::CameraInfo>
+CaptureReader::cameraInfo() const
+{
+  if (header_->camera_info_size == 0 || header_->camera_info_offset + header_->camera_info_size > header_->header_size)
+    return std::nullopt;
+
+  sensor_msgs::CameraInfo camera_info;
+
+  ros::serialization::IStream stream(const_cast<uint8_t *>(data_ + header_->camera_info_offset), header_->camera_info_size);
+  ros::serialization::deserialize(stream, camera_info);
+
+  return camera_info;
+}
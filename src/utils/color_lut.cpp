@@ -0,0 +1,130 @@
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+ColorLut3D
+load_cube_lut(const std::string &path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+    throw std::runtime_error("could not open LUT file \"" + path + "\"");
+
+  ColorLut3D            lut;
+  std::array<double, 3> domain_min = {0.0, 0.0, 0.0};
+  std::array<double, 3> domain_max = {1.0, 1.0, 1.0};
+  std::vector<double>   values;
+
+  std::string line;
+  std::size_t line_number = 0;
+
+  while (std::getline(file, line)) {
+    line_number++;
+
+    std::istringstream ss(line);
+    std::string        keyword;
+
+    // skip empty lines and comments
+    if (!(ss >> keyword) || keyword.front() == '#')
+      continue;
+
+    if (!std::isalpha(static_cast<unsigned char>(keyword.front()))) {
+      // table entry
+      std::istringstream entry(line);
+      double             r, g, b;
+      if (!(entry >> r >> g >> b))
+        throw std::runtime_error("malformed LUT entry at " + path + ":" + std::to_string(line_number));
+      values.insert(values.end(), {r, g, b});
+    } else if (keyword == "TITLE") {
+      const std::size_t begin = line.find('"');
+      const std::size_t end   = line.rfind('"');
+      if (begin != std::string::npos && end > begin)
+        lut.title = line.substr(begin + 1, end - begin - 1);
+    } else if (keyword == "LUT_3D_SIZE") {
+      if (!(ss >> lut.size) || lut.size < 2 || lut.size > 256)
+        throw std::runtime_error("invalid LUT_3D_SIZE at " + path + ":" + std::to_string(line_number));
+    } else if (keyword == "LUT_1D_SIZE") {
+      throw std::runtime_error("1D LUTs are not supported (" + path + ")");
+    } else if (keyword == "DOMAIN_MIN") {
+      if (!(ss >> domain_min[0] >> domain_min[1] >> domain_min[2]))
+        throw std::runtime_error("invalid DOMAIN_MIN at " + path + ":" + std::to_string(line_number));
+    } else if (keyword == "DOMAIN_MAX") {
+      if (!(ss >> domain_max[0] >> domain_max[1] >> domain_max[2]))
+        throw std::runtime_error("invalid DOMAIN_MAX at " + path + ":" + std::to_string(line_number));
+    }
+    // other keywords are tool specific and ignored
+  }
+
+  if (lut.size == 0)
+    throw std::runtime_error("missing LUT_3D_SIZE in \"" + path + "\"");
+
+  const std::size_t entries = std::size_t(lut.size) * lut.size * lut.size;
+  if (values.size() != 3 * entries)
+    throw std::runtime_error("LUT \"" + path + "\" has " + std::to_string(values.size() / 3) + " entries, expected " + std::to_string(entries));
+
+  for (int c = 0; c < 3; c++) {
+    if (domain_max[c] <= domain_min[c])
+      throw std::runtime_error("invalid LUT domain in \"" + path + "\"");
+  }
+
+  // convert to fixed point with 8 fractional bits on top of the 8-bit output range
+  std::vector<uint16_t> table(values.size());
+  for (std::size_t i = 0; i < values.size(); i++) {
+    const int    c = i % 3;
+    const double x = std::clamp((values[i] - domain_min[c]) / (domain_max[c] - domain_min[c]), 0.0, 1.0);
+    table[i]       = uint16_t(std::lround(x * (255 << 8)));
+  }
+
+  ColorLut3D result = make_color_lut(lut.size, std::move(table));
+  result.title      = lut.title;
+  return result;
+}
+
+ColorLut3D
+make_color_lut(const unsigned int size, std::vector<uint16_t> table)
+{
+  if (size < 2 || size > 256 || table.size() != 3 * std::size_t(size) * size * size)
+    throw std::runtime_error("invalid LUT grid");
+
+  ColorLut3D lut;
+  lut.size  = size;
+  lut.table = std::move(table);
+  lut.table.push_back(0);
+
+  // precompute the grid cell and the position inside the cell for every input value
+  for (unsigned int v = 0; v < 256; v++) {
+    const unsigned int p = v * (lut.size - 1);
+    unsigned int       i = p / 255;
+    unsigned int       w = ((p % 255) * 256 + 127) / 255;
+    if (i >= lut.size - 1) {
+      i = lut.size - 2;
+      w = 256;
+    }
+    lut.offset_r[v] = 3 * i;
+    lut.offset_g[v] = 3 * i * lut.size;
+    lut.offset_b[v] = 3 * i * lut.size * lut.size;
+    lut.weight[v]   = w;
+  }
+
+  return lut;
+}
+
+void
+apply_color_lut(const ColorLut3D &lut, const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int width,
+                unsigned int height, unsigned int channels, bool bgr)
+{
+  if (lut.size < 2 || (channels != 3 && channels != 4))
+    throw std::runtime_error("invalid LUT or pixel layout");
+
+  const Kernels &k = kernels();
+
+  for (unsigned int y = 0; y < height; y++)
+    k.apply_lut_row(lut, src + y * src_step, dst + y * dst_step, width, channels, bgr);
+}
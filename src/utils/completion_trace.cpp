@@ -0,0 +1,105 @@
+#include <libcamera_ros_driver/utils/completion_trace.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+
+static uint64_t
+monotonic_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CompletionTraceWriter::CompletionTraceWriter(const std::string &path, const std::string &comment) : file_(path, std::ios::trunc)
+{
+  if (!file_.is_open())
+    throw std::runtime_error("could not create trace file \"" + path + "\"");
+
+  file_ << "# " << comment << "\n";
+  file_ << "# completion [ns],sequence,status,bytesused [bytes],timestamp [ns]\n";
+}
+
+void
+CompletionTraceWriter::complete(const FrameView &frame)
+{
+  CompletionRecord record;
+  record.completion = monotonic_ns();
+  record.sequence   = frame.sequence;
+  record.status     = CompletionStatus::COMPLETE;
+  record.bytesused  = frame.size;
+  record.timestamp  = frame.timestamp;
+
+  write(record);
+}
+
+void
+CompletionTraceWriter::cancelled()
+{
+  CompletionRecord record;
+  record.completion = monotonic_ns();
+  record.status     = CompletionStatus::CANCELLED;
+
+  write(record);
+}
+
+void
+CompletionTraceWriter::write(const CompletionRecord &record)
+{
+  // formatted outside of the stream, the lines are short and written from the frame thread
+  char      line[128];
+  const int length = std::snprintf(line, sizeof(line), "%" PRIu64 ",%" PRIu64 ",%s,%zu,%" PRIu64 "\n", record.completion, record.sequence,
+                                   record.status == CompletionStatus::COMPLETE ? "complete" : "cancelled", record.bytesused, record.timestamp);
+
+  std::scoped_lock lock(mutex_);
+  file_.write(line, length);
+  records_++;
+}
+
+std::vector<CompletionRecord>
+load_completion_trace(const std::string &path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+    throw std::runtime_error("could not open trace file \"" + path + "\"");
+
+  std::vector<CompletionRecord> trace;
+
+  std::string line;
+  std::size_t line_number = 0;
+
+  while (std::getline(file, line)) {
+    line_number++;
+
+    // skip empty lines and comments
+    if (line.empty() || line.front() == '#')
+      continue;
+
+    std::istringstream ss(line);
+    CompletionRecord   record;
+    std::string        status;
+    char               c1, c2, c3;
+
+    if (!(ss >> record.completion >> c1 >> record.sequence >> c2) || c1 != ',' || c2 != ',' || !std::getline(ss, status, ',') ||
+        !(ss >> record.bytesused >> c3 >> record.timestamp) || c3 != ',')
+      throw std::runtime_error("malformed record in trace file \"" + path + "\" on line " + std::to_string(line_number));
+
+    if (status == "complete")
+      record.status = CompletionStatus::COMPLETE;
+    else if (status == "cancelled")
+      record.status = CompletionStatus::CANCELLED;
+    else
+      throw std::runtime_error("unknown status \"" + status + "\" in trace file \"" + path + "\" on line " + std::to_string(line_number));
+
+    if (!trace.empty() && record.completion < trace.back().completion)
+      throw std::runtime_error("completion times of trace file \"" + path + "\" decrease on line " + std::to_string(line_number));
+
+    trace.push_back(record);
+  }
+
+  if (trace.empty())
+    throw std::runtime_error("trace file \"" + path + "\" contains no records");
+
+  return trace;
+}
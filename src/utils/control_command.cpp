@@ -0,0 +1,160 @@
+#include <libcamera_ros_driver/utils/control_command.h>
+#include <libcamera_ros_driver/utils/clamp.h>
+#include <libcamera_ros_driver/utils/type_extent.h>
+#include <algorithm>
+#include <cstdint>
+
+#include <libcamera/base/span.h>
+#include <libcamera/control_ids.h>
+
+
+namespace ctrl = libcamera::controls;
+
+// type and number of elements the value of a slot is converted to
+struct slot_type_t
+{
+  libcamera::ControlType type;
+  std::size_t            extent;  // 0 for scalars
+};
+
+static slot_type_t
+slot_type(const ControlSlot slot)
+{
+  switch (slot) {
+    case ControlSlot::EXPOSURE_TIME:
+      return {libcamera::ControlTypeInteger32, 0};
+    case ControlSlot::ANALOGUE_GAIN:
+      return {libcamera::ControlTypeFloat, 0};
+    case ControlSlot::FRAME_DURATION_LIMITS:
+      return {libcamera::ControlTypeInteger64, 2};
+    case ControlSlot::COLOUR_GAINS:
+      return {libcamera::ControlTypeFloat, 2};
+  }
+
+  return {libcamera::ControlTypeNone, 0};
+}
+
+std::string
+to_string(const ControlSlot slot)
+{
+  return control_slot_id(slot).name();
+}
+
+const libcamera::ControlId &
+control_slot_id(const ControlSlot slot)
+{
+  switch (slot) {
+    case ControlSlot::EXPOSURE_TIME:
+      return ctrl::ExposureTime;
+    case ControlSlot::ANALOGUE_GAIN:
+      return ctrl::AnalogueGain;
+    case ControlSlot::FRAME_DURATION_LIMITS:
+      return ctrl::FrameDurationLimits;
+    case ControlSlot::COLOUR_GAINS:
+      return ctrl::ColourGains;
+  }
+
+  return ctrl::ExposureTime;
+}
+
+bool
+ControlCommandValues::empty() const
+{
+  return std::none_of(set.begin(), set.end(), [](const bool s) { return s; });
+}
+
+libcamera::ControlValue
+control_slot_value(const ControlSlot slot, const std::array<double, 2> &value)
+{
+  switch (slot) {
+    case ControlSlot::EXPOSURE_TIME:
+      return libcamera::ControlValue(int32_t(value[0]));
+    case ControlSlot::ANALOGUE_GAIN:
+      return libcamera::ControlValue(float(value[0]));
+    case ControlSlot::FRAME_DURATION_LIMITS: {
+      const std::array<int64_t, 2> limits = {int64_t(value[0]), int64_t(value[1])};
+      return libcamera::ControlValue(libcamera::Span<const int64_t, 2>(limits));
+    }
+    case ControlSlot::COLOUR_GAINS: {
+      const std::array<float, 2> gains = {float(value[0]), float(value[1])};
+      return libcamera::ControlValue(libcamera::Span<const float, 2>(gains));
+    }
+  }
+
+  return {};
+}
+
+// smallest and largest element of a numeric control value
+static bool
+numeric_limits(const libcamera::ControlValue &value, double &lo, double &hi)
+{
+  switch (value.type()) {
+    case libcamera::ControlTypeInteger32:
+      lo = min<libcamera::ControlTypeInteger32>(value);
+      hi = max<libcamera::ControlTypeInteger32>(value);
+      return true;
+    case libcamera::ControlTypeInteger64:
+      lo = min<libcamera::ControlTypeInteger64>(value);
+      hi = max<libcamera::ControlTypeInteger64>(value);
+      return true;
+    case libcamera::ControlTypeFloat:
+      lo = min<libcamera::ControlTypeFloat>(value);
+      hi = max<libcamera::ControlTypeFloat>(value);
+      return true;
+    default:
+      return false;
+  }
+}
+
+ControlDescriptors::ControlDescriptors(const libcamera::ControlInfoMap &controls)
+{
+  for (std::size_t i = 0; i < control_slot_count; i++) {
+    const ControlSlot           slot = ControlSlot(i);
+    const libcamera::ControlId &id   = control_slot_id(slot);
+    const slot_type_t           type = slot_type(slot);
+    const auto                  it   = controls.find(&id);
+    descriptor_t &              d    = descriptors_[i];
+
+    if (it == controls.end() || id.type() != type.type || get_extent(&id) != type.extent)
+      continue;
+
+    // the limits of the elements of array controls are shared, as in the control parameters
+    double lo_min, lo_max, hi_min, hi_max;
+    if (!numeric_limits(it->second.min(), lo_min, lo_max) || !numeric_limits(it->second.max(), hi_min, hi_max))
+      continue;
+
+    d.available = true;
+    d.min       = lo_min;
+    d.max       = hi_max;
+  }
+}
+
+unsigned int
+ControlDescriptors::validate(ControlCommandValues &values) const
+{
+  unsigned int clamped = 0;
+
+  for (std::size_t i = 0; i < control_slot_count; i++) {
+    if (!values.set[i])
+      continue;
+
+    const descriptor_t &d = descriptors_[i];
+    if (!d.available) {
+      values.set[i] = false;
+      continue;
+    }
+
+    const std::size_t elements = std::max<std::size_t>(slot_type(ControlSlot(i)).extent, 1);
+    for (std::size_t e = 0; e < elements; e++) {
+      double &v = values.values[i][e];
+
+      const double limited = d.max > d.min ? std::clamp(v, d.min, d.max) : std::max(v, d.min);
+      if (limited != v) {
+        v = limited;
+        clamped++;
+      }
+    }
+  }
+
+  return clamped;
+}
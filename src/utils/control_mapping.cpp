@@ -75,3 +75,22 @@ libcamera::controls::AwbModeEnum get_awb_mode(const std::string &mode){
     throw std::runtime_error("invalid awb mode: \"" + mode + "\"");
   }
 }
+
+libcamera::controls::draft::TestPatternModeEnum get_test_pattern_mode(const std::string &mode){
+  static const std::unordered_map<std::string, libcamera::controls::draft::TestPatternModeEnum> mode_map = {
+    {"off", libcamera::controls::draft::TestPatternModeEnum::TestPatternModeOff},
+    {"solid-color", libcamera::controls::draft::TestPatternModeEnum::TestPatternModeSolidColor},
+    {"color-bars", libcamera::controls::draft::TestPatternModeEnum::TestPatternModeColorBars},
+    {"color-bars-fade-to-gray", libcamera::controls::draft::TestPatternModeEnum::TestPatternModeColorBarsFadeToGray},
+    {"pn9", libcamera::controls::draft::TestPatternModeEnum::TestPatternModePn9},
+    {"custom1", libcamera::controls::draft::TestPatternModeEnum::TestPatternModeCustom1},
+  };
+
+  try {
+    return mode_map.at(mode);
+  }
+  catch (const std::out_of_range &) {
+    ROS_ERROR_STREAM("invalid test pattern mode: \"" << mode << "\"");
+    throw std::runtime_error("invalid test pattern mode: \"" + mode + "\"");
+  }
+}
@@ -0,0 +1,596 @@
+#include <libcamera_ros_driver/utils/dng_writer.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <map>
+#include <stdexcept>
+#include <unistd.h>
+#include <unordered_map>
+
+#include <libcamera/formats.h>
+#include <libcamera/pixel_format.h>
+
+
+namespace cam = libcamera::formats;
+
+std::optional<RawLayout>
+get_raw_layout(const libcamera::PixelFormat &pixelformat)
+{
+  static const std::unordered_map<uint32_t, RawLayout> map_raw_layout = {
+    {cam::SRGGB8.fourcc(), {BayerOrder::RGGB, 8, RawPacking::NONE}},
+    {cam::SGRBG8.fourcc(), {BayerOrder::GRBG, 8, RawPacking::NONE}},
+    {cam::SGBRG8.fourcc(), {BayerOrder::GBRG, 8, RawPacking::NONE}},
+    {cam::SBGGR8.fourcc(), {BayerOrder::BGGR, 8, RawPacking::NONE}},
+    {cam::SRGGB16.fourcc(), {BayerOrder::RGGB, 16, RawPacking::NONE}},
+    {cam::SGRBG16.fourcc(), {BayerOrder::GRBG, 16, RawPacking::NONE}},
+    {cam::SGBRG16.fourcc(), {BayerOrder::GBRG, 16, RawPacking::NONE}},
+    {cam::SBGGR16.fourcc(), {BayerOrder::BGGR, 16, RawPacking::NONE}},
+    {cam::SRGGB10_CSI2P.fourcc(), {BayerOrder::RGGB, 10, RawPacking::CSI2P}},
+    {cam::SGRBG10_CSI2P.fourcc(), {BayerOrder::GRBG, 10, RawPacking::CSI2P}},
+    {cam::SGBRG10_CSI2P.fourcc(), {BayerOrder::GBRG, 10, RawPacking::CSI2P}},
+    {cam::SBGGR10_CSI2P.fourcc(), {BayerOrder::BGGR, 10, RawPacking::CSI2P}},
+    {cam::SRGGB12_CSI2P.fourcc(), {BayerOrder::RGGB, 12, RawPacking::CSI2P}},
+    {cam::SGRBG12_CSI2P.fourcc(), {BayerOrder::GRBG, 12, RawPacking::CSI2P}},
+    {cam::SGBRG12_CSI2P.fourcc(), {BayerOrder::GBRG, 12, RawPacking::CSI2P}},
+    {cam::SBGGR12_CSI2P.fourcc(), {BayerOrder::BGGR, 12, RawPacking::CSI2P}},
+    {cam::SRGGB14_CSI2P.fourcc(), {BayerOrder::RGGB, 14, RawPacking::CSI2P}},
+    {cam::SGRBG14_CSI2P.fourcc(), {BayerOrder::GRBG, 14, RawPacking::CSI2P}},
+    {cam::SGBRG14_CSI2P.fourcc(), {BayerOrder::GBRG, 14, RawPacking::CSI2P}},
+    {cam::SBGGR14_CSI2P.fourcc(), {BayerOrder::BGGR, 14, RawPacking::CSI2P}},
+  };
+
+  if (map_raw_layout.count(pixelformat.fourcc()))
+    return map_raw_layout.at(pixelformat.fourcc());
+
+  return std::nullopt;
+}
+
+// samples of a CSI-2 packed group, the most significant bits of every sample are stored in one byte each and
+// the remaining bits of all samples follow in the last bytes of the group
+template <unsigned int BITS>
+static constexpr unsigned int csi2_group_pixels = BITS == 12 ? 2 : 4;
+
+template <unsigned int BITS>
+static constexpr unsigned int csi2_group_bytes = csi2_group_pixels<BITS> * BITS / 8;
+
+template <unsigned int BITS>
+static inline void
+unpack_group(const uint8_t *s, uint16_t *d)
+{
+  if constexpr (BITS == 10) {
+    d[0] = uint16_t(s[0] << 2 | (s[4] & 0x03));
+    d[1] = uint16_t(s[1] << 2 | (s[4] >> 2 & 0x03));
+    d[2] = uint16_t(s[2] << 2 | (s[4] >> 4 & 0x03));
+    d[3] = uint16_t(s[3] << 2 | s[4] >> 6);
+  } else if constexpr (BITS == 12) {
+    d[0] = uint16_t(s[0] << 4 | (s[2] & 0x0f));
+    d[1] = uint16_t(s[1] << 4 | s[2] >> 4);
+  } else {
+    d[0] = uint16_t(s[0] << 6 | (s[4] & 0x3f));
+    d[1] = uint16_t(s[1] << 6 | s[4] >> 6 | (s[5] & 0x0f) << 2);
+    d[2] = uint16_t(s[2] << 6 | s[5] >> 4 | (s[6] & 0x03) << 4);
+    d[3] = uint16_t(s[3] << 6 | s[6] >> 2);
+  }
+}
+
+template <unsigned int BITS>
+static void
+unpack_row(const uint8_t *src, uint16_t *dst, const unsigned int width)
+{
+  constexpr unsigned int pixels = csi2_group_pixels<BITS>;
+  constexpr unsigned int bytes  = csi2_group_bytes<BITS>;
+
+  const unsigned int full = width / pixels * pixels;
+  for (unsigned int x = 0; x < full; x += pixels, src += bytes) {
+    unpack_group<BITS>(src, dst + x);
+  }
+
+  // the row is padded to a complete group
+  if (full < width) {
+    uint16_t group[pixels];
+    unpack_group<BITS>(src, group);
+    std::copy(group, group + (width - full), dst + full);
+  }
+}
+
+// bytes of a source row that hold 'width' samples
+static std::size_t
+packed_row_bytes(const RawLayout &layout, const unsigned int width)
+{
+  if (layout.packing == RawPacking::NONE)
+    return std::size_t(width) * (layout.bits > 8 ? 2 : 1);
+
+  const unsigned int pixels = layout.bits == 12 ? 2 : 4;
+  return std::size_t((width + pixels - 1) / pixels) * (pixels * layout.bits / 8);
+}
+
+/* TIFF structure //{ */
+
+// TIFF tags, see the TIFF 6.0, TIFF/EP and DNG 1.4 specifications
+enum : uint16_t
+{
+  TAG_NEW_SUBFILE_TYPE           = 254,
+  TAG_IMAGE_WIDTH                = 256,
+  TAG_IMAGE_LENGTH               = 257,
+  TAG_BITS_PER_SAMPLE            = 258,
+  TAG_COMPRESSION                = 259,
+  TAG_PHOTOMETRIC_INTERPRETATION = 262,
+  TAG_IMAGE_DESCRIPTION          = 270,
+  TAG_MAKE                       = 271,
+  TAG_MODEL                      = 272,
+  TAG_STRIP_OFFSETS              = 273,
+  TAG_ORIENTATION                = 274,
+  TAG_SAMPLES_PER_PIXEL          = 277,
+  TAG_ROWS_PER_STRIP             = 278,
+  TAG_STRIP_BYTE_COUNTS          = 279,
+  TAG_PLANAR_CONFIGURATION       = 284,
+  TAG_SOFTWARE                   = 305,
+  TAG_DATE_TIME                  = 306,
+  TAG_CFA_REPEAT_PATTERN_DIM     = 33421,
+  TAG_CFA_PATTERN                = 33422,
+  TAG_EXPOSURE_TIME              = 33434,
+  TAG_EXIF_IFD                   = 34665,
+  TAG_ISO_SPEED_RATINGS          = 34855,
+  TAG_EXIF_VERSION               = 36864,
+  TAG_DNG_VERSION                = 50706,
+  TAG_DNG_BACKWARD_VERSION       = 50707,
+  TAG_UNIQUE_CAMERA_MODEL        = 50708,
+  TAG_CFA_PLANE_COLOR            = 50710,
+  TAG_CFA_LAYOUT                 = 50711,
+  TAG_BLACK_LEVEL_REPEAT_DIM     = 50713,
+  TAG_BLACK_LEVEL                = 50714,
+  TAG_WHITE_LEVEL                = 50717,
+  TAG_COLOR_MATRIX_1             = 50721,
+  TAG_AS_SHOT_NEUTRAL            = 50728,
+  TAG_CALIBRATION_ILLUMINANT_1   = 50778,
+};
+
+// TIFF field types
+enum : uint16_t
+{
+  TYPE_BYTE      = 1,
+  TYPE_ASCII     = 2,
+  TYPE_SHORT     = 3,
+  TYPE_LONG      = 4,
+  TYPE_RATIONAL  = 5,
+  TYPE_UNDEFINED = 7,
+  TYPE_SRATIONAL = 10,
+};
+
+// image file directory in the byte order of the host, values that do not fit into their entry follow the entries
+class TiffDirectory {
+public:
+  void bytes(const uint16_t tag, const std::vector<uint8_t> &values, const uint16_t type = TYPE_BYTE) {
+    add(tag, type, values.size(), values.data(), values.size());
+  }
+
+  void ascii(const uint16_t tag, const std::string &value) {
+    add(tag, TYPE_ASCII, value.size() + 1, value.c_str(), value.size() + 1);
+  }
+
+  void shorts(const uint16_t tag, const std::vector<uint16_t> &values) {
+    add(tag, TYPE_SHORT, values.size(), values.data(), values.size() * sizeof(uint16_t));
+  }
+
+  void longs(const uint16_t tag, const std::vector<uint32_t> &values) {
+    add(tag, TYPE_LONG, values.size(), values.data(), values.size() * sizeof(uint32_t));
+  }
+
+  // numerator and denominator of every value
+  void rationals(const uint16_t tag, const std::vector<uint32_t> &values) {
+    add(tag, TYPE_RATIONAL, values.size() / 2, values.data(), values.size() * sizeof(uint32_t));
+  }
+
+  void srationals(const uint16_t tag, const std::vector<int32_t> &values) {
+    add(tag, TYPE_SRATIONAL, values.size() / 2, values.data(), values.size() * sizeof(int32_t));
+  }
+
+  std::size_t size() const {
+    std::size_t size = 2 + 12 * entries_.size() + 4;
+    for (const auto &e : entries_) {
+      if (e.second.value.size() > 4)
+        size += (e.second.value.size() + 1) & ~std::size_t(1);
+    }
+    return size;
+  }
+
+  // append the directory to 'out', which has to end at the file offset of the directory
+  void serialize(std::vector<uint8_t> &out) const {
+    const std::size_t offset = out.size();
+
+    std::size_t data = offset + 2 + 12 * entries_.size() + 4;
+    out.resize(offset + size(), 0);
+
+    uint8_t *p = out.data() + offset;
+    put<uint16_t>(p, uint16_t(entries_.size()));
+
+    // the entries are sorted by their tag
+    for (const auto &e : entries_) {
+      put<uint16_t>(p, e.first);
+      put<uint16_t>(p, e.second.type);
+      put<uint32_t>(p, e.second.count);
+
+      if (e.second.value.size() <= 4) {
+        std::memcpy(p, e.second.value.data(), e.second.value.size());
+        p += 4;
+      } else {
+        put<uint32_t>(p, uint32_t(data));
+        std::memcpy(out.data() + data, e.second.value.data(), e.second.value.size());
+        data += (e.second.value.size() + 1) & ~std::size_t(1);
+      }
+    }
+
+    // no further directory
+    put<uint32_t>(p, 0);
+  }
+
+private:
+  struct entry_t
+  {
+    uint16_t             type;
+    uint32_t             count;
+    std::vector<uint8_t> value;
+  };
+
+  void add(const uint16_t tag, const uint16_t type, const std::size_t count, const void *value, const std::size_t bytes) {
+    entry_t &e = entries_[tag];
+    e.type     = type;
+    e.count    = uint32_t(count);
+    e.value.assign(static_cast<const uint8_t *>(value), static_cast<const uint8_t *>(value) + bytes);
+  }
+
+  template <typename T>
+  static void put(uint8_t *&p, const T value) {
+    std::memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+  }
+
+  std::map<uint16_t, entry_t> entries_;
+};
+
+// numerator and denominator of a signed rational with a fixed precision
+static void
+push_srational(std::vector<int32_t> &values, const double value)
+{
+  values.push_back(int32_t(std::lround(std::clamp(value, -100000.0, 100000.0) * 10000)));
+  values.push_back(10000);
+}
+
+static void
+push_rational(std::vector<uint32_t> &values, const double value)
+{
+  values.push_back(uint32_t(std::lround(std::clamp(value, 0.0, 100000.0) * 10000)));
+  values.push_back(10000);
+}
+
+static std::array<double, 9>
+multiply(const std::array<double, 9> &a, const std::array<double, 9> &b)
+{
+  std::array<double, 9> c{};
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        c[i * 3 + j] += a[i * 3 + k] * b[k * 3 + j];
+  return c;
+}
+
+static std::optional<std::array<double, 9>>
+invert(const std::array<double, 9> &m)
+{
+  const double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+  if (std::abs(det) < 1e-12)
+    return std::nullopt;
+
+  return std::array<double, 9>{
+      (m[4] * m[8] - m[5] * m[7]) / det, (m[2] * m[7] - m[1] * m[8]) / det, (m[1] * m[5] - m[2] * m[4]) / det,
+      (m[5] * m[6] - m[3] * m[8]) / det, (m[0] * m[8] - m[2] * m[6]) / det, (m[2] * m[3] - m[0] * m[5]) / det,
+      (m[3] * m[7] - m[4] * m[6]) / det, (m[1] * m[6] - m[0] * m[7]) / det, (m[0] * m[4] - m[1] * m[3]) / det,
+  };
+}
+
+//}
+
+// colour of the samples of the 2x2 tile of every order, 0 red, 1 green, 2 blue
+static const uint8_t cfa_colours[4][4] = {
+    {0, 1, 1, 2},  // RGGB
+    {1, 0, 2, 1},  // GRBG
+    {1, 2, 0, 1},  // GBRG
+    {2, 1, 1, 0},  // BGGR
+};
+
+// index of the black level (R, Gr, Gb, B) of the samples of the 2x2 tile of every order
+static const uint8_t cfa_black_levels[4][4] = {
+    {0, 1, 2, 3},  // RGGB
+    {1, 0, 3, 2},  // GRBG
+    {2, 3, 0, 1},  // GBRG
+    {3, 2, 1, 0},  // BGGR
+};
+
+// file header and directories, the image data follows at the end of the returned bytes
+static std::vector<uint8_t>
+dng_header(const DngStream &stream, const DngFrameInfo &info)
+{
+  const RawLayout &  layout       = stream.layout;
+  const int          order        = int(layout.order);
+  const unsigned int sample_bytes = layout.bits > 8 ? 2 : 1;
+  const uint32_t     image_bytes  = stream.size.width * stream.size.height * sample_bytes;
+  const uint32_t     white_level  = (1u << layout.bits) - 1;
+  const int          black_shift  = 16 - int(layout.bits);
+  const std::string  camera_model = stream.camera_model.empty() ? "camera" : stream.camera_model;
+
+  char        date_time[20];
+  std::time_t now = std::time(nullptr);
+  std::tm     tm;
+  std::strftime(date_time, sizeof(date_time), "%Y:%m:%d %H:%M:%S", localtime_r(&now, &tm));
+
+  TiffDirectory ifd;
+  ifd.longs(TAG_NEW_SUBFILE_TYPE, {0});
+  ifd.longs(TAG_IMAGE_WIDTH, {stream.size.width});
+  ifd.longs(TAG_IMAGE_LENGTH, {stream.size.height});
+  ifd.shorts(TAG_BITS_PER_SAMPLE, {uint16_t(sample_bytes * 8)});
+  ifd.shorts(TAG_COMPRESSION, {1});
+  ifd.shorts(TAG_PHOTOMETRIC_INTERPRETATION, {32803});  // CFA
+  ifd.ascii(TAG_IMAGE_DESCRIPTION, "frame " + std::to_string(info.sequence) + ", sensor timestamp " + std::to_string(info.timestamp) + " ns");
+  ifd.ascii(TAG_MAKE, "libcamera");
+  ifd.ascii(TAG_MODEL, camera_model);
+  ifd.longs(TAG_STRIP_OFFSETS, {0});
+  ifd.shorts(TAG_ORIENTATION, {1});
+  ifd.shorts(TAG_SAMPLES_PER_PIXEL, {1});
+  ifd.longs(TAG_ROWS_PER_STRIP, {stream.size.height});
+  ifd.longs(TAG_STRIP_BYTE_COUNTS, {image_bytes});
+  ifd.shorts(TAG_PLANAR_CONFIGURATION, {1});
+  ifd.ascii(TAG_SOFTWARE, "libcamera_ros_driver");
+  ifd.ascii(TAG_DATE_TIME, date_time);
+  ifd.shorts(TAG_CFA_REPEAT_PATTERN_DIM, {2, 2});
+  ifd.bytes(TAG_CFA_PATTERN, {cfa_colours[order][0], cfa_colours[order][1], cfa_colours[order][2], cfa_colours[order][3]});
+  ifd.longs(TAG_EXIF_IFD, {0});
+  ifd.bytes(TAG_DNG_VERSION, {1, 4, 0, 0});
+  ifd.bytes(TAG_DNG_BACKWARD_VERSION, {1, 1, 0, 0});
+  ifd.ascii(TAG_UNIQUE_CAMERA_MODEL, camera_model);
+  ifd.bytes(TAG_CFA_PLANE_COLOR, {0, 1, 2});
+  ifd.shorts(TAG_CFA_LAYOUT, {1});
+  ifd.longs(TAG_WHITE_LEVEL, {white_level});
+
+  // the sensor reports the black levels in 16-bit scale, the samples keep the bit depth of the sensor
+  if (info.black_levels) {
+    std::vector<uint32_t> levels;
+    for (int i = 0; i < 4; i++) {
+      levels.push_back(uint32_t(std::clamp((*info.black_levels)[cfa_black_levels[order][i]], 0, 0xffff) >> black_shift));
+    }
+    ifd.shorts(TAG_BLACK_LEVEL_REPEAT_DIM, {2, 2});
+    ifd.longs(TAG_BLACK_LEVEL, levels);
+  }
+
+  // the colour matrix maps XYZ to the camera colours, it inverts the white balance, the colour correction of
+  // the pipeline and the conversion from linear sRGB to XYZ; identity stands in for what was not reported
+  const std::array<double, 2> gains = info.colour_gains ? std::array<double, 2>{(*info.colour_gains)[0], (*info.colour_gains)[1]} : std::array<double, 2>{1.0, 1.0};
+
+  std::array<double, 9> ccm = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  if (info.colour_matrix) {
+    std::copy(info.colour_matrix->begin(), info.colour_matrix->end(), ccm.begin());
+  }
+
+  const std::array<double, 9> rgb_to_xyz = {
+      0.4124564, 0.3575761, 0.1804375,  //
+      0.2126729, 0.7151522, 0.0721750,  //
+      0.0193339, 0.1191920, 0.9503041,  //
+  };
+  const std::array<double, 9> white_balance = {gains[0], 0, 0, 0, 1, 0, 0, 0, gains[1]};
+
+  const std::optional<std::array<double, 9>> color_matrix = invert(multiply(rgb_to_xyz, multiply(ccm, white_balance)));
+  if (color_matrix && gains[0] > 0.0 && gains[1] > 0.0) {
+    std::vector<int32_t> matrix;
+    for (const double v : *color_matrix) {
+      push_srational(matrix, v);
+    }
+    ifd.srationals(TAG_COLOR_MATRIX_1, matrix);
+    ifd.shorts(TAG_CALIBRATION_ILLUMINANT_1, {21});  // D65
+
+    std::vector<uint32_t> neutral;
+    push_rational(neutral, 1.0 / gains[0]);
+    push_rational(neutral, 1.0);
+    push_rational(neutral, 1.0 / gains[1]);
+    ifd.rationals(TAG_AS_SHOT_NEUTRAL, neutral);
+  }
+
+  TiffDirectory exif;
+  exif.bytes(TAG_EXIF_VERSION, {'0', '2', '3', '0'}, TYPE_UNDEFINED);
+
+  if (info.exposure_time) {
+    exif.rationals(TAG_EXPOSURE_TIME, {uint32_t(std::max(*info.exposure_time, 0)), 1000000});
+  }
+  if (info.analogue_gain) {
+    exif.shorts(TAG_ISO_SPEED_RATINGS, {uint16_t(std::clamp(std::lround(*info.analogue_gain * 100), 0l, 65535l))});
+  }
+
+  // the directories follow the file header, the image data follows the directories
+  const uint32_t ifd_offset  = 8;
+  const uint32_t exif_offset = ifd_offset + ifd.size();
+  const uint32_t data_offset = (exif_offset + exif.size() + 15) & ~15u;
+
+  ifd.longs(TAG_EXIF_IFD, {exif_offset});
+  ifd.longs(TAG_STRIP_OFFSETS, {data_offset});
+
+  // the samples are written in the byte order of the host, so is the whole file
+  std::vector<uint8_t> header = {'I', 'I', 42, 0};
+  if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) {
+    header = {'M', 'M', 0, 42};
+  }
+  header.resize(8);
+  std::memcpy(header.data() + 4, &ifd_offset, sizeof(ifd_offset));
+
+  ifd.serialize(header);
+  exif.serialize(header);
+  header.resize(data_offset, 0);
+
+  return header;
+}
+
+static bool
+write_all(const int fd, const uint8_t *data, std::size_t size)
+{
+  while (size > 0) {
+    const ssize_t n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= std::size_t(n);
+  }
+  return true;
+}
+
+// unpacked rows are collected into blocks of about this size before they are written
+static constexpr std::size_t chunk_bytes = 1 << 20;
+
+DngWriter::DngWriter(const DngStream &stream, std::size_t frame_bytes, unsigned int slots) : stream_(stream), frame_bytes_(frame_bytes)
+{
+  if (stream_.size.isNull())
+    throw std::runtime_error("the stream has no size");
+
+  if (stream_.stride < packed_row_bytes(stream_.layout, stream_.size.width))
+    throw std::runtime_error("the stride of " + std::to_string(stream_.stride) + " bytes is too small for " + std::to_string(stream_.size.width) + " samples");
+
+  slots_.resize(std::max(slots, 1u));
+  for (slot_t &slot : slots_) {
+    slot.data.resize(frame_bytes_);
+    free_.push_back(&slot);
+  }
+
+  const std::size_t row_bytes = std::size_t(stream_.size.width) * (stream_.layout.bits > 8 ? 2 : 1);
+  chunk_.resize(std::max(chunk_bytes / row_bytes, std::size_t(1)) * row_bytes);
+
+  thread_ = std::thread(&DngWriter::writer, this);
+}
+
+DngWriter::~DngWriter()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  filled_cv_.notify_one();
+
+  thread_.join();
+}
+
+bool
+DngWriter::push(const uint8_t *data, std::size_t size, const DngFrameInfo &info, const std::string &path)
+{
+  slot_t *slot;
+
+  {
+    std::scoped_lock lock(mutex_);
+    if (free_.empty()) {
+      dropped_++;
+      return false;
+    }
+    slot = free_.back();
+    free_.pop_back();
+  }
+
+  slot->size = std::min(size, frame_bytes_);
+  slot->info = info;
+  slot->path = path;
+  std::memcpy(slot->data.data(), data, slot->size);
+
+  {
+    std::scoped_lock lock(mutex_);
+    filled_.push_back(slot);
+  }
+  filled_cv_.notify_one();
+
+  return true;
+}
+
+void
+DngWriter::writer()
+{
+  while (true) {
+    slot_t *slot;
+
+    {
+      std::unique_lock lock(mutex_);
+      filled_cv_.wait(lock, [&] { return !filled_.empty() || stop_; });
+      if (filled_.empty())
+        break;
+      slot = filled_.front();
+      filled_.pop_front();
+    }
+
+    if (write(*slot)) {
+      written_++;
+    } else {
+      failed_++;
+    }
+
+    std::scoped_lock lock(mutex_);
+    free_.push_back(slot);
+  }
+}
+
+bool
+DngWriter::write(const slot_t &slot)
+{
+  const RawLayout &  layout = stream_.layout;
+  const unsigned int width  = stream_.size.width;
+  const unsigned int height = stream_.size.height;
+  const std::size_t  stride = stream_.stride;
+
+  // the last row only needs its samples
+  if (slot.size < (height - 1) * stride + packed_row_bytes(layout, width))
+    return false;
+
+  // readers never see a partially written file under its final name
+  const std::string partial = slot.path + ".part";
+
+  const int fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  const std::vector<uint8_t> header = dng_header(stream_, slot.info);
+  bool                       ok     = write_all(fd, header.data(), header.size());
+
+  const std::size_t row_bytes = std::size_t(width) * (layout.bits > 8 ? 2 : 1);
+
+  if (ok && layout.packing == RawPacking::NONE && stride == row_bytes) {
+    // the rows are contiguous and already have the layout of the file
+    ok = write_all(fd, slot.data.data(), row_bytes * height);
+  } else if (ok) {
+    const std::size_t chunk_rows = chunk_.size() / row_bytes;
+    std::size_t       rows       = 0;
+
+    for (unsigned int y = 0; y < height && ok; y++) {
+      const uint8_t *src = slot.data.data() + y * stride;
+      uint8_t *      dst = chunk_.data() + rows * row_bytes;
+
+      if (layout.packing == RawPacking::NONE) {
+        std::memcpy(dst, src, row_bytes);
+      } else if (layout.bits == 10) {
+        unpack_row<10>(src, reinterpret_cast<uint16_t *>(dst), width);
+      } else if (layout.bits == 12) {
+        unpack_row<12>(src, reinterpret_cast<uint16_t *>(dst), width);
+      } else {
+        unpack_row<14>(src, reinterpret_cast<uint16_t *>(dst), width);
+      }
+
+      if (++rows == chunk_rows || y + 1 == height) {
+        ok   = write_all(fd, chunk_.data(), rows * row_bytes);
+        rows = 0;
+      }
+    }
+  }
+
+  ok = (close(fd) == 0) && ok;
+
+  if (ok && std::rename(partial.c_str(), slot.path.c_str()) == 0)
+    return true;
+
+  unlink(partial.c_str());
+  return false;
+}
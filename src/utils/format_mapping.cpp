@@ -1,9 +1,11 @@
 #include <libcamera_ros_driver/utils/format_mapping.h>
+#include <algorithm>
 #include <cstdint>
 #include <libcamera/formats.h>
 #include <libcamera/pixel_format.h>
 #include <sensor_msgs/image_encodings.h>
 #include <unordered_map>
+#include <unordered_set>
 
 
 namespace cam = libcamera::formats;
@@ -42,6 +44,22 @@ static const std::unordered_map<uint32_t, std::string> map_format_compressed = {
   {cam::MJPEG.fourcc(), "jpeg"},
 };
 
+// supported FourCC formats, MIPI CSI-2 packed, they have no ROS encoding and are only recorded and written as DNG
+static const std::unordered_set<uint32_t> set_format_packed = {
+  cam::SRGGB10_CSI2P.fourcc(),
+  cam::SGRBG10_CSI2P.fourcc(),
+  cam::SGBRG10_CSI2P.fourcc(),
+  cam::SBGGR10_CSI2P.fourcc(),
+  cam::SRGGB12_CSI2P.fourcc(),
+  cam::SGRBG12_CSI2P.fourcc(),
+  cam::SGBRG12_CSI2P.fourcc(),
+  cam::SBGGR12_CSI2P.fourcc(),
+  cam::SRGGB14_CSI2P.fourcc(),
+  cam::SGRBG14_CSI2P.fourcc(),
+  cam::SGBRG14_CSI2P.fourcc(),
+  cam::SBGGR14_CSI2P.fourcc(),
+};
+
 std::string
 get_ros_encoding(const libcamera::PixelFormat &pixelformat)
 {
@@ -60,9 +78,34 @@ format_type(const libcamera::PixelFormat &pixelformat)
     return FormatType::RAW;
   if (map_format_compressed.count(pixelformat.fourcc()))
     return FormatType::COMPRESSED;
+  if (set_format_packed.count(pixelformat.fourcc()))
+    return FormatType::PACKED;
   return FormatType::NONE;
 }
 
+unsigned int
+get_bytes_per_pixel(const libcamera::PixelFormat &pixelformat)
+{
+  if (!map_format_raw.count(pixelformat.fourcc()))
+    return 0;
+
+  const std::string &encoding = map_format_raw.at(pixelformat.fourcc());
+  return ros::numChannels(encoding) * ros::bitDepth(encoding) / 8;
+}
+
+std::vector<libcamera::PixelFormat>
+get_raw_formats()
+{
+  std::vector<libcamera::PixelFormat> formats;
+  for (const auto &e : map_format_raw)
+    formats.push_back(libcamera::PixelFormat(e.first));
+
+  // the map has no defined order
+  std::sort(formats.begin(), formats.end());
+
+  return formats;
+}
+
 libcamera::StreamFormats
 get_common_stream_formats(const libcamera::StreamFormats &formats)
 {
@@ -0,0 +1,102 @@
+#include <libcamera_ros_driver/utils/format_negotiation.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <algorithm>
+#include <limits>
+
+#include <sensor_msgs/image_encodings.h>
+
+
+namespace enc = sensor_msgs::image_encodings;
+
+// a conversion that has to invent colour is not a real option, but still ranks below nothing at all
+static constexpr double lost_colour_penalty = 1000.0;
+
+// JPEG and video encoders, per byte of their input
+static constexpr double encoder_cost = 8.0;
+
+static double
+bytes_per_pixel(const std::string &encoding)
+{
+  if (encoding == enc::YUV422)
+    return 2.0;
+
+  return enc::numChannels(encoding) * enc::bitDepth(encoding) / 8.0;
+}
+
+static bool
+is_colour(const std::string &encoding)
+{
+  return enc::isColor(encoding) || enc::isBayer(encoding) || encoding == enc::YUV422;
+}
+
+double
+conversion_cost(const std::string &from, const std::string &to)
+{
+  if (from == to)
+    return 0.0;
+
+  const double in  = bytes_per_pixel(from);
+  const double out = bytes_per_pixel(to);
+
+  if (!is_colour(from) && is_colour(to))
+    return lost_colour_penalty;
+
+  // demosaicing reads a neighbourhood of every pixel
+  if (enc::isBayer(from))
+    return 3.0 * (in + out);
+
+  // chroma upsampling and a colour matrix per pixel
+  if (from == enc::YUV422 && is_colour(to))
+    return 2.0 * (in + out);
+
+  // channel swaps, alpha, bit depth and luma extraction
+  return in + out;
+}
+
+double
+format_cost(const libcamera::PixelFormat &format, const FormatDemand &demand)
+{
+  const std::string encoding = get_ros_encoding(format);
+  if (encoding.empty())
+    return std::numeric_limits<double>::infinity();
+
+  // the frame is copied out of the camera buffer once
+  double cost = 2.0 * bytes_per_pixel(encoding);
+
+  if (demand.raw) {
+    cost += bytes_per_pixel(encoding);
+
+    for (const std::string &target : demand.encodings) {
+      cost += conversion_cost(encoding, target);
+    }
+  }
+
+  // the driver reads 8-bit mono and RGB images directly, it has no demosaicing or YUV conversion
+  const bool readable = enc::bitDepth(encoding) == 8 && !enc::isBayer(encoding) && encoding != enc::YUV422;
+  for (const std::string &target : demand.derived) {
+    cost += readable ? conversion_cost(encoding, target) : lost_colour_penalty;
+  }
+
+  // the encoders of the transports take mono images as they are and convert everything else to BGR, grey images
+  // are only acceptable if the raw subscribers want them too
+  const bool colour = demand.encodings.empty() || std::any_of(demand.encodings.begin(), demand.encodings.end(), is_colour);
+  const std::string encoder_input = colour ? std::string(enc::BGR8) : std::string(enc::MONO8);
+
+  for (std::size_t i = 0; i < demand.transports.size(); i++) {
+    cost += conversion_cost(encoding, encoder_input) + encoder_cost * bytes_per_pixel(encoder_input);
+  }
+
+  return cost;
+}
+
+std::optional<libcamera::PixelFormat>
+select_format(const std::vector<libcamera::PixelFormat> &formats, const FormatDemand &demand)
+{
+  if (formats.empty() || demand.empty())
+    return std::nullopt;
+
+  // the first of equally expensive formats, the camera lists its preferred ones first
+  return *std::min_element(formats.begin(), formats.end(), [&demand](const libcamera::PixelFormat &a, const libcamera::PixelFormat &b) {
+    return format_cost(a, demand) < format_cost(b, demand);
+  });
+}
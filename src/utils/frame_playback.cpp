@@ -0,0 +1,212 @@
+#include <libcamera_ros_driver/utils/frame_playback.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+
+FramePlayback::FramePlayback(const std::string &path, const StreamInfo &raw_stream, const double raw_fps)
+{
+  if (!std::filesystem::is_directory(path)) {
+
+    reader_ = std::make_unique<CaptureReader>(path);
+
+    const CaptureFileHeader &header = reader_->header();
+    stream_.format                  = libcamera::PixelFormat(header.fourcc, header.modifier);
+    stream_.size                    = libcamera::Size(header.width, header.height);
+    stream_.stride                  = header.stride;
+    stream_.frame_bytes             = header.frame_bytes;
+
+    if (reader_->size() == 0)
+      throw std::runtime_error("capture file \"" + path + "\" does not contain any frames");
+
+    return;
+  }
+
+  if (raw_stream.stride == 0 || raw_stream.size.isNull())
+    throw std::runtime_error("the layout of the raw frames in \"" + path + "\" is not defined");
+  if (raw_fps <= 0)
+    throw std::runtime_error("invalid frame rate of the raw frames: " + std::to_string(raw_fps));
+
+  stream_             = raw_stream;
+  stream_.frame_bytes = std::size_t(raw_stream.stride) * raw_stream.size.height;
+  file_interval_      = uint64_t(1e9 / raw_fps);
+
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(path)) {
+    if (entry.is_regular_file())
+      files_.push_back(entry.path().string());
+  }
+
+  if (files_.empty())
+    throw std::runtime_error("directory \"" + path + "\" does not contain any raw frames");
+
+  // zero-padded frame numbers in the file names give the recording order
+  std::sort(files_.begin(), files_.end());
+
+  file_buffer_.resize(stream_.frame_bytes);
+}
+
+FramePlayback::~FramePlayback()
+{
+  stop();
+}
+
+std::optional<sensor_msgs::CameraInfo>
+FramePlayback::cameraInfo() const
+{
+  if (!reader_)
+    return std::nullopt;
+
+  return reader_->cameraInfo();
+}
+
+void
+FramePlayback::start(const std::function<void(const FrameView &)> &callback, const PlaybackPacing pacing, const bool loop)
+{
+  if (running_)
+    throw std::runtime_error("playback is already running");
+
+  // the previous playback may have ended by itself
+  if (thread_.joinable())
+    thread_.join();
+
+  callback_ = callback;
+  pacing_   = pacing;
+  loop_     = loop;
+  stop_     = false;
+  played_   = 0;
+  skipped_  = 0;
+
+  running_ = true;
+  thread_  = std::thread(&FramePlayback::player, this);
+}
+
+void
+FramePlayback::stop()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  stop_cv_.notify_one();
+
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool
+FramePlayback::load(const std::size_t index, FrameView &frame)
+{
+  const std::size_t min_bytes = std::size_t(stream_.stride) * stream_.size.height;
+
+  if (reader_) {
+
+    CaptureFrame recorded;
+    try {
+      recorded = reader_->frame(index);
+    }
+    catch (const std::exception &) {
+      return false;
+    }
+
+    if (recorded.size < min_bytes)
+      return false;
+
+    const FrameRecordHeader &h = *recorded.header;
+
+    frame.data      = recorded.data;
+    frame.size      = recorded.size;
+    frame.sequence  = h.sequence;
+    frame.timestamp = h.timestamp;
+
+    // zero marks metadata that was not reported by the camera
+    if (h.exposure_time)
+      frame.exposure_time = h.exposure_time;
+    if (h.analogue_gain != 0.0f)
+      frame.analogue_gain = h.analogue_gain;
+    if (std::any_of(std::begin(h.black_levels), std::end(h.black_levels), [](const int32_t l) { return l != 0; }))
+      frame.black_levels = std::array<int32_t, 4>{h.black_levels[0], h.black_levels[1], h.black_levels[2], h.black_levels[3]};
+
+    return true;
+  }
+
+  std::ifstream file(files_[index], std::ios::binary);
+  file.read(reinterpret_cast<char *>(file_buffer_.data()), file_buffer_.size());
+
+  if (std::size_t(file.gcount()) < min_bytes)
+    return false;
+
+  frame.data      = file_buffer_.data();
+  frame.size      = file.gcount();
+  frame.sequence  = index;
+  frame.timestamp = index * file_interval_;
+
+  return true;
+}
+
+void
+FramePlayback::player()
+{
+  const std::size_t count = frames();
+
+  // sequence numbers and timestamps of the first and the last frame, the index is sorted by sequence number
+  uint64_t first_sequence  = 0;
+  uint64_t last_sequence   = count - 1;
+  uint64_t first_timestamp = 0;
+  uint64_t last_timestamp  = (count - 1) * file_interval_;
+  uint64_t interval        = file_interval_;
+
+  if (reader_) {
+    first_sequence  = reader_->frame(0).header->sequence;
+    last_sequence   = reader_->frame(count - 1).header->sequence;
+    first_timestamp = reader_->frame(0).header->timestamp;
+    last_timestamp  = std::max(first_timestamp, reader_->frame(count - 1).header->timestamp);
+    interval        = count > 1 ? (last_timestamp - first_timestamp) / (count - 1) : 0;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  uint64_t sequence_offset  = 0;
+  uint64_t timestamp_offset = 0;
+  bool     stopped          = false;
+
+  do {
+    for (std::size_t i = 0; i < count && !stopped; i++) {
+
+      FrameView frame;
+      if (!load(i, frame)) {
+        skipped_++;
+        continue;
+      }
+
+      frame.sequence += sequence_offset;
+      frame.timestamp += timestamp_offset;
+
+      {
+        std::unique_lock lock(mutex_);
+
+        if (pacing_ == PlaybackPacing::REALTIME) {
+          const uint64_t                              elapsed = frame.timestamp > first_timestamp ? frame.timestamp - first_timestamp : 0;
+          const std::chrono::steady_clock::time_point due     = start + std::chrono::nanoseconds(elapsed);
+          stopped = stop_cv_.wait_until(lock, due, [&] { return stop_; });
+        } else {
+          stopped = stop_;
+        }
+      }
+
+      if (stopped)
+        break;
+
+      callback_(frame);
+      played_++;
+    }
+
+    // the next repetition continues one frame interval after the last frame
+    sequence_offset += last_sequence - first_sequence + 1;
+    timestamp_offset += last_timestamp - first_timestamp + interval;
+
+  } while (loop_ && !stopped);
+
+  running_ = false;
+}
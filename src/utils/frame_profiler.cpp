@@ -0,0 +1,181 @@
+#include <libcamera_ros_driver/utils/frame_profiler.h>
+#include <libcamera_ros_driver/utils/latency_histogram.h>
+#include <libcamera_ros_driver/utils/output_accounting.h>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+
+std::string
+to_string(const FrameStage stage)
+{
+  switch (stage) {
+    case FrameStage::RECORD:
+      return "record";
+    case FrameStage::CONVERT:
+      return "convert";
+    case FrameStage::DENOISE:
+      return "denoise";
+    case FrameStage::CAMERA_INFO:
+      return "camera_info";
+    case FrameStage::PUBLISH:
+      return "publish";
+    case FrameStage::TOTAL:
+      return "total";
+  }
+
+  return {};
+}
+
+std::optional<FrameStage>
+frame_stage_from_string(const std::string &name)
+{
+  for (std::size_t i = 0; i < frame_stage_count; i++) {
+    if (to_string(FrameStage(i)) == name)
+      return FrameStage(i);
+  }
+
+  return std::nullopt;
+}
+
+void
+FrameProfiler::add(const FrameStage stage, const uint64_t nanoseconds, const uint64_t cpu_nanoseconds, const std::size_t bytes, const uint64_t allocations)
+{
+  counters_t &c = counters_[std::size_t(stage)];
+
+  c.frames.fetch_add(1, std::memory_order_relaxed);
+  c.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+  c.cpu_nanoseconds.fetch_add(cpu_nanoseconds, std::memory_order_relaxed);
+  c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  c.allocations.fetch_add(allocations, std::memory_order_relaxed);
+
+  // only the frame thread raises the maximum, a lost race with collect() merely shifts it to the next period
+  if (nanoseconds > c.max.load(std::memory_order_relaxed))
+    c.max.store(nanoseconds, std::memory_order_relaxed);
+}
+
+std::array<StageStats, frame_stage_count>
+FrameProfiler::collect()
+{
+  std::array<StageStats, frame_stage_count> stats;
+
+  for (std::size_t i = 0; i < frame_stage_count; i++) {
+    stats[i].frames          = counters_[i].frames.exchange(0, std::memory_order_relaxed);
+    stats[i].nanoseconds     = counters_[i].nanoseconds.exchange(0, std::memory_order_relaxed);
+    stats[i].cpu_nanoseconds = counters_[i].cpu_nanoseconds.exchange(0, std::memory_order_relaxed);
+    stats[i].bytes           = counters_[i].bytes.exchange(0, std::memory_order_relaxed);
+    stats[i].max             = counters_[i].max.exchange(0, std::memory_order_relaxed);
+    stats[i].allocations     = counters_[i].allocations.exchange(0, std::memory_order_relaxed);
+  }
+
+  return stats;
+}
+
+StageTimer::StageTimer(FrameProfiler *profiler, LatencyHistograms *histograms) : profiler_(profiler), histograms_(histograms)
+{
+  if (!profiler_ && !histograms_)
+    return;
+
+  start_ = last_ = clock::now();
+
+  if (profiler_) {
+    start_cpu_         = last_cpu_ = thread_cpu_time();
+    start_allocations_ = last_allocations_ = thread_allocations().value_or(0);
+  }
+}
+
+void
+StageTimer::lap(const FrameStage stage, const std::size_t bytes)
+{
+  if (!profiler_ && !histograms_)
+    return;
+
+  const clock::time_point now         = clock::now();
+  const uint64_t          nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+  last_                               = now;
+
+  if (histograms_)
+    histograms_->record(LatencyStage(stage), nanoseconds);
+
+  if (profiler_) {
+    const uint64_t cpu         = thread_cpu_time();
+    const uint64_t allocations = thread_allocations().value_or(0);
+    profiler_->add(stage, nanoseconds, cpu - last_cpu_, bytes, allocations - last_allocations_);
+    last_cpu_         = cpu;
+    last_allocations_ = allocations;
+  }
+}
+
+void
+StageTimer::finish(const std::size_t bytes)
+{
+  if (!profiler_ && !histograms_)
+    return;
+
+  const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start_).count();
+
+  if (histograms_)
+    histograms_->record(LatencyStage::PROCESSING, nanoseconds);
+
+  if (profiler_)
+    profiler_->add(FrameStage::TOTAL, nanoseconds, thread_cpu_time() - start_cpu_, bytes, thread_allocations().value_or(0) - start_allocations_);
+}
+
+double
+calibrate_machine()
+{
+  // larger than the last level cache of the usual targets, like a frame
+  std::vector<uint8_t> src(std::size_t(8) << 20);
+  std::vector<uint8_t> dst(src.size());
+
+  for (std::size_t i = 0; i < src.size(); i++) {
+    src[i] = uint8_t((i * 2654435761u) >> 24);
+  }
+
+  double best = std::numeric_limits<double>::max();
+
+  // the fastest of several runs is the least disturbed by the rest of the system
+  for (int run = 0; run < 10; run++) {
+    const uint64_t start = thread_cpu_time();
+
+    // weighted sum of neighbouring bytes, the shape of a pixel format conversion
+    for (std::size_t i = 0; i + 3 < src.size(); i += 3) {
+      const unsigned int y = (77u * src[i] + 150u * src[i + 1] + 29u * src[i + 2]) >> 8;
+      dst[i]               = uint8_t(y);
+      dst[i + 1]           = uint8_t(y ^ src[i + 1]);
+      dst[i + 2]           = uint8_t(y + src[i + 2]);
+    }
+    std::copy(dst.begin(), dst.end(), src.begin());
+
+    // CPU time like the stages the baselines are scaled for
+    best = std::min(best, 1e-6 * (thread_cpu_time() - start));
+  }
+
+  // keeps the workload from being optimized away
+  volatile uint8_t sink = src[src.size() / 2];
+  (void)sink;
+
+  return best;
+}
+
+void
+save_baseline(const std::string &path, const PerformanceBaseline &baseline, const std::string &comment)
+{
+  std::ofstream file(path, std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("failed to open \"" + path + "\"");
+
+  file << "# " << comment << "\n";
+  file << "profiling:\n";
+  file << "  baseline:\n";
+  file << "    calibration: " << baseline.calibration << " # [ms]\n";
+
+  for (std::size_t i = 0; i < frame_stage_count; i++) {
+    if (baseline.ms_per_frame[i] > 0.0)
+      file << "    " << to_string(FrameStage(i)) << ": " << baseline.ms_per_frame[i] << " # [ms/frame] CPU time\n";
+  }
+
+  if (!file)
+    throw std::runtime_error("failed to write \"" + path + "\"");
+}
@@ -0,0 +1,289 @@
+#include <libcamera_ros_driver/utils/frame_recorder.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+
+FrameRecorder::FrameRecorder(std::size_t frame_bytes, unsigned int slots)
+    : frame_bytes_(frame_bytes), record_size_(capture_align(sizeof(FrameRecordHeader) + frame_bytes))
+{
+  // at least double buffering, one slot is filled while the other one is written
+  for (unsigned int i = 0; i < std::max(slots, 2u); i++) {
+    uint8_t *buffer = static_cast<uint8_t *>(std::aligned_alloc(capture_alignment, record_size_));
+    if (!buffer)
+      throw std::runtime_error("failed to allocate recorder slots");
+    std::memset(buffer, 0, record_size_);
+    buffers_.push_back(buffer);
+  }
+  free_ = buffers_;
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  stop();
+
+  for (uint8_t *buffer : buffers_)
+    std::free(buffer);
+}
+
+void
+FrameRecorder::start(const std::string &path, const CaptureFileHeader &header, const std::vector<uint8_t> &camera_info)
+{
+  if (recording_)
+    throw std::runtime_error("recorder is already running");
+
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  if (fd_ < 0 && errno == EINVAL) {
+    // file systems like tmpfs do not support direct I/O, the aligned slots still avoid extra copies
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ < 0)
+    throw std::runtime_error("failed to open \"" + path + "\": " + std::strerror(errno));
+
+  // the header block is written synchronously, O_DIRECT needs it in an aligned buffer
+  {
+    std::unique_ptr<uint8_t, decltype(&std::free)> block(static_cast<uint8_t *>(std::aligned_alloc(capture_alignment, capture_alignment)), &std::free);
+    std::memset(block.get(), 0, capture_alignment);
+
+    CaptureFileHeader file_header = header;
+    std::memcpy(file_header.magic, "LCRCAPT1", sizeof(file_header.magic));
+    file_header.version            = capture_version;
+    file_header.header_size        = capture_alignment;
+    file_header.record_size        = record_size_;
+    file_header.frame_bytes        = frame_bytes_;
+    file_header.camera_info_offset = sizeof(CaptureFileHeader);
+    file_header.camera_info_size   = 0;
+
+    // the camera info is skipped if it does not fit into the header block
+    if (camera_info.size() <= capture_alignment - sizeof(CaptureFileHeader)) {
+      file_header.camera_info_size = camera_info.size();
+      std::memcpy(block.get() + file_header.camera_info_offset, camera_info.data(), camera_info.size());
+    }
+
+    std::memcpy(block.get(), &file_header, sizeof(file_header));
+
+    if (pwrite(fd_, block.get(), capture_alignment, 0) != ssize_t(capture_alignment)) {
+      const std::string error = std::strerror(errno);
+      close(fd_);
+      fd_ = -1;
+      throw std::runtime_error("failed to write the header of \"" + path + "\": " + error);
+    }
+  }
+
+  written_ = 0;
+  dropped_ = 0;
+  failed_  = 0;
+  index_.clear();
+
+  {
+    // a frame pushed while the previous recording was stopping is discarded
+    std::scoped_lock lock(mutex_);
+    for (const slot_t &slot : filled_)
+      free_.push_back(slot.data);
+    filled_.clear();
+    stop_ = false;
+  }
+
+  thread_    = std::thread(&FrameRecorder::writer, this);
+  recording_ = true;
+}
+
+void
+FrameRecorder::stop()
+{
+  if (!recording_)
+    return;
+
+  recording_ = false;
+
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  filled_cv_.notify_one();
+
+  thread_.join();
+
+  close(fd_);
+  fd_ = -1;
+}
+
+bool
+FrameRecorder::push(const uint8_t *data, std::size_t size, const FrameRecordHeader &header)
+{
+  if (!recording_)
+    return false;
+
+  uint8_t *buffer;
+
+  {
+    std::scoped_lock lock(mutex_);
+    if (free_.empty()) {
+      dropped_++;
+      return false;
+    }
+    buffer = free_.back();
+    free_.pop_back();
+  }
+
+  size = std::min(size, frame_bytes_);
+
+  FrameRecordHeader record_header = header;
+  std::memcpy(record_header.magic, "LCRFRAME", sizeof(record_header.magic));
+  record_header.bytesused = uint32_t(size);
+
+  std::memcpy(buffer, &record_header, sizeof(record_header));
+  std::memcpy(buffer + sizeof(record_header), data, size);
+
+  {
+    std::scoped_lock lock(mutex_);
+    filled_.push_back({buffer, record_size_});
+  }
+  filled_cv_.notify_one();
+
+  return true;
+}
+
+// the writer owns a slot between taking it from the filled queue and returning it to the free ones
+static FrameRecordHeader &
+record_header(uint8_t *slot)
+{
+  return *reinterpret_cast<FrameRecordHeader *>(slot);
+}
+
+void
+FrameRecorder::writer()
+{
+  off_t    offset  = capture_alignment;
+  uint64_t records = 0;
+
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+
+  // io_uring may be disabled by the kernel, blocking writes are used then
+  if (io_uring_queue_init(buffers_.size(), &ring, 0) == 0) {
+
+    unsigned int inflight = 0;
+
+    while (true) {
+      std::deque<slot_t> filled;
+
+      {
+        std::unique_lock lock(mutex_);
+        filled_cv_.wait(lock, [&] { return !filled_.empty() || stop_ || inflight > 0; });
+        if (filled_.empty() && stop_ && inflight == 0)
+          break;
+        filled.swap(filled_);
+      }
+
+      // queue every filled slot at consecutive file offsets, there is one submission entry per slot
+      for (const slot_t &slot : filled) {
+        record_header(slot.data).record = records++;
+
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_write(sqe, fd_, slot.data, slot.length, offset);
+        io_uring_sqe_set_data(sqe, slot.data);
+        offset += slot.length;
+        inflight++;
+      }
+
+      if (!filled.empty())
+        io_uring_submit(&ring);
+
+      if (inflight == 0)
+        continue;
+
+      // wait for at least one write and return all finished slots
+      struct io_uring_cqe *cqe;
+      if (io_uring_wait_cqe(&ring, &cqe) < 0)
+        continue;
+
+      do {
+        uint8_t *buffer = static_cast<uint8_t *>(io_uring_cqe_get_data(cqe));
+        if (cqe->res == int(record_size_)) {
+          const FrameRecordHeader &h = record_header(buffer);
+          index_.push_back({h.sequence, h.timestamp, h.record});
+          written_++;
+        } else {
+          failed_++;
+        }
+        io_uring_cqe_seen(&ring, cqe);
+        inflight--;
+
+        std::scoped_lock lock(mutex_);
+        free_.push_back(buffer);
+      } while (inflight > 0 && io_uring_peek_cqe(&ring, &cqe) == 0);
+    }
+
+    io_uring_queue_exit(&ring);
+    writeIndex(records);
+    return;
+  }
+#endif
+
+  while (true) {
+    slot_t slot;
+
+    {
+      std::unique_lock lock(mutex_);
+      filled_cv_.wait(lock, [&] { return !filled_.empty() || stop_; });
+      if (filled_.empty())
+        break;
+      slot = filled_.front();
+      filled_.pop_front();
+    }
+
+    FrameRecordHeader &h = record_header(slot.data);
+    h.record             = records++;
+
+    if (pwrite(fd_, slot.data, slot.length, offset) == ssize_t(slot.length)) {
+      index_.push_back({h.sequence, h.timestamp, h.record});
+      written_++;
+    } else {
+      failed_++;
+    }
+    offset += slot.length;
+
+    std::scoped_lock lock(mutex_);
+    free_.push_back(slot.data);
+  }
+
+  writeIndex(records);
+}
+
+void
+FrameRecorder::writeIndex(uint64_t records)
+{
+  // writes may complete out of order
+  std::sort(index_.begin(), index_.end(), [](const CaptureIndexEntry &a, const CaptureIndexEntry &b) { return a.sequence < b.sequence; });
+
+  const std::size_t index_bytes = index_.size() * sizeof(CaptureIndexEntry);
+  const std::size_t block_size  = capture_align(index_bytes + sizeof(CaptureFileFooter));
+
+  std::unique_ptr<uint8_t, decltype(&std::free)> block(static_cast<uint8_t *>(std::aligned_alloc(capture_alignment, block_size)), &std::free);
+  if (!block) {
+    failed_++;
+    return;
+  }
+  std::memset(block.get(), 0, block_size);
+
+  CaptureFileFooter footer = {};
+  std::memcpy(footer.magic, "LCRINDEX", sizeof(footer.magic));
+  footer.index_offset = capture_alignment + records * record_size_;
+  footer.count        = index_.size();
+
+  // the footer takes the last bytes of the file so that a reader can find it from the file size
+  std::memcpy(block.get(), index_.data(), index_bytes);
+  std::memcpy(block.get() + block_size - sizeof(footer), &footer, sizeof(footer));
+
+  if (pwrite(fd_, block.get(), block_size, footer.index_offset) != ssize_t(block_size))
+    failed_++;
+}
@@ -0,0 +1,140 @@
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+
+static bool
+cpu_supports(const KernelBackend backend)
+{
+  switch (backend) {
+    case KernelBackend::SCALAR:
+      return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case KernelBackend::SSE4:
+      return __builtin_cpu_supports("sse4.1");
+    case KernelBackend::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#if defined(__aarch64__)
+    case KernelBackend::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+const Kernels *
+kernels_for(const KernelBackend backend)
+{
+  switch (backend) {
+    case KernelBackend::SCALAR:
+      return kernels_scalar();
+    case KernelBackend::SSE4:
+      return kernels_sse4();
+    case KernelBackend::AVX2:
+      return kernels_avx2();
+    case KernelBackend::NEON:
+      return kernels_neon();
+  }
+
+  return nullptr;
+}
+
+std::string
+to_string(const KernelBackend backend)
+{
+  switch (backend) {
+    case KernelBackend::SCALAR:
+      return "scalar";
+    case KernelBackend::SSE4:
+      return "sse4";
+    case KernelBackend::AVX2:
+      return "avx2";
+    case KernelBackend::NEON:
+      return "neon";
+  }
+
+  return {};
+}
+
+std::vector<KernelBackend>
+available_kernel_backends()
+{
+  std::vector<KernelBackend> backends;
+  for (const KernelBackend backend : {KernelBackend::SCALAR, KernelBackend::SSE4, KernelBackend::AVX2, KernelBackend::NEON}) {
+    if (kernels_for(backend) && cpu_supports(backend))
+      backends.push_back(backend);
+  }
+  return backends;
+}
+
+/* selection //{ */
+
+static std::atomic<const Kernels *> active_kernels{nullptr};
+static std::mutex                   select_mutex;
+
+static const Kernels *
+select_best()
+{
+  // widest instruction set first
+  for (const KernelBackend backend : {KernelBackend::AVX2, KernelBackend::SSE4, KernelBackend::NEON}) {
+    const Kernels *k = kernels_for(backend);
+    if (k && cpu_supports(backend))
+      return k;
+  }
+
+  return kernels_scalar();
+}
+
+const Kernels &
+kernels()
+{
+  const Kernels *k = active_kernels.load(std::memory_order_acquire);
+
+  if (!k) {
+    std::scoped_lock lock(select_mutex);
+    k = active_kernels.load(std::memory_order_relaxed);
+    if (!k) {
+      k = select_best();
+      active_kernels.store(k, std::memory_order_release);
+    }
+  }
+
+  return *k;
+}
+
+void
+select_kernel_backend(const std::string &name)
+{
+  static const std::unordered_map<std::string, KernelBackend> backends_map = {
+    {"scalar", KernelBackend::SCALAR},
+    {"sse4", KernelBackend::SSE4},
+    {"avx2", KernelBackend::AVX2},
+    {"neon", KernelBackend::NEON},
+  };
+
+  std::scoped_lock lock(select_mutex);
+
+  if (name == "auto") {
+    active_kernels.store(select_best(), std::memory_order_release);
+    return;
+  }
+
+  if (!backends_map.count(name))
+    throw std::runtime_error("invalid kernel backend: \"" + name + "\"");
+
+  const KernelBackend backend = backends_map.at(name);
+  const Kernels *     k       = kernels_for(backend);
+
+  if (!k)
+    throw std::runtime_error("kernel backend \"" + name + "\" is not compiled for this architecture");
+  if (!cpu_supports(backend))
+    throw std::runtime_error("kernel backend \"" + name + "\" is not supported by this CPU");
+
+  active_kernels.store(k, std::memory_order_release);
+}
+
+//}
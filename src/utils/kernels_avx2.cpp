@@ -0,0 +1,249 @@
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// compiled with -mavx2 -mfma, only called after the CPU support of both has been checked
+
+static void
+subtract_row_u8(const uint8_t *src, uint8_t *dst, unsigned int width, uint8_t level_even, uint8_t level_odd)
+{
+  const __m256i level = _mm256_set1_epi16(int16_t(level_even | (level_odd << 8)));
+
+  unsigned int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_subs_epu8(v, level));
+  }
+
+  kernels_scalar()->subtract_row_u8(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static void
+subtract_row_u16(const uint16_t *src, uint16_t *dst, unsigned int width, uint16_t level_even, uint16_t level_odd)
+{
+  const __m256i level = _mm256_set1_epi32(int32_t(level_even | (uint32_t(level_odd) << 16)));
+
+  unsigned int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_subs_epu16(v, level));
+  }
+
+  kernels_scalar()->subtract_row_u16(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static inline __m256i
+blend_u16(const __m256i cur, const __m256i prev, const __m256i diff, const __m256i strength, const __m256i slope)
+{
+  const __m256i drop   = _mm256_srli_epi16(_mm256_mullo_epi16(diff, slope), 4);
+  const __m256i weight = _mm256_subs_epu16(strength, drop);
+  const __m256i sum    = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(cur, _mm256_sub_epi16(_mm256_set1_epi16(256), weight)), _mm256_mullo_epi16(prev, weight)),
+                                    _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(sum, 8);
+}
+
+static void
+blend_row_u8(const uint8_t *src, uint8_t *dst, uint8_t *history, unsigned int n, uint8_t strength, uint8_t threshold, uint16_t slope)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i thr  = _mm256_set1_epi8(int8_t(threshold));
+  const __m256i str  = _mm256_set1_epi16(strength);
+  const __m256i slp  = _mm256_set1_epi16(int16_t(slope));
+
+  unsigned int x = 0;
+  for (; x + 32 <= n; x += 32) {
+    const __m256i cur  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+    const __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(history + x));
+    const __m256i diff = _mm256_min_epu8(_mm256_or_si256(_mm256_subs_epu8(cur, prev), _mm256_subs_epu8(prev, cur)), thr);
+
+    const __m256i lo = blend_u16(_mm256_unpacklo_epi8(cur, zero), _mm256_unpacklo_epi8(prev, zero), _mm256_unpacklo_epi8(diff, zero), str, slp);
+    const __m256i hi = blend_u16(_mm256_unpackhi_epi8(cur, zero), _mm256_unpackhi_epi8(prev, zero), _mm256_unpackhi_epi8(diff, zero), str, slp);
+    const __m256i out = _mm256_packus_epi16(lo, hi);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), out);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(history + x), out);
+  }
+
+  kernels_scalar()->blend_row_u8(src + x, dst + x, history + x, n - x, strength, threshold, slope);
+}
+
+// channel 'channel' of the entries at 'offset' of 8 vertices, the table is padded for the 32-bit read of the last one
+static inline __m256i
+lut_channel(const uint16_t *table, const __m256i offset, const int channel)
+{
+  const __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int *>(table + channel), offset, 2);
+  return _mm256_and_si256(v, _mm256_set1_epi32(0xffff));
+}
+
+static inline __m256i
+lut_sum(const uint16_t *table, const int channel, const __m256i c000, const __m256i c1, const __m256i c2, const __m256i c111, const __m256i w0,
+        const __m256i w1, const __m256i w2, const __m256i w3)
+{
+  __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(lut_channel(table, c000, channel), w0), _mm256_set1_epi32(1 << 15));
+  sum         = _mm256_add_epi32(sum, _mm256_mullo_epi32(lut_channel(table, c1, channel), w1));
+  sum         = _mm256_add_epi32(sum, _mm256_mullo_epi32(lut_channel(table, c2, channel), w2));
+  sum         = _mm256_add_epi32(sum, _mm256_mullo_epi32(lut_channel(table, c111, channel), w3));
+  return _mm256_srli_epi32(sum, 16);
+}
+
+// 8 pixels per iteration, one pixel per lane; the tetrahedron is selected without branches, its first step goes
+// along the axis of the largest weight and its second one away from the axis of the smallest weight, ties select
+// vertices whose weight is 0 and give the same result as the scalar reference
+static void
+apply_lut_row(const ColorLut3D &lut, const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int channels, bool bgr)
+{
+  const int       ri    = bgr ? 2 : 0;
+  const int       bi    = bgr ? 0 : 2;
+  const uint16_t *table = lut.table.data();
+
+  const __m256i sr    = _mm256_set1_epi32(3);
+  const __m256i sg    = _mm256_set1_epi32(3 * lut.size);
+  const __m256i sb    = _mm256_set1_epi32(3 * lut.size * lut.size);
+  const __m256i diag  = _mm256_set1_epi32(3 + 3 * lut.size + 3 * lut.size * lut.size);
+  const __m256i full  = _mm256_set1_epi32(256);
+  const __m256i bytes = _mm256_set1_epi32(0xff);
+  const __m256i ones  = _mm256_set1_epi32(-1);
+  const __m256i pixel = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channels));
+
+  // the three output bytes of every pixel are moved to the low 12 bytes of each half
+  const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+  // the 32-bit gathers of the samples read up to 3 bytes past the last pixel, which the 9th pixel covers
+  unsigned int x = 0;
+  for (; x + 9 <= width; x += 8) {
+    const uint8_t *s = src + std::size_t(x) * channels;
+    uint8_t *      d = dst + std::size_t(x) * channels;
+
+    const __m256i r = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(s + ri), pixel, 1), bytes);
+    const __m256i g = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(s + 1), pixel, 1), bytes);
+    const __m256i b = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(s + bi), pixel, 1), bytes);
+
+    const __m256i fr = _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.weight.data()), r, 4);
+    const __m256i fg = _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.weight.data()), g, 4);
+    const __m256i fb = _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.weight.data()), b, 4);
+
+    const __m256i c000 = _mm256_add_epi32(_mm256_add_epi32(_mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.offset_r.data()), r, 4),
+                                                           _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.offset_g.data()), g, 4)),
+                                          _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.offset_b.data()), b, 4));
+
+    // the weights are in [0, 256], the signed comparisons are exact
+    const __m256i g_gt_r = _mm256_cmpgt_epi32(fg, fr);
+    const __m256i b_gt_r = _mm256_cmpgt_epi32(fb, fr);
+    const __m256i b_gt_g = _mm256_cmpgt_epi32(fb, fg);
+    const __m256i r_gt_g = _mm256_cmpgt_epi32(fr, fg);
+    const __m256i r_gt_b = _mm256_cmpgt_epi32(fr, fb);
+    const __m256i g_gt_b = _mm256_cmpgt_epi32(fg, fb);
+
+    // stride of the axis of the largest weight: red if it is not exceeded, else green if blue does not exceed it
+    const __m256i r_max = _mm256_andnot_si256(_mm256_or_si256(g_gt_r, b_gt_r), ones);
+    const __m256i s_max = _mm256_blendv_epi8(_mm256_blendv_epi8(sb, sg, _mm256_andnot_si256(b_gt_g, ones)), sr, r_max);
+
+    // stride of the axis of the smallest weight, chosen the same way
+    const __m256i r_min = _mm256_andnot_si256(_mm256_or_si256(r_gt_g, r_gt_b), ones);
+    const __m256i s_min = _mm256_blendv_epi8(_mm256_blendv_epi8(sb, sg, _mm256_andnot_si256(g_gt_b, ones)), sr, r_min);
+
+    const __m256i f_max = _mm256_max_epi32(fr, _mm256_max_epi32(fg, fb));
+    const __m256i f_min = _mm256_min_epi32(fr, _mm256_min_epi32(fg, fb));
+    const __m256i f_mid = _mm256_sub_epi32(_mm256_add_epi32(fr, _mm256_add_epi32(fg, fb)), _mm256_add_epi32(f_max, f_min));
+
+    const __m256i w0 = _mm256_sub_epi32(full, f_max);
+    const __m256i w1 = _mm256_sub_epi32(f_max, f_mid);
+    const __m256i w2 = _mm256_sub_epi32(f_mid, f_min);
+    const __m256i w3 = f_min;
+
+    const __m256i c1   = _mm256_add_epi32(c000, s_max);
+    const __m256i c111 = _mm256_add_epi32(c000, diag);
+    const __m256i c2   = _mm256_sub_epi32(c111, s_min);
+
+    const __m256i out_r = lut_sum(table, 0, c000, c1, c2, c111, w0, w1, w2, w3);
+    const __m256i out_g = lut_sum(table, 1, c000, c1, c2, c111, w0, w1, w2, w3);
+    const __m256i out_b = lut_sum(table, 2, c000, c1, c2, c111, w0, w1, w2, w3);
+
+    // one 32-bit word per pixel in memory order
+    const __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(out_r, 8 * ri), _mm256_slli_epi32(out_g, 8)), _mm256_slli_epi32(out_b, 8 * bi));
+
+    if (channels == 4) {
+      const __m256i alpha = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)), _mm256_set1_epi32(int(0xff000000)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), _mm256_or_si256(out, alpha));
+    } else {
+      // exactly 24 bytes are written, a wider store would overwrite the next pixels of an in-place conversion
+      const __m256i packed = _mm256_shuffle_epi8(out, pack);
+      const __m128i lo     = _mm256_castsi256_si128(packed);
+      const __m128i hi     = _mm256_extracti128_si256(packed, 1);
+      const int32_t lo_tail = _mm_extract_epi32(lo, 2);
+      const int32_t hi_tail = _mm_extract_epi32(hi, 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(d), lo);
+      std::memcpy(d + 8, &lo_tail, 4);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(d + 12), hi);
+      std::memcpy(d + 20, &hi_tail, 4);
+    }
+  }
+
+  kernels_scalar()->apply_lut_row(lut, src + std::size_t(x) * channels, dst + std::size_t(x) * channels, width - x, channels, bgr);
+}
+
+static void
+lerp_rows_u8(const uint8_t *row0, const uint8_t *row1, uint16_t *dst, unsigned int n, uint16_t weight)
+{
+  const __m256i w0 = _mm256_set1_epi16(int16_t(256 - weight));
+  const __m256i w1 = _mm256_set1_epi16(int16_t(weight));
+
+  // the weighted sum is at most 255 << 8, the 16-bit products do not overflow
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x)));
+    const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_add_epi16(_mm256_mullo_epi16(a, w0), _mm256_mullo_epi16(b, w1)));
+  }
+
+  kernels_scalar()->lerp_rows_u8(row0 + x, row1 + x, dst + x, n - x, weight);
+}
+
+static void
+accumulate_row_u8(const uint8_t *src, uint32_t *sums, unsigned int n)
+{
+  unsigned int x = 0;
+  for (; x + 8 <= n; x += 8) {
+    __m256i *     s = reinterpret_cast<__m256i *>(sums + x);
+    const __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)));
+    _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), v));
+  }
+
+  kernels_scalar()->accumulate_row_u8(src + x, sums + x, n - x);
+}
+
+static void
+normalize_row_f32(const uint16_t *src, float *dst, unsigned int n, const float *scale, const float *offset)
+{
+  unsigned int x = 0;
+  for (; x + 8 <= n; x += 8) {
+    const __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x))));
+    _mm256_storeu_ps(dst + x, _mm256_fmadd_ps(v, _mm256_loadu_ps(scale + x), _mm256_loadu_ps(offset + x)));
+  }
+
+  kernels_scalar()->normalize_row_f32(src + x, dst + x, n - x, scale + x, offset + x);
+}
+
+const Kernels *
+kernels_avx2()
+{
+  static const Kernels k = {
+    KernelBackend::AVX2, kernels_scalar()->copy_rows, subtract_row_u8, subtract_row_u16, blend_row_u8, apply_lut_row, lerp_rows_u8, accumulate_row_u8,
+    normalize_row_f32,
+  };
+  return &k;
+}
+
+#else
+
+const Kernels *
+kernels_avx2()
+{
+  return nullptr;
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+// Advanced SIMD is mandatory on AArch64, no runtime check is needed
+
+static void
+subtract_row_u8(const uint8_t *src, uint8_t *dst, unsigned int width, uint8_t level_even, uint8_t level_odd)
+{
+  const uint8x16_t level = vreinterpretq_u8_u16(vdupq_n_u16(uint16_t(level_even | (level_odd << 8))));
+
+  unsigned int x = 0;
+  for (; x + 16 <= width; x += 16)
+    vst1q_u8(dst + x, vqsubq_u8(vld1q_u8(src + x), level));
+
+  kernels_scalar()->subtract_row_u8(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static void
+subtract_row_u16(const uint16_t *src, uint16_t *dst, unsigned int width, uint16_t level_even, uint16_t level_odd)
+{
+  const uint16x8_t level = vreinterpretq_u16_u32(vdupq_n_u32(level_even | (uint32_t(level_odd) << 16)));
+
+  unsigned int x = 0;
+  for (; x + 8 <= width; x += 8)
+    vst1q_u16(dst + x, vqsubq_u16(vld1q_u16(src + x), level));
+
+  kernels_scalar()->subtract_row_u16(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static inline uint8x8_t
+blend_u16(const uint8x8_t cur, const uint8x8_t prev, const uint8x8_t diff, const uint16x8_t strength, const uint16x8_t slope)
+{
+  const uint16x8_t drop   = vshrq_n_u16(vmulq_u16(vmovl_u8(diff), slope), 4);
+  const uint16x8_t weight = vqsubq_u16(strength, drop);
+  uint16x8_t       sum    = vmulq_u16(vmovl_u8(cur), vsubq_u16(vdupq_n_u16(256), weight));
+  sum                     = vmlaq_u16(sum, vmovl_u8(prev), weight);
+  return vmovn_u16(vshrq_n_u16(vaddq_u16(sum, vdupq_n_u16(128)), 8));
+}
+
+static void
+blend_row_u8(const uint8_t *src, uint8_t *dst, uint8_t *history, unsigned int n, uint8_t strength, uint8_t threshold, uint16_t slope)
+{
+  const uint8x16_t thr = vdupq_n_u8(threshold);
+  const uint16x8_t str = vdupq_n_u16(strength);
+  const uint16x8_t slp = vdupq_n_u16(slope);
+
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const uint8x16_t cur  = vld1q_u8(src + x);
+    const uint8x16_t prev = vld1q_u8(history + x);
+    const uint8x16_t diff = vminq_u8(vabdq_u8(cur, prev), thr);
+
+    const uint8x16_t out = vcombine_u8(blend_u16(vget_low_u8(cur), vget_low_u8(prev), vget_low_u8(diff), str, slp),
+                                       blend_u16(vget_high_u8(cur), vget_high_u8(prev), vget_high_u8(diff), str, slp));
+
+    vst1q_u8(dst + x, out);
+    vst1q_u8(history + x, out);
+  }
+
+  kernels_scalar()->blend_row_u8(src + x, dst + x, history + x, n - x, strength, threshold, slope);
+}
+
+static void
+apply_lut_row(const ColorLut3D &lut, const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int channels, bool bgr)
+{
+  const unsigned int ri    = bgr ? 2 : 0;
+  const unsigned int bi    = bgr ? 0 : 2;
+  const uint16_t *   table = lut.table.data();
+
+  // the three channels of a pixel are interpolated together, a 64-bit load reads the entry of a vertex and one
+  // element past it, the table is padded for the last one
+  for (unsigned int x = 0; x < width; x++, src += channels, dst += channels) {
+    const LutTetrahedron t = lut_tetrahedron(lut, src[ri], src[1], src[bi]);
+
+    uint32x4_t sum = vmull_n_u16(vld1_u16(table + t.c000), uint16_t(t.w0));
+    sum            = vmlal_n_u16(sum, vld1_u16(table + t.c1), uint16_t(t.w1));
+    sum            = vmlal_n_u16(sum, vld1_u16(table + t.c2), uint16_t(t.w2));
+    sum            = vmlal_n_u16(sum, vld1_u16(table + t.c111), uint16_t(t.w3));
+
+    // rounding narrowing shift, same as adding 1 << 15 before the shift
+    const uint16x4_t out = vrshrn_n_u32(sum, 16);
+
+    dst[ri] = uint8_t(vget_lane_u16(out, 0));
+    dst[1]  = uint8_t(vget_lane_u16(out, 1));
+    dst[bi] = uint8_t(vget_lane_u16(out, 2));
+    if (channels == 4)
+      dst[3] = src[3];
+  }
+}
+
+static void
+lerp_rows_u8(const uint8_t *row0, const uint8_t *row1, uint16_t *dst, unsigned int n, uint16_t weight)
+{
+  const uint16_t w0 = uint16_t(256 - weight);
+
+  // the weighted sum is at most 255 << 8, the 16-bit products do not overflow
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const uint8x16_t a = vld1q_u8(row0 + x);
+    const uint8x16_t b = vld1q_u8(row1 + x);
+    vst1q_u16(dst + x, vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(a)), w0), vmovl_u8(vget_low_u8(b)), weight));
+    vst1q_u16(dst + x + 8, vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(a)), w0), vmovl_u8(vget_high_u8(b)), weight));
+  }
+
+  kernels_scalar()->lerp_rows_u8(row0 + x, row1 + x, dst + x, n - x, weight);
+}
+
+static void
+accumulate_row_u8(const uint8_t *src, uint32_t *sums, unsigned int n)
+{
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const uint8x16_t v  = vld1q_u8(src + x);
+    const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_u32(sums + x, vaddw_u16(vld1q_u32(sums + x), vget_low_u16(lo)));
+    vst1q_u32(sums + x + 4, vaddw_u16(vld1q_u32(sums + x + 4), vget_high_u16(lo)));
+    vst1q_u32(sums + x + 8, vaddw_u16(vld1q_u32(sums + x + 8), vget_low_u16(hi)));
+    vst1q_u32(sums + x + 12, vaddw_u16(vld1q_u32(sums + x + 12), vget_high_u16(hi)));
+  }
+
+  kernels_scalar()->accumulate_row_u8(src + x, sums + x, n - x);
+}
+
+static void
+normalize_row_f32(const uint16_t *src, float *dst, unsigned int n, const float *scale, const float *offset)
+{
+  // vfmaq_f32 is fused like the std::fma of the reference
+  unsigned int x = 0;
+  for (; x + 4 <= n; x += 4) {
+    const float32x4_t v = vcvtq_f32_u32(vmovl_u16(vld1_u16(src + x)));
+    vst1q_f32(dst + x, vfmaq_f32(vld1q_f32(offset + x), v, vld1q_f32(scale + x)));
+  }
+
+  kernels_scalar()->normalize_row_f32(src + x, dst + x, n - x, scale + x, offset + x);
+}
+
+const Kernels *
+kernels_neon()
+{
+  static const Kernels k = {
+    KernelBackend::NEON, kernels_scalar()->copy_rows, subtract_row_u8, subtract_row_u16, blend_row_u8, apply_lut_row, lerp_rows_u8, accumulate_row_u8,
+    normalize_row_f32,
+  };
+  return &k;
+}
+
+#else
+
+const Kernels *
+kernels_neon()
+{
+  return nullptr;
+}
+
+#endif
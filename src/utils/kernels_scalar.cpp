@@ -0,0 +1,111 @@
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+static void
+copy_rows(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, std::size_t row_bytes, unsigned int height)
+{
+  if (src_step == row_bytes && dst_step == row_bytes) {
+    std::memcpy(dst, src, row_bytes * height);
+    return;
+  }
+
+  for (unsigned int y = 0; y < height; y++)
+    std::memcpy(dst + y * dst_step, src + y * src_step, row_bytes);
+}
+
+template <typename T>
+static void
+subtract_row(const T *src, T *dst, const unsigned int width, const T level_even, const T level_odd)
+{
+  for (unsigned int x = 0; x < width; x++) {
+    const T level = (x & 1) ? level_odd : level_even;
+    dst[x]        = src[x] > level ? T(src[x] - level) : T(0);
+  }
+}
+
+static void
+subtract_row_u8(const uint8_t *src, uint8_t *dst, unsigned int width, uint8_t level_even, uint8_t level_odd)
+{
+  subtract_row<uint8_t>(src, dst, width, level_even, level_odd);
+}
+
+static void
+subtract_row_u16(const uint16_t *src, uint16_t *dst, unsigned int width, uint16_t level_even, uint16_t level_odd)
+{
+  subtract_row<uint16_t>(src, dst, width, level_even, level_odd);
+}
+
+static void
+blend_row_u8(const uint8_t *src, uint8_t *dst, uint8_t *history, unsigned int n, uint8_t strength, uint8_t threshold, uint16_t slope)
+{
+  for (unsigned int x = 0; x < n; x++) {
+    const uint16_t cur  = src[x];
+    const uint16_t prev = history[x];
+
+    // the weight falls linearly from 'strength' for static samples to 0 at the motion threshold
+    const uint16_t diff   = std::min<uint16_t>(cur > prev ? cur - prev : prev - cur, threshold);
+    const uint16_t drop   = uint16_t(diff * slope) >> 4;
+    const uint16_t weight = drop < strength ? strength - drop : 0;
+
+    const uint8_t out = uint8_t(uint16_t(cur * (256 - weight) + prev * weight + 128) >> 8);
+    dst[x]            = out;
+    history[x]        = out;
+  }
+}
+
+static void
+apply_lut_row(const ColorLut3D &lut, const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int channels, bool bgr)
+{
+  const unsigned int ri = bgr ? 2 : 0;
+  const unsigned int bi = bgr ? 0 : 2;
+
+  for (unsigned int x = 0; x < width; x++, src += channels, dst += channels) {
+    const LutTetrahedron t = lut_tetrahedron(lut, src[ri], src[1], src[bi]);
+    const uint16_t *     c = lut.table.data();
+
+    // weights sum up to 256 and table values are scaled by 256, round away the 16 fractional bits
+    const uint8_t r = (t.w0 * c[t.c000] + t.w1 * c[t.c1] + t.w2 * c[t.c2] + t.w3 * c[t.c111] + (1 << 15)) >> 16;
+    const uint8_t g = (t.w0 * c[t.c000 + 1] + t.w1 * c[t.c1 + 1] + t.w2 * c[t.c2 + 1] + t.w3 * c[t.c111 + 1] + (1 << 15)) >> 16;
+    const uint8_t b = (t.w0 * c[t.c000 + 2] + t.w1 * c[t.c1 + 2] + t.w2 * c[t.c2 + 2] + t.w3 * c[t.c111 + 2] + (1 << 15)) >> 16;
+
+    dst[ri] = r;
+    dst[1]  = g;
+    dst[bi] = b;
+    if (channels == 4)
+      dst[3] = src[3];
+  }
+}
+
+static void
+lerp_rows_u8(const uint8_t *row0, const uint8_t *row1, uint16_t *dst, unsigned int n, uint16_t weight)
+{
+  for (unsigned int x = 0; x < n; x++)
+    dst[x] = uint16_t(row0[x] * (256 - weight) + row1[x] * weight);
+}
+
+static void
+accumulate_row_u8(const uint8_t *src, uint32_t *sums, unsigned int n)
+{
+  for (unsigned int x = 0; x < n; x++)
+    sums[x] += src[x];
+}
+
+static void
+normalize_row_f32(const uint16_t *src, float *dst, unsigned int n, const float *scale, const float *offset)
+{
+  for (unsigned int x = 0; x < n; x++)
+    dst[x] = std::fma(float(src[x]), scale[x], offset[x]);
+}
+
+const Kernels *
+kernels_scalar()
+{
+  static const Kernels k = {
+    KernelBackend::SCALAR, copy_rows, subtract_row_u8, subtract_row_u16, blend_row_u8, apply_lut_row, lerp_rows_u8, accumulate_row_u8, normalize_row_f32,
+  };
+  return &k;
+}
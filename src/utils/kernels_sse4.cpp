@@ -0,0 +1,171 @@
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <smmintrin.h>
+
+// compiled with -msse4.1, only called after the CPU support has been checked
+
+static void
+subtract_row_u8(const uint8_t *src, uint8_t *dst, unsigned int width, uint8_t level_even, uint8_t level_odd)
+{
+  const __m128i level = _mm_set1_epi16(int16_t(level_even | (level_odd << 8)));
+
+  unsigned int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_subs_epu8(v, level));
+  }
+
+  kernels_scalar()->subtract_row_u8(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static void
+subtract_row_u16(const uint16_t *src, uint16_t *dst, unsigned int width, uint16_t level_even, uint16_t level_odd)
+{
+  const __m128i level = _mm_set1_epi32(int32_t(level_even | (uint32_t(level_odd) << 16)));
+
+  unsigned int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_subs_epu16(v, level));
+  }
+
+  kernels_scalar()->subtract_row_u16(src + x, dst + x, width - x, level_even, level_odd);
+}
+
+static inline __m128i
+blend_u16(const __m128i cur, const __m128i prev, const __m128i diff, const __m128i strength, const __m128i slope)
+{
+  const __m128i drop   = _mm_srli_epi16(_mm_mullo_epi16(diff, slope), 4);
+  const __m128i weight = _mm_subs_epu16(strength, drop);
+  const __m128i sum    = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(cur, _mm_sub_epi16(_mm_set1_epi16(256), weight)), _mm_mullo_epi16(prev, weight)),
+                                    _mm_set1_epi16(128));
+  return _mm_srli_epi16(sum, 8);
+}
+
+static void
+blend_row_u8(const uint8_t *src, uint8_t *dst, uint8_t *history, unsigned int n, uint8_t strength, uint8_t threshold, uint16_t slope)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i thr  = _mm_set1_epi8(int8_t(threshold));
+  const __m128i str  = _mm_set1_epi16(strength);
+  const __m128i slp  = _mm_set1_epi16(int16_t(slope));
+
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const __m128i cur  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    const __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(history + x));
+    const __m128i diff = _mm_min_epu8(_mm_or_si128(_mm_subs_epu8(cur, prev), _mm_subs_epu8(prev, cur)), thr);
+
+    const __m128i lo = blend_u16(_mm_unpacklo_epi8(cur, zero), _mm_unpacklo_epi8(prev, zero), _mm_unpacklo_epi8(diff, zero), str, slp);
+    const __m128i hi = blend_u16(_mm_unpackhi_epi8(cur, zero), _mm_unpackhi_epi8(prev, zero), _mm_unpackhi_epi8(diff, zero), str, slp);
+    const __m128i out = _mm_packus_epi16(lo, hi);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), out);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(history + x), out);
+  }
+
+  kernels_scalar()->blend_row_u8(src + x, dst + x, history + x, n - x, strength, threshold, slope);
+}
+
+static inline __m128i
+lut_entry(const uint16_t *entry)
+{
+  return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(entry)));
+}
+
+static void
+apply_lut_row(const ColorLut3D &lut, const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int channels, bool bgr)
+{
+  const unsigned int ri    = bgr ? 2 : 0;
+  const unsigned int bi    = bgr ? 0 : 2;
+  const uint16_t *   table = lut.table.data();
+  const __m128i      round = _mm_set1_epi32(1 << 15);
+
+  // the three channels of a pixel are interpolated together, a 64-bit load reads the entry of a vertex and one
+  // element past it, the table is padded for the last one
+  for (unsigned int x = 0; x < width; x++, src += channels, dst += channels) {
+    const LutTetrahedron t = lut_tetrahedron(lut, src[ri], src[1], src[bi]);
+
+    __m128i sum = _mm_add_epi32(_mm_mullo_epi32(lut_entry(table + t.c000), _mm_set1_epi32(t.w0)), round);
+    sum         = _mm_add_epi32(sum, _mm_mullo_epi32(lut_entry(table + t.c1), _mm_set1_epi32(t.w1)));
+    sum         = _mm_add_epi32(sum, _mm_mullo_epi32(lut_entry(table + t.c2), _mm_set1_epi32(t.w2)));
+    sum         = _mm_add_epi32(sum, _mm_mullo_epi32(lut_entry(table + t.c111), _mm_set1_epi32(t.w3)));
+
+    const __m128i out = _mm_srli_epi32(sum, 16);
+    const uint8_t r   = uint8_t(_mm_cvtsi128_si32(out));
+    const uint8_t g   = uint8_t(_mm_extract_epi32(out, 1));
+    const uint8_t b   = uint8_t(_mm_extract_epi32(out, 2));
+
+    dst[ri] = r;
+    dst[1]  = g;
+    dst[bi] = b;
+    if (channels == 4)
+      dst[3] = src[3];
+  }
+}
+
+static void
+lerp_rows_u8(const uint8_t *row0, const uint8_t *row1, uint16_t *dst, unsigned int n, uint16_t weight)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i w0   = _mm_set1_epi16(int16_t(256 - weight));
+  const __m128i w1   = _mm_set1_epi16(int16_t(weight));
+
+  // the weighted sum is at most 255 << 8, the 16-bit products do not overflow
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x));
+
+    const __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+    const __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 8), hi);
+  }
+
+  kernels_scalar()->lerp_rows_u8(row0 + x, row1 + x, dst + x, n - x, weight);
+}
+
+static void
+accumulate_row_u8(const uint8_t *src, uint32_t *sums, unsigned int n)
+{
+  unsigned int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    const __m128i w[4] = {_mm_cvtepu8_epi32(v), _mm_cvtepu8_epi32(_mm_srli_si128(v, 4)), _mm_cvtepu8_epi32(_mm_srli_si128(v, 8)),
+                          _mm_cvtepu8_epi32(_mm_srli_si128(v, 12))};
+
+    for (int i = 0; i < 4; i++) {
+      __m128i *s = reinterpret_cast<__m128i *>(sums + x + 4 * i);
+      _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), w[i]));
+    }
+  }
+
+  kernels_scalar()->accumulate_row_u8(src + x, sums + x, n - x);
+}
+
+const Kernels *
+kernels_sse4()
+{
+  // plain row copies are memory bound, the libc memcpy already uses the widest available stores; SSE4 has no fused
+  // multiply-add, a separate multiply and add would round differently from the reference
+  static const Kernels k = {
+    KernelBackend::SSE4, kernels_scalar()->copy_rows, subtract_row_u8, subtract_row_u16, blend_row_u8, apply_lut_row, lerp_rows_u8, accumulate_row_u8,
+    kernels_scalar()->normalize_row_f32,
+  };
+  return &k;
+}
+
+#else
+
+const Kernels *
+kernels_sse4()
+{
+  return nullptr;
+}
+
+#endif
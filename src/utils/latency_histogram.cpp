@@ -0,0 +1,112 @@
+#include <libcamera_ros_driver/utils/latency_histogram.h>
+#include <algorithm>
+
+
+std::string
+to_string(const LatencyStage stage)
+{
+  switch (stage) {
+    case LatencyStage::RECORD:
+      return "record";
+    case LatencyStage::CONVERT:
+      return "convert";
+    case LatencyStage::DENOISE:
+      return "denoise";
+    case LatencyStage::CAMERA_INFO:
+      return "camera_info";
+    case LatencyStage::PUBLISH:
+      return "publish";
+    case LatencyStage::PROCESSING:
+      return "processing";
+    case LatencyStage::SENSOR_TO_CALLBACK:
+      return "sensor_to_callback";
+    case LatencyStage::END_TO_END:
+      return "end_to_end";
+    case LatencyStage::REQUEUE:
+      return "requeue";
+  }
+
+  return {};
+}
+
+std::size_t
+LatencyHistogram::bucketIndex(const uint64_t value)
+{
+  // values below 2^sub_bucket_bits have a bucket each, above every power of two is split evenly
+  if (value < (uint64_t(1) << sub_bucket_bits))
+    return value;
+
+  // longer durations share the last bucket, the maximum is kept exactly
+  if (value >= (uint64_t(1) << max_bits))
+    return bucket_count - 1;
+
+  const unsigned int msb   = 63u - unsigned(__builtin_clzll(value));
+  const unsigned int shift = msb - sub_bucket_bits + 1;
+  return (std::size_t(shift) << sub_bucket_bits) | ((value >> (shift - 1)) & ((1u << sub_bucket_bits) - 1));
+}
+
+uint64_t
+LatencyHistogram::bucketValue(const std::size_t index)
+{
+  if (index < (std::size_t(1) << sub_bucket_bits))
+    return index;
+
+  // middle of the bucket
+  const unsigned int shift = unsigned(index >> sub_bucket_bits);
+  const uint64_t     sub   = index & ((1u << sub_bucket_bits) - 1);
+  const uint64_t     low   = ((uint64_t(1) << sub_bucket_bits) | sub) << (shift - 1);
+  return low + (uint64_t(1) << (shift - 1)) / 2;
+}
+
+void
+LatencyHistogram::record(const uint64_t nanoseconds)
+{
+  buckets_[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+  }
+}
+
+LatencySummary
+LatencyHistogram::summary() const
+{
+  std::array<uint64_t, bucket_count> counts;
+
+  LatencySummary summary;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    summary.count += counts[i];
+  }
+  summary.max = max_.load(std::memory_order_relaxed);
+
+  if (!summary.count)
+    return summary;
+
+  // smallest bucket that covers the fraction of the values, the maximum is exact
+  const auto percentile = [&](const double fraction) {
+    const uint64_t rank       = std::max<uint64_t>(1, uint64_t(fraction * summary.count + 0.5));
+    uint64_t       cumulative = 0;
+    for (std::size_t i = 0; i < bucket_count; i++) {
+      cumulative += counts[i];
+      if (cumulative >= rank)
+        return std::min(bucketValue(i), summary.max);
+    }
+    return summary.max;
+  };
+
+  summary.p50  = percentile(0.5);
+  summary.p99  = percentile(0.99);
+  summary.p999 = percentile(0.999);
+
+  return summary;
+}
+
+void
+LatencyHistogram::reset()
+{
+  for (std::atomic<uint64_t> &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  max_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,405 @@
+#include <libcamera_ros_driver/utils/libcamera_backend.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <libcamera_ros_driver/utils/pretty_print.h>
+#include <libcamera_ros_driver/utils/stream_mapping.h>
+#include <libcamera_ros_driver/utils/tracepoints.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#include <ros/ros.h>
+
+
+LibcameraBackend::LibcameraBackend() : camera_manager_(std::make_unique<libcamera::CameraManager>())
+{
+}
+
+LibcameraBackend::~LibcameraBackend()
+{
+  stop();
+
+  // requests and buffers have to be released before the camera
+  releaseBuffers();
+
+  if (acquired_)
+    camera_->release();
+  camera_.reset();
+  camera_manager_->stop();
+}
+
+void
+LibcameraBackend::releaseBuffers()
+{
+  requests_.clear();
+  allocator_.reset();
+
+  for (const auto &e : buffer_info_) {
+    if (munmap(e.second.data, e.second.size) == -1) {
+      ROS_ERROR_STREAM("[LibcameraRosDriver]: "
+                       << "munmap failed: " << std::strerror(errno));
+    }
+  }
+  buffer_info_.clear();
+}
+
+void
+LibcameraBackend::openCamera(const StreamRequest &request)
+{
+  // start camera manager and check for cameras
+  camera_manager_->start();
+  if (camera_manager_->cameras().empty())
+    throw std::runtime_error("no cameras available");
+
+  int camera_id = request.camera_id;
+
+  if (!request.camera_name.empty()) {
+    std::vector<std::string> available_cameras;
+    ROS_INFO_STREAM("[LibcameraRosDriver]: Available cameras:");
+    for (int i = 0; i < camera_manager_->cameras().size(); i++) {
+      available_cameras.push_back(camera_manager_->cameras().at(i)->id());
+    }
+    for (int i = 0; i < available_cameras.size(); i++) {
+      if (available_cameras.at(i).find(request.camera_name) != std::string::npos) {
+        ROS_INFO_STREAM("[LibcameraRosDriver]: found camera: " << request.camera_name << " index: " << i << " at: " << available_cameras.at(i));
+        camera_id = i;
+        break;
+      }
+    }
+  }
+
+  if (camera_id >= camera_manager_->cameras().size()) {
+    ROS_INFO_STREAM(*camera_manager_);
+    throw std::runtime_error("camera with id " + request.camera_name + " does not exist");
+  }
+  camera_ = camera_manager_->cameras().at(camera_id);
+  ROS_INFO_STREAM("[LibcameraRosDriver]: Use camera by id: " << camera_id);
+
+  if (!camera_) {
+    ROS_INFO_STREAM("[LibcameraRosDriver]: " << *camera_manager_);
+    throw std::runtime_error("camera with name " + request.camera_name + " does not exist");
+  }
+
+  if (camera_->acquire())
+    throw std::runtime_error("failed to acquire camera");
+  acquired_ = true;
+}
+
+StreamInfo
+LibcameraBackend::configure(const StreamRequest &request)
+{
+  // a reconfiguration keeps the acquired camera and only replaces the stream and its buffers
+  if (acquired_) {
+    releaseBuffers();
+  } else {
+    openCamera(request);
+  }
+
+  // configure camera stream
+  std::unique_ptr<libcamera::CameraConfiguration> cfg = camera_->generateConfiguration({get_role(request.stream_role)});
+
+  if (!cfg)
+    throw std::runtime_error("failed to generate configuration");
+
+  libcamera::StreamConfiguration &scfg = cfg->at(0);
+
+  // get common pixel formats that are supported by the camera and the node
+  const libcamera::StreamFormats            stream_formats = get_common_stream_formats(scfg.formats());
+  const std::vector<libcamera::PixelFormat> common_fmt     = stream_formats.pixelformats();
+
+  if (common_fmt.empty())
+    throw std::runtime_error("camera does not provide any of the supported pixel formats");
+
+  formats_ = common_fmt;
+
+  if (request.pixel_format.empty()) {
+
+    // auto select first common pixel format that is published, packed raw formats have to be requested
+    const auto published = std::find_if(common_fmt.begin(), common_fmt.end(), [](const libcamera::PixelFormat &fmt) { return format_type(fmt) != FormatType::PACKED; });
+    scfg.pixelFormat     = published != common_fmt.end() ? *published : common_fmt.front();
+    ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
+    ROS_WARN_STREAM("[LibcameraRosDriver]: no pixel format selected, using default: \"" << scfg.pixelFormat << "\"");
+    ROS_WARN_STREAM("[LibcameraRosDriver]: set parameter 'pixel_format' to silent this warning");
+  } else {
+
+    // get pixel format from provided string
+    const libcamera::PixelFormat format_requested = libcamera::PixelFormat::fromString(request.pixel_format);
+
+    if (!format_requested.isValid()) {
+      ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
+      throw std::runtime_error("invalid pixel format: \"" + request.pixel_format + "\"");
+    }
+
+    // check that the requested format is supported by camera and the node
+    if (std::find(common_fmt.begin(), common_fmt.end(), format_requested) == common_fmt.end()) {
+      ROS_INFO_STREAM("[LibcameraRosDriver]: " << stream_formats);
+      throw std::runtime_error("unsupported pixel format \"" + request.pixel_format + "\"");
+    }
+
+    scfg.pixelFormat = format_requested;
+  }
+
+  if (request.size.isNull()) {
+    ROS_INFO_STREAM(scfg);
+    scfg.size = scfg.formats().sizes(scfg.pixelFormat).back();
+    ROS_WARN_STREAM("[LibcameraRosDriver]: no dimensions selected, auto-selecting: \"" << scfg.size << "\"");
+    ROS_WARN_STREAM("[LibcameraRosDriver]: set parameters 'resolution/width' and 'resolution/height' to silent this warning");
+  } else {
+    scfg.size = request.size;
+  }
+
+  // store selected stream configuration
+  const libcamera::StreamConfiguration selected_scfg = scfg;
+
+  switch (cfg->validate()) {
+
+    case libcamera::CameraConfiguration::Valid: {
+      break;
+    }
+
+    case libcamera::CameraConfiguration::Adjusted: {
+
+      if (selected_scfg.pixelFormat != scfg.pixelFormat) {
+        ROS_INFO_STREAM(stream_formats);
+      }
+
+      if (selected_scfg.size != scfg.size) {
+        ROS_INFO_STREAM(scfg);
+      }
+
+      ROS_WARN_STREAM("[LibcameraRosDriver]: stream configuration adjusted from \"" << selected_scfg.toString() << "\" to \"" << scfg.toString() << "\"");
+
+      break;
+    }
+
+    case libcamera::CameraConfiguration::Invalid: {
+      throw std::runtime_error("failed to valid stream configuration");
+    }
+  }
+
+  if (camera_->configure(cfg.get()) < 0)
+    throw std::runtime_error("failed to configure streams");
+
+  ROS_INFO_STREAM("[LibcameraRosDriver]: camera \"" << camera_->id() << "\" configured with " << scfg.toString() << " stream");
+
+  // allocate stream buffers and create one request per buffer
+  stream_ = scfg.stream();
+
+  allocator_ = std::make_shared<libcamera::FrameBufferAllocator>(camera_);
+  allocator_->allocate(stream_);
+
+  for (const std::unique_ptr<libcamera::FrameBuffer> &buffer : allocator_->buffers(stream_)) {
+
+    std::unique_ptr<libcamera::Request> request = camera_->createRequest();
+
+    if (!request)
+      throw std::runtime_error("can't create request");
+
+    // multiple planes of the same buffer use the same file descriptor
+    size_t buffer_length = 0;
+    int    fd            = -1;
+    for (const libcamera::FrameBuffer::Plane &plane : buffer->planes()) {
+
+      if (plane.offset == libcamera::FrameBuffer::Plane::kInvalidOffset)
+        throw std::runtime_error("invalid offset");
+
+      buffer_length = std::max<size_t>(buffer_length, plane.offset + plane.length);
+
+      if (!plane.fd.isValid())
+        throw std::runtime_error("file descriptor is not valid");
+
+      if (fd == -1) {
+        fd = plane.fd.get();
+      } else if (fd != plane.fd.get()) {
+        throw std::runtime_error("plane file descriptors differ");
+      }
+    }
+
+    // memory-map the frame buffer planes
+    void *data = mmap(nullptr, buffer_length, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED)
+      throw std::runtime_error(std::string("mmap failed: ") + std::strerror(errno));
+
+    buffer_info_[buffer.get()] = {data, buffer_length};
+
+    if (request->addBuffer(stream_, buffer.get()) < 0)
+      throw std::runtime_error("can't set buffer for request");
+
+    requests_.push_back(std::move(request));
+  }
+
+  // the frames of the stream have the validated configuration
+  StreamInfo stream;
+  stream.format = scfg.pixelFormat;
+  stream.size   = scfg.size;
+  stream.stride = scfg.stride;
+  for (const auto &e : buffer_info_) {
+    stream.frame_bytes = std::max(stream.frame_bytes, e.second.size);
+  }
+
+  return stream;
+}
+
+const libcamera::ControlInfoMap &
+LibcameraBackend::controls() const
+{
+  return camera_->controls();
+}
+
+void
+LibcameraBackend::setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &values)
+{
+  // set modified control parameters
+  for (std::unique_ptr<libcamera::Request> &request : requests_) {
+    for (const auto &[id, value] : values) {
+      request->controls().set(id, value);
+    }
+  }
+}
+
+void
+LibcameraBackend::queueControls(const ControlCommandValues &values)
+{
+  std::scoped_lock lock(pending_controls_mutex_);
+
+  for (std::size_t i = 0; i < control_slot_count; i++) {
+    if (values.set[i]) {
+      pending_controls_.set[i]    = true;
+      pending_controls_.values[i] = values.values[i];
+    }
+  }
+}
+
+void
+LibcameraBackend::start(const FrameCallback &on_frame, const CancelCallback &on_cancel)
+{
+  on_frame_  = on_frame;
+  on_cancel_ = on_cancel;
+
+  // register callback
+  camera_->requestCompleted.connect(this, &LibcameraBackend::requestComplete);
+
+  // start camera and queue all requests
+  if (camera_->start()) {
+    camera_->requestCompleted.disconnect();
+    throw std::runtime_error("failed to start camera");
+  }
+  started_ = true;
+
+  for (std::unique_ptr<libcamera::Request> &request : requests_) {
+    if (!camera_->queueRequest(request.get()))
+      queued_++;
+  }
+}
+
+void
+LibcameraBackend::stop()
+{
+  if (!started_)
+    return;
+
+  camera_->requestCompleted.disconnect();
+
+  {
+    std::scoped_lock lock(request_lock_);
+
+    if (camera_->stop()) {
+      ROS_ERROR("[LibcameraRosDriver]: failed to stop camera");
+    }
+  }
+
+  // the completion handler is disconnected, the cancelled requests are not counted off
+  queued_  = 0;
+  started_ = false;
+}
+
+std::string
+LibcameraBackend::id() const
+{
+  return camera_ ? camera_->id() : std::string();
+}
+
+void
+LibcameraBackend::requestComplete(libcamera::Request *request)
+{
+  std::scoped_lock lock(request_lock_);
+
+  queued_--;
+
+  if (request->status() == libcamera::Request::RequestComplete) {
+
+    assert(request->buffers().size() == 1);
+
+    // get the stream and buffer from the request
+    const libcamera::FrameBuffer *  buffer   = request->findBuffer(stream_);
+    const libcamera::FrameMetadata &metadata = buffer->metadata();
+
+    FrameView frame;
+    frame.data      = static_cast<const uint8_t *>(buffer_info_[buffer].data);
+    frame.sequence  = metadata.sequence;
+    frame.timestamp = metadata.timestamp;
+    frame.request   = request;
+
+    for (const libcamera::FrameMetadata::Plane &plane : metadata.planes()) {
+      frame.size += plane.bytesused;
+    }
+    assert(buffer_info_[buffer].size == frame.size);
+
+    FRAME_TRACEPOINT(request_complete, frame.sequence, frame.size, request);
+
+    frame.exposure_time = request->metadata().get(libcamera::controls::ExposureTime);
+    frame.analogue_gain = request->metadata().get(libcamera::controls::AnalogueGain);
+
+    const auto black_levels = request->metadata().get(libcamera::controls::SensorBlackLevels);
+    if (black_levels) {
+      frame.black_levels.emplace();
+      std::copy(black_levels->begin(), black_levels->end(), frame.black_levels->begin());
+    }
+
+    const auto colour_gains = request->metadata().get(libcamera::controls::ColourGains);
+    if (colour_gains) {
+      frame.colour_gains.emplace();
+      std::copy(colour_gains->begin(), colour_gains->end(), frame.colour_gains->begin());
+    }
+
+    const auto colour_matrix = request->metadata().get(libcamera::controls::ColourCorrectionMatrix);
+    if (colour_matrix) {
+      frame.colour_matrix.emplace();
+      std::copy(colour_matrix->begin(), colour_matrix->end(), frame.colour_matrix->begin());
+    }
+
+    on_frame_(frame);
+
+  } else if (request->status() == libcamera::Request::RequestCancelled) {
+    FRAME_TRACEPOINT(request_cancelled, request->sequence(), 0, request);
+    on_cancel_("request '" + request->toString() + "' cancelled");
+  }
+
+  // queue the request again for the next frame
+  const std::chrono::steady_clock::time_point requeue = std::chrono::steady_clock::now();
+
+  request->reuse(libcamera::Request::ReuseBuffers);
+
+  // commanded controls take effect with the next request that is queued
+  ControlCommandValues pending;
+  {
+    std::scoped_lock lock(pending_controls_mutex_);
+    pending = pending_controls_;
+    pending_controls_.set.fill(false);
+  }
+
+  for (std::size_t i = 0; i < control_slot_count; i++) {
+    if (pending.set[i])
+      request->controls().set(control_slot_id(ControlSlot(i)).id(), control_slot_value(ControlSlot(i), pending.values[i]));
+  }
+  if (!camera_->queueRequest(request))
+    queued_++;
+
+  if (histograms_)
+    histograms_->record(LatencyStage::REQUEUE,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - requeue).count());
+}
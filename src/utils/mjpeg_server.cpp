@@ -0,0 +1,478 @@
+#include <libcamera_ros_driver/utils/mjpeg_server.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#include <sensor_msgs/image_encodings.h>
+
+
+namespace enc = sensor_msgs::image_encodings;
+
+// channels of an encoding and the source channel of R, G and B
+struct preview_layout_t
+{
+  unsigned int channels;
+  unsigned int rgb[3];
+};
+
+static bool
+preview_layout(const std::string &encoding, preview_layout_t &layout)
+{
+  if (encoding == enc::MONO8)
+    layout = {1, {0, 0, 0}};
+  else if (encoding == enc::RGB8)
+    layout = {3, {0, 1, 2}};
+  else if (encoding == enc::BGR8)
+    layout = {3, {2, 1, 0}};
+  else if (encoding == enc::RGBA8)
+    layout = {4, {0, 1, 2}};
+  else if (encoding == enc::BGRA8)
+    layout = {4, {2, 1, 0}};
+  else
+    return false;
+
+  return true;
+}
+
+#ifdef HAVE_LIBJPEG
+
+// libjpeg exits the process on errors by default, they return to the setjmp() of compress_jpeg() instead
+struct jpeg_error_t
+{
+  jpeg_error_mgr mgr;
+  jmp_buf        jump;
+};
+
+static void
+jpeg_error_exit(j_common_ptr cinfo)
+{
+  longjmp(reinterpret_cast<jpeg_error_t *>(cinfo->err)->jump, 1);
+}
+
+// destination that grows a vector, its capacity is kept between the images
+struct jpeg_vector_destination_t
+{
+  jpeg_destination_mgr  mgr;
+  std::vector<uint8_t> *buffer;
+};
+
+static void
+jpeg_vector_init(j_compress_ptr cinfo)
+{
+  jpeg_vector_destination_t *dest = reinterpret_cast<jpeg_vector_destination_t *>(cinfo->dest);
+  dest->buffer->resize(std::max<std::size_t>(dest->buffer->capacity(), 65536));
+  dest->mgr.next_output_byte = dest->buffer->data();
+  dest->mgr.free_in_buffer   = dest->buffer->size();
+}
+
+static boolean
+jpeg_vector_empty(j_compress_ptr cinfo)
+{
+  // libjpeg expects the whole buffer to be written when it is full
+  jpeg_vector_destination_t *dest = reinterpret_cast<jpeg_vector_destination_t *>(cinfo->dest);
+  const std::size_t          used = dest->buffer->size();
+  dest->buffer->resize(2 * used);
+  dest->mgr.next_output_byte = dest->buffer->data() + used;
+  dest->mgr.free_in_buffer   = dest->buffer->size() - used;
+  return TRUE;
+}
+
+static void
+jpeg_vector_term(j_compress_ptr cinfo)
+{
+  jpeg_vector_destination_t *dest = reinterpret_cast<jpeg_vector_destination_t *>(cinfo->dest);
+  dest->buffer->resize(dest->buffer->size() - dest->mgr.free_in_buffer);
+}
+
+// no object with a destructor may live in this function, longjmp() skips them
+static bool
+compress_jpeg(const uint8_t *pixels, const unsigned int width, const unsigned int height, const unsigned int channels, const int quality,
+              std::vector<uint8_t> *jpeg)
+{
+  jpeg_compress_struct      cinfo;
+  jpeg_error_t              error;
+  jpeg_vector_destination_t dest;
+
+  cinfo.err            = jpeg_std_error(&error.mgr);
+  error.mgr.error_exit = jpeg_error_exit;
+
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+
+  dest.buffer                  = jpeg;
+  dest.mgr.init_destination    = jpeg_vector_init;
+  dest.mgr.empty_output_buffer = jpeg_vector_empty;
+  dest.mgr.term_destination    = jpeg_vector_term;
+  cinfo.dest                   = &dest.mgr;
+
+  cinfo.image_width      = width;
+  cinfo.image_height     = height;
+  cinfo.input_components = channels;
+  cinfo.in_color_space   = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  cinfo.dct_method = JDCT_IFAST;
+
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<JSAMPROW>(pixels + std::size_t(cinfo.next_scanline) * width * channels);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+
+  jpeg_destroy_compress(&cinfo);
+  return true;
+}
+
+#endif
+
+PreviewEncoder::PreviewEncoder(const unsigned int max_width, const int quality, const unsigned int buffers)
+    : max_width_(std::max(max_width, 1u)), quality_(std::clamp(quality, 1, 100))
+{
+  if (!available())
+    throw std::runtime_error("the driver was built without libjpeg");
+
+  jpegs_.resize(std::max(buffers, 1u));
+  for (std::shared_ptr<std::vector<uint8_t>> &jpeg : jpegs_)
+    jpeg = std::make_shared<std::vector<uint8_t>>();
+}
+
+bool
+PreviewEncoder::available()
+{
+#ifdef HAVE_LIBJPEG
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+PreviewEncoder::supports(const std::string &encoding)
+{
+  preview_layout_t layout;
+  return preview_layout(encoding, layout);
+}
+
+std::shared_ptr<std::vector<uint8_t>>
+PreviewEncoder::acquire()
+{
+  for (std::size_t i = 0; i < jpegs_.size(); i++) {
+    const std::size_t index = (next_jpeg_ + i) % jpegs_.size();
+    if (jpegs_[index].use_count() == 1) {
+      next_jpeg_ = index + 1;
+      return jpegs_[index];
+    }
+  }
+
+  return std::make_shared<std::vector<uint8_t>>();
+}
+
+std::shared_ptr<const std::vector<uint8_t>>
+PreviewEncoder::encode(const uint8_t *src, const std::size_t src_step, const unsigned int width, const unsigned int height, const std::string &encoding)
+{
+  preview_layout_t layout;
+  if (!preview_layout(encoding, layout))
+    throw std::runtime_error("no preview can be encoded from \"" + encoding + "\" images");
+
+  // averages of factor x factor blocks, the remainder at the right and the bottom is cut off
+  const unsigned int factor     = (width + max_width_ - 1) / max_width_;
+  const unsigned int dst_width  = std::max(width / factor, 1u);
+  const unsigned int dst_height = std::max(height / factor, 1u);
+  const unsigned int channels   = layout.channels == 1 ? 1 : 3;
+
+  pixels_.resize(std::size_t(dst_width) * dst_height * channels);
+  sums_.resize(std::size_t(dst_width) * factor * layout.channels);
+
+  if (layout.channels == 1)
+    downscale<1, false>(src, src_step, factor, dst_width, dst_height);
+  else if (layout.channels == 3)
+    layout.rgb[0] ? downscale<3, true>(src, src_step, factor, dst_width, dst_height) : downscale<3, false>(src, src_step, factor, dst_width, dst_height);
+  else
+    layout.rgb[0] ? downscale<4, true>(src, src_step, factor, dst_width, dst_height) : downscale<4, false>(src, src_step, factor, dst_width, dst_height);
+
+  const std::shared_ptr<std::vector<uint8_t>> jpeg = acquire();
+
+#ifdef HAVE_LIBJPEG
+  if (!compress_jpeg(pixels_.data(), dst_width, dst_height, channels, quality_, jpeg.get()))
+    throw std::runtime_error("failed to encode the preview");
+#endif
+
+  return jpeg;
+}
+
+template <unsigned int SRC_CHANNELS, bool BGR>
+void
+PreviewEncoder::downscale(const uint8_t *src, const std::size_t src_step, const unsigned int factor, const unsigned int dst_width,
+                          const unsigned int dst_height)
+{
+  constexpr unsigned int channels = SRC_CHANNELS == 1 ? 1 : 3;
+  const unsigned int     area     = factor * factor;
+  const Kernels &        k        = kernels();
+
+  for (unsigned int y = 0; y < dst_height; y++) {
+
+    // the rows of a block are summed per source sample, then the columns of every block
+    std::fill(sums_.begin(), sums_.end(), 0);
+    for (unsigned int dy = 0; dy < factor; dy++) {
+      k.accumulate_row_u8(src + std::size_t(y * factor + dy) * src_step, sums_.data(), sums_.size());
+    }
+
+    const uint32_t *sum = sums_.data();
+    uint8_t *       dst = pixels_.data() + std::size_t(y) * dst_width * channels;
+
+    for (unsigned int x = 0; x < dst_width; x++, dst += channels) {
+      uint32_t block[channels] = {};
+      for (unsigned int dx = 0; dx < factor; dx++, sum += SRC_CHANNELS) {
+        for (unsigned int c = 0; c < channels; c++) {
+          block[c] += sum[BGR ? 2 - c : c];
+        }
+      }
+
+      for (unsigned int c = 0; c < channels; c++) {
+        dst[c] = uint8_t((block[c] + area / 2) / area);
+      }
+    }
+  }
+}
+
+MjpegServer::MjpegServer(const std::string &address, const uint16_t port, const unsigned int max_clients) : max_clients_(std::max(max_clients, 1u))
+{
+  sockaddr_in addr = {};
+  addr.sin_family  = AF_INET;
+  addr.sin_port    = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+    throw std::runtime_error("invalid address \"" + address + "\"");
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0)
+    throw std::runtime_error(std::string("failed to create the socket: ") + strerror(errno));
+
+  // a restarted driver can bind again while the connections of the previous one are in TIME_WAIT
+  const int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  socklen_t length = sizeof(addr);
+  if (bind(listen_fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 8) < 0 ||
+      getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &length) < 0 || pipe2(wake_fd_, O_CLOEXEC) < 0) {
+    const std::string error = strerror(errno);
+    close(listen_fd_);
+    throw std::runtime_error("failed to listen on " + address + ":" + std::to_string(port) + ": " + error);
+  }
+
+  port_     = ntohs(addr.sin_port);
+  acceptor_ = std::thread(&MjpegServer::acceptor, this);
+}
+
+MjpegServer::~MjpegServer()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  frame_cv_.notify_all();
+
+  const char wake = 0;
+  if (write(wake_fd_[1], &wake, 1) < 0) {
+    // the pipe can not be full, the acceptor only ever gets this one byte
+  }
+
+  acceptor_.join();
+
+  // the acceptor shut the connections down, the clients return from their blocking calls
+  for (client_t &client : connections_) {
+    client.thread.join();
+    close(client.fd);
+  }
+
+  close(listen_fd_);
+  close(wake_fd_[0]);
+  close(wake_fd_[1]);
+}
+
+void
+MjpegServer::publish(std::shared_ptr<const std::vector<uint8_t>> jpeg)
+{
+  {
+    std::scoped_lock lock(mutex_);
+    frame_ = std::move(jpeg);
+    sequence_++;
+  }
+  frame_cv_.notify_all();
+}
+
+std::shared_ptr<const std::vector<uint8_t>>
+MjpegServer::next(uint64_t &sequence)
+{
+  std::unique_lock lock(mutex_);
+  frame_cv_.wait(lock, [&] { return stop_ || (frame_ && sequence_ != sequence); });
+
+  if (stop_)
+    return nullptr;
+
+  sequence = sequence_;
+  return frame_;
+}
+
+void
+MjpegServer::acceptor()
+{
+  pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_[0], POLLIN, 0}};
+
+  while (true) {
+    if (poll(fds, 2, 1000) < 0 && errno != EINTR)
+      break;
+
+    if (fds[1].revents)
+      break;
+
+    // finished clients are joined here, the server keeps no state of them
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      if (it->done) {
+        it->thread.join();
+        close(it->fd);
+        it = connections_.erase(it);
+      } else {
+        it++;
+      }
+    }
+
+    if (!(fds[0].revents & POLLIN))
+      continue;
+
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    // a client that stops reading must not block its thread forever
+    const timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    client_t &client = connections_.emplace_back();
+    client.fd        = fd;
+    client.thread    = std::thread(&MjpegServer::serve, this, std::ref(client));
+  }
+
+  for (client_t &client : connections_) {
+    shutdown(client.fd, SHUT_RDWR);
+  }
+}
+
+// sends everything or fails
+static bool
+send_all(const int fd, const void *data, std::size_t length)
+{
+  const char *p = static_cast<const char *>(data);
+
+  while (length) {
+    const ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+
+    p += sent;
+    length -= sent;
+  }
+
+  return true;
+}
+
+static bool
+send_all(const int fd, const std::string &text)
+{
+  return send_all(fd, text.data(), text.size());
+}
+
+void
+MjpegServer::serve(client_t &client)
+{
+  const int fd = client.fd;
+
+  // only the request line matters, the headers are read and ignored
+  std::string request;
+  char        buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos && request.size() < 8192) {
+    const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      break;
+    request.append(buffer, received);
+  }
+
+  char method[16] = {}, path[256] = {};
+  if (sscanf(request.c_str(), "%15s %255s", method, path) != 2) {
+    send_all(fd, "HTTP/1.0 400 Bad Request\r\nConnection: close\r\n\r\n");
+    client.done = true;
+    return;
+  }
+
+  const std::string target = std::string(path).substr(0, std::string(path).find('?'));
+  const bool        stream = target == "/" || target == "/stream";
+
+  if (strcmp(method, "GET") != 0 || (!stream && target != "/snapshot")) {
+    send_all(fd, "HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+    client.done = true;
+    return;
+  }
+
+  if (clients_.fetch_add(1) >= max_clients_) {
+    clients_--;
+    send_all(fd, "HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+    client.done = true;
+    return;
+  }
+
+  // every client gets the frames published after its request
+  uint64_t sequence;
+  {
+    std::scoped_lock lock(mutex_);
+    sequence = sequence_;
+  }
+
+  if (stream) {
+    bool ok = send_all(fd, "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                           "Cache-Control: no-cache, no-store\r\n"
+                           "Connection: close\r\n\r\n");
+
+    while (ok) {
+      const std::shared_ptr<const std::vector<uint8_t>> jpeg = next(sequence);
+      if (!jpeg)
+        break;
+
+      ok = send_all(fd, "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg->size()) + "\r\n\r\n") &&
+           send_all(fd, jpeg->data(), jpeg->size()) && send_all(fd, "\r\n");
+    }
+  } else {
+    const std::shared_ptr<const std::vector<uint8_t>> jpeg = next(sequence);
+    if (jpeg && send_all(fd, "HTTP/1.0 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg->size()) +
+                                 "\r\nCache-Control: no-cache, no-store\r\nConnection: close\r\n\r\n")) {
+      send_all(fd, jpeg->data(), jpeg->size());
+    }
+  }
+
+  clients_--;
+  client.done = true;
+}
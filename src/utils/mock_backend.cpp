@@ -0,0 +1,296 @@
+#include <libcamera_ros_driver/utils/mock_backend.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+#include <libcamera/control_ids.h>
+
+#include <ros/ros.h>
+
+
+// controls of a typical sensor with an ISP, enough to exercise the validation of the driver parameters
+static libcamera::ControlInfoMap
+mock_controls(const libcamera::Size &size)
+{
+  namespace ctrl = libcamera::controls;
+
+  const libcamera::Rectangle full(0, 0, size.width, size.height);
+
+  libcamera::ControlInfoMap::Map map = {
+    {&ctrl::ExposureTime, libcamera::ControlInfo(int32_t(1), int32_t(1000000), int32_t(10000))},
+    {&ctrl::FrameDurationLimits, libcamera::ControlInfo(int64_t(1000), int64_t(1000000), int64_t(33333))},
+    {&ctrl::AnalogueGain, libcamera::ControlInfo(1.0f, 16.0f, 1.0f)},
+    {&ctrl::AeEnable, libcamera::ControlInfo(false, true, true)},
+    {&ctrl::AeConstraintMode, libcamera::ControlInfo(int32_t(0), int32_t(3), int32_t(0))},
+    {&ctrl::AeMeteringMode, libcamera::ControlInfo(int32_t(0), int32_t(3), int32_t(0))},
+    {&ctrl::AeExposureMode, libcamera::ControlInfo(int32_t(0), int32_t(3), int32_t(0))},
+    {&ctrl::ExposureValue, libcamera::ControlInfo(-8.0f, 8.0f, 0.0f)},
+    {&ctrl::Brightness, libcamera::ControlInfo(-1.0f, 1.0f, 0.0f)},
+    {&ctrl::Contrast, libcamera::ControlInfo(0.0f, 32.0f, 1.0f)},
+    {&ctrl::Saturation, libcamera::ControlInfo(0.0f, 32.0f, 1.0f)},
+    {&ctrl::Sharpness, libcamera::ControlInfo(0.0f, 16.0f, 1.0f)},
+    {&ctrl::AwbEnable, libcamera::ControlInfo(false, true, true)},
+    {&ctrl::AwbMode, libcamera::ControlInfo(int32_t(0), int32_t(7), int32_t(0))},
+    {&ctrl::ScalerCrop, libcamera::ControlInfo(libcamera::Rectangle(), full, full)},
+  };
+
+  return libcamera::ControlInfoMap(std::move(map), ctrl::controls);
+}
+
+MockBackend::MockBackend(const MockBackendOptions &options) : options_(options), controls_(mock_controls(options.default_size))
+{
+}
+
+MockBackend::~MockBackend()
+{
+  stop();
+}
+
+std::vector<libcamera::PixelFormat>
+MockBackend::formats() const
+{
+  return options_.formats.empty() ? get_raw_formats() : options_.formats;
+}
+
+StreamInfo
+MockBackend::configure(const StreamRequest &request)
+{
+  const std::vector<libcamera::PixelFormat> formats = this->formats();
+
+  if (request.pixel_format.empty()) {
+    stream_.format = formats.front();
+    ROS_WARN_STREAM("[LibcameraRosDriver]: no pixel format selected, using default: \"" << stream_.format << "\"");
+  } else {
+    stream_.format = libcamera::PixelFormat::fromString(request.pixel_format);
+    if (std::find(formats.begin(), formats.end(), stream_.format) == formats.end())
+      throw std::runtime_error("unsupported pixel format \"" + request.pixel_format + "\"");
+  }
+
+  const unsigned int bytes_per_pixel = get_bytes_per_pixel(stream_.format);
+  if (!bytes_per_pixel)
+    throw std::runtime_error("the mock camera can not produce \"" + stream_.format.toString() + "\" frames");
+
+  stream_.size = request.size.isNull() ? options_.default_size : request.size;
+
+  const unsigned int alignment = std::max(options_.stride_alignment, 1u);
+  stream_.stride               = (stream_.size.width * bytes_per_pixel + alignment - 1) / alignment * alignment;
+  stream_.frame_bytes          = std::size_t(stream_.stride) * stream_.size.height;
+
+  // every buffer gets a different gradient, the padding at the end of the rows stays zero
+  buffers_.assign(std::max(options_.buffers, 1u), std::vector<uint8_t>(stream_.frame_bytes, 0));
+
+  for (std::size_t b = 0; b < buffers_.size(); b++) {
+    for (unsigned int y = 0; y < stream_.size.height; y++) {
+      uint8_t *row = buffers_[b].data() + std::size_t(y) * stream_.stride;
+      for (unsigned int i = 0; i < stream_.size.width * bytes_per_pixel; i++) {
+        row[i] = uint8_t(i + y + b * 8);
+      }
+    }
+  }
+
+  ROS_INFO_STREAM("[LibcameraRosDriver]: mock camera configured with " << stream_.size.width << "x" << stream_.size.height << "-" << stream_.format
+                                                                        << " stream, stride " << stream_.stride);
+
+  return stream_;
+}
+
+void
+MockBackend::setControls(const std::unordered_map<unsigned int, libcamera::ControlValue> &values)
+{
+  namespace ctrl = libcamera::controls;
+
+  // only the controls that are reported in the frame metadata have an effect
+  for (const auto &[id, value] : values) {
+    if (id == ctrl::FrameDurationLimits.id())
+      frame_duration_ = value.get<libcamera::Span<const int64_t>>()[0];
+    else if (id == ctrl::ExposureTime.id())
+      exposure_time_ = value.get<int32_t>();
+    else if (id == ctrl::AnalogueGain.id())
+      analogue_gain_ = value.get<float>();
+  }
+}
+
+void
+MockBackend::queueControls(const ControlCommandValues &values)
+{
+  std::scoped_lock lock(mutex_);
+
+  for (std::size_t i = 0; i < control_slot_count; i++) {
+    if (values.set[i]) {
+      pending_controls_.set[i]    = true;
+      pending_controls_.values[i] = values.values[i];
+    }
+  }
+}
+
+void
+MockBackend::applyPendingControls()
+{
+  if (pending_controls_.set[std::size_t(ControlSlot::EXPOSURE_TIME)])
+    exposure_time_ = int32_t(pending_controls_.values[std::size_t(ControlSlot::EXPOSURE_TIME)][0]);
+  if (pending_controls_.set[std::size_t(ControlSlot::ANALOGUE_GAIN)])
+    analogue_gain_ = float(pending_controls_.values[std::size_t(ControlSlot::ANALOGUE_GAIN)][0]);
+  if (pending_controls_.set[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)])
+    frame_duration_ = int64_t(pending_controls_.values[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)][0]);
+
+  pending_controls_.set.fill(false);
+}
+
+void
+MockBackend::start(const FrameCallback &on_frame, const CancelCallback &on_cancel)
+{
+  if (options_.fail_start)
+    throw std::runtime_error("failed to start camera (injected failure)");
+
+  stop();
+
+  on_frame_  = on_frame;
+  on_cancel_ = on_cancel;
+  stop_      = false;
+  thread_    = std::thread(options_.trace.empty() ? &MockBackend::generator : &MockBackend::replayTrace, this);
+}
+
+void
+MockBackend::stop()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  stop_cv_.notify_one();
+
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void
+MockBackend::generator()
+{
+  using clock = std::chrono::steady_clock;
+
+  std::mt19937                           rng(options_.seed);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  std::uniform_real_distribution<double> jitter(-options_.jitter, options_.jitter);
+
+  clock::duration period = std::chrono::microseconds(std::max<int64_t>(frame_duration_, 1));
+
+  const bool bayer = get_bayer_order(stream_.format).has_value();
+
+  clock::time_point next     = clock::now();
+  uint64_t          sequence = 0;
+
+  while (true) {
+
+    // a sensor keeps its frame rate, frames that are not picked up in time are lost
+    next += period;
+    while (next + period < clock::now()) {
+      next += period;
+      sequence++;
+    }
+
+    const clock::time_point due = next + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(jitter(rng)));
+
+    {
+      std::unique_lock lock(mutex_);
+      if (stop_cv_.wait_until(lock, due, [&] { return stop_; }))
+        break;
+
+      // like a sensor, a new frame duration applies from the next frame on
+      applyPendingControls();
+      period = std::chrono::microseconds(std::max<int64_t>(frame_duration_, 1));
+    }
+
+    const uint64_t frame_sequence = sequence++;
+
+    if (chance(rng) < options_.drop_rate)
+      continue;
+
+    if (chance(rng) < options_.cancel_rate) {
+      on_cancel_("request " + std::to_string(frame_sequence) + " cancelled (injected failure)");
+      continue;
+    }
+
+    FrameView frame;
+    frame.data          = buffers_[frame_sequence % buffers_.size()].data();
+    frame.size          = stream_.frame_bytes;
+    frame.sequence      = frame_sequence;
+    frame.timestamp     = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    frame.request       = frame.data;
+    frame.exposure_time = exposure_time_;
+    frame.analogue_gain = analogue_gain_;
+
+    // black level of a typical 10-bit sensor in 16-bit scale
+    if (bayer)
+      frame.black_levels = std::array<int32_t, 4>{4096, 4096, 4096, 4096};
+
+    on_frame_(frame);
+  }
+}
+
+void
+MockBackend::replayTrace()
+{
+  using clock = std::chrono::steady_clock;
+
+  const std::vector<CompletionRecord> &trace = options_.trace;
+
+  // a repetition starts one mean completion interval after the end of the previous one and continues the sequence numbers
+  const uint64_t first    = trace.front().completion;
+  const uint64_t span     = trace.back().completion - first;
+  const uint64_t interval = trace.size() > 1 ? span / (trace.size() - 1) : frame_duration_ * 1000;
+  const uint64_t period   = span + interval;
+
+  uint64_t first_sequence = UINT64_MAX, last_sequence = 0;
+  for (const CompletionRecord &record : trace) {
+    if (record.status == CompletionStatus::COMPLETE) {
+      first_sequence = std::min(first_sequence, record.sequence);
+      last_sequence  = std::max(last_sequence, record.sequence);
+    }
+  }
+  const uint64_t sequence_span = first_sequence <= last_sequence ? last_sequence - first_sequence + 1 : 0;
+
+  const bool bayer = get_bayer_order(stream_.format).has_value();
+
+  const clock::time_point start    = clock::now();
+  const int64_t           start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+
+  for (uint64_t repetition = 0; repetition == 0 || options_.trace_loop; repetition++) {
+    for (const CompletionRecord &record : trace) {
+
+      // completions that are due already are delivered back to back, like a burst from the camera
+      const int64_t offset = int64_t(repetition * period + (record.completion - first));
+
+      {
+        std::unique_lock lock(mutex_);
+        if (stop_cv_.wait_until(lock, start + std::chrono::nanoseconds(offset), [&] { return stop_; }))
+          return;
+
+        // the completion times of the trace are kept, only the metadata follows the commands
+        applyPendingControls();
+      }
+
+      if (record.status == CompletionStatus::CANCELLED) {
+        on_cancel_("request cancelled (trace replay)");
+        continue;
+      }
+
+      FrameView frame;
+      frame.data      = buffers_[record.sequence % buffers_.size()].data();
+      frame.size      = std::min(record.bytesused, stream_.frame_bytes);
+      frame.sequence  = record.sequence + repetition * sequence_span;
+      frame.timestamp = uint64_t(start_ns + offset - int64_t(record.completion - record.timestamp));
+      frame.request   = frame.data;
+
+      frame.exposure_time = exposure_time_;
+      frame.analogue_gain = analogue_gain_;
+
+      if (bayer)
+        frame.black_levels = std::array<int32_t, 4>{4096, 4096, 4096, 4096};
+
+      on_frame_(frame);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include <libcamera_ros_driver/utils/output_accounting.h>
+#include <algorithm>
+#include <ctime>
+
+#include <ros/topic_manager.h>
+
+
+uint64_t
+thread_cpu_time()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+OutputCounters &
+OutputAccounting::add(const std::string &topic, const std::string &transport, const std::function<uint32_t()> &subscribers)
+{
+  std::scoped_lock lock(mutex_);
+
+  output_t &output   = outputs_.emplace_back();
+  output.topic       = topic;
+  output.transport   = transport;
+  output.subscribers = subscribers;
+  return output.counters;
+}
+
+void
+OutputAccounting::remove(const OutputCounters &counters)
+{
+  std::scoped_lock lock(mutex_);
+
+  outputs_.remove_if([&counters](const output_t &output) { return &output.counters == &counters; });
+}
+
+std::vector<OutputUsage>
+OutputAccounting::collect()
+{
+  std::scoped_lock lock(mutex_);
+
+  // per published topic: [name, [[connection id, bytes sent, payload sent, messages sent, connected], ...]], the
+  // counters are 32-bit and wrap, the differences stay correct as long as a connection sends less than 4 GiB per report
+  XmlRpc::XmlRpcValue stats;
+  ros::TopicManager::instance()->getBusStats(stats);
+
+  std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> traffic;  // bytes sent, largest payload of a connection
+  std::unordered_map<int, connection_t>                          connections;
+
+  if (stats.getType() == XmlRpc::XmlRpcValue::TypeArray && stats.size() > 0) {
+    XmlRpc::XmlRpcValue &published = stats[0];
+    for (int i = 0; i < published.size(); i++) {
+      const std::string    topic = published[i][0];
+      XmlRpc::XmlRpcValue &links = published[i][1];
+
+      for (int j = 0; j < links.size(); j++) {
+        const int          id = links[j][0];
+        const connection_t now{uint32_t(int(links[j][1])), uint32_t(int(links[j][2]))};
+        const connection_t before = connections_.count(id) ? connections_[id] : connection_t{};
+
+        traffic[topic].first += uint32_t(now.bytes - before.bytes);
+        traffic[topic].second = std::max<uint64_t>(traffic[topic].second, uint32_t(now.payload - before.payload));
+        connections[id]       = now;
+      }
+    }
+  }
+
+  connections_.swap(connections);
+
+  std::vector<OutputUsage> usage;
+  usage.reserve(outputs_.size());
+
+  for (output_t &output : outputs_) {
+    OutputUsage &u = usage.emplace_back();
+    u.topic        = output.topic;
+    u.transport    = output.transport;
+    u.subscribers  = output.subscribers();
+    u.frames       = output.counters.frames.exchange(0, std::memory_order_relaxed);
+    u.bytes        = output.counters.bytes.exchange(0, std::memory_order_relaxed);
+    u.cpu_time     = 1e-9 * output.counters.cpu_ns.exchange(0, std::memory_order_relaxed);
+
+    const auto it = traffic.find(output.topic);
+    if (it != traffic.end()) {
+      u.bytes_sent = it->second.first;
+
+      // the messages of a transport are only seen on their way to remote subscribers
+      if (!u.bytes)
+        u.bytes = it->second.second;
+    }
+  }
+
+  return usage;
+}
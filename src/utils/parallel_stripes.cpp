@@ -0,0 +1,90 @@
+#include <libcamera_ros_driver/utils/parallel_stripes.h>
+#include <algorithm>
+
+
+ParallelStripes::ParallelStripes(unsigned int threads)
+{
+  for (unsigned int i = 1; i < std::max(threads, 1u); i++)
+    workers_.emplace_back(&ParallelStripes::worker, this, i);
+}
+
+ParallelStripes::~ParallelStripes()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+
+  for (std::thread &t : workers_)
+    t.join();
+}
+
+static void
+stripe(const unsigned int index, const unsigned int count, const unsigned int rows, unsigned int &begin, unsigned int &end)
+{
+  begin = rows * index / count;
+  end   = rows * (index + 1) / count;
+}
+
+void
+ParallelStripes::runStripes(unsigned int rows, stripe_fn_t fn, const void *context)
+{
+  unsigned int begin, end;
+
+  if (workers_.empty()) {
+    fn(context, 0, rows);
+    return;
+  }
+
+  {
+    std::scoped_lock lock(mutex_);
+    fn_      = fn;
+    context_ = context;
+    rows_    = rows;
+    pending_ = workers_.size();
+    batch_++;
+  }
+  start_.notify_all();
+
+  stripe(0, threads(), rows, begin, end);
+  fn(context, begin, end);
+
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+  fn_      = nullptr;
+  context_ = nullptr;
+}
+
+void
+ParallelStripes::worker(unsigned int index)
+{
+  unsigned long batch = 0;
+
+  while (true) {
+    stripe_fn_t  fn;
+    const void * context;
+    unsigned int rows;
+
+    {
+      std::unique_lock lock(mutex_);
+      start_.wait(lock, [&] { return stop_ || batch_ != batch; });
+      if (stop_)
+        return;
+      batch   = batch_;
+      fn      = fn_;
+      context = context_;
+      rows    = rows_;
+    }
+
+    unsigned int begin, end;
+    stripe(index, threads(), rows, begin, end);
+    fn(context, begin, end);
+
+    {
+      std::scoped_lock lock(mutex_);
+      pending_--;
+    }
+    done_.notify_one();
+  }
+}
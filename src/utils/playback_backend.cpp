@@ -0,0 +1,53 @@
+#include <libcamera_ros_driver/utils/playback_backend.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <stdexcept>
+
+#include <ros/ros.h>
+
+
+PlaybackBackend::PlaybackBackend(const std::string &source, const PlaybackPacing pacing, const bool loop, const double raw_fps, const unsigned int raw_stride)
+    : source_(source), pacing_(pacing), loop_(loop), raw_fps_(raw_fps), raw_stride_(raw_stride)
+{
+}
+
+StreamInfo
+PlaybackBackend::configure(const StreamRequest &request)
+{
+  // raw frame files are described by the stream parameters, capture files carry their own layout
+  StreamInfo raw_stream;
+  raw_stream.format = libcamera::PixelFormat::fromString(request.pixel_format);
+  raw_stream.size   = request.size;
+  raw_stream.stride = raw_stride_ > 0 ? raw_stride_ : raw_stream.size.width * get_bytes_per_pixel(raw_stream.format);
+
+  playback_ = std::make_unique<FramePlayback>(source_, raw_stream, raw_fps_);
+
+  ROS_INFO_STREAM("[LibcameraRosDriver]: playing " << playback_->frames() << " frames of " << playback_->stream().size << "-"
+                                                   << playback_->stream().format << " from \"" << source_ << "\"");
+
+  return playback_->stream();
+}
+
+void
+PlaybackBackend::start(const FrameCallback &on_frame, const CancelCallback &)
+{
+  if (!playback_)
+    throw std::runtime_error("playback source is not configured");
+
+  playback_->start(on_frame, pacing_, loop_);
+}
+
+void
+PlaybackBackend::stop()
+{
+  if (playback_)
+    playback_->stop();
+}
+
+std::optional<sensor_msgs::CameraInfo>
+PlaybackBackend::cameraInfo() const
+{
+  if (!playback_)
+    return std::nullopt;
+
+  return playback_->cameraInfo();
+}
@@ -0,0 +1,143 @@
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <algorithm>
+#include <fstream>
+#include <libcamera/formats.h>
+#include <libcamera/pixel_format.h>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace cam = libcamera::formats;
+
+std::optional<BayerOrder>
+get_bayer_order(const libcamera::PixelFormat &pixelformat)
+{
+  static const std::unordered_map<uint32_t, BayerOrder> map_bayer_order = {
+    {cam::SRGGB8.fourcc(), BayerOrder::RGGB},
+    {cam::SGRBG8.fourcc(), BayerOrder::GRBG},
+    {cam::SGBRG8.fourcc(), BayerOrder::GBRG},
+    {cam::SBGGR8.fourcc(), BayerOrder::BGGR},
+    {cam::SRGGB16.fourcc(), BayerOrder::RGGB},
+    {cam::SGRBG16.fourcc(), BayerOrder::GRBG},
+    {cam::SGBRG16.fourcc(), BayerOrder::GBRG},
+    {cam::SBGGR16.fourcc(), BayerOrder::BGGR},
+  };
+
+  if (map_bayer_order.count(pixelformat.fourcc()))
+    return map_bayer_order.at(pixelformat.fourcc());
+
+  return std::nullopt;
+}
+
+std::vector<DefectPixel>
+load_defect_map(const std::string &path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+    throw std::runtime_error("could not open defect map \"" + path + "\"");
+
+  std::vector<DefectPixel> defects;
+  std::string              line;
+  std::size_t              line_number = 0;
+
+  while (std::getline(file, line)) {
+    line_number++;
+
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    std::istringstream ss(line);
+    int64_t            x, y;
+    if (!(ss >> x >> y) || x < 0 || y < 0)
+      throw std::runtime_error("malformed defect pixel at " + path + ":" + std::to_string(line_number));
+
+    defects.push_back({uint32_t(x), uint32_t(y)});
+  }
+
+  // row-major order keeps the correction pass sequential in memory
+  std::sort(defects.begin(), defects.end(), [](const DefectPixel &a, const DefectPixel &b) { return a.y < b.y || (a.y == b.y && a.x < b.x); });
+
+  return defects;
+}
+
+// black level indices (R = 0, Gr = 1, Gb = 2, B = 3) of the 2x2 CFA tile, indexed by [y & 1][x & 1]
+static const int cfa_tile[4][2][2] = {
+  {{0, 1}, {2, 3}},  // RGGB
+  {{1, 0}, {3, 2}},  // GRBG
+  {{2, 3}, {0, 1}},  // GBRG
+  {{3, 2}, {1, 0}},  // BGGR
+};
+
+template <typename T>
+static void
+correct_defects(uint8_t *dst, const std::size_t dst_step, const unsigned int width, const unsigned int height, const std::vector<DefectPixel> &defects)
+{
+  const auto at = [&](const uint32_t x, const uint32_t y) -> T & { return reinterpret_cast<T *>(dst + y * dst_step)[x]; };
+
+  for (const DefectPixel &p : defects) {
+    if (p.x >= width || p.y >= height)
+      continue;
+
+    // nearest samples of the same colour are two pixels away in both directions
+    uint32_t sum = 0;
+    uint32_t n   = 0;
+    if (p.x >= 2)
+      sum += at(p.x - 2, p.y), n++;
+    if (p.x + 2 < width)
+      sum += at(p.x + 2, p.y), n++;
+    if (p.y >= 2)
+      sum += at(p.x, p.y - 2), n++;
+    if (p.y + 2 < height)
+      sum += at(p.x, p.y + 2), n++;
+
+    if (n)
+      at(p.x, p.y) = T((sum + n / 2) / n);
+  }
+}
+
+template <typename T>
+static void
+copy_raw_corrected(const uint8_t *src, const std::size_t src_step, uint8_t *dst, const std::size_t dst_step, const unsigned int width,
+                   const unsigned int height, const BayerOrder order, const std::array<int32_t, 4> &black_levels, const std::vector<DefectPixel> &defects)
+{
+  // black levels are given in 16-bit scale
+  const int shift = 16 - 8 * int(sizeof(T));
+
+  T levels[2][2];
+  for (int y = 0; y < 2; y++)
+    for (int x = 0; x < 2; x++)
+      levels[y][x] = T(std::clamp(black_levels[cfa_tile[int(order)][y][x]], 0, 0xffff) >> shift);
+
+  const Kernels &k = kernels();
+
+  for (unsigned int y = 0; y < height; y++) {
+    const T *s = reinterpret_cast<const T *>(src + y * src_step);
+    T *      d = reinterpret_cast<T *>(dst + y * dst_step);
+
+    if constexpr (sizeof(T) == 1)
+      k.subtract_row_u8(s, d, width, levels[y & 1][0], levels[y & 1][1]);
+    else
+      k.subtract_row_u16(s, d, width, levels[y & 1][0], levels[y & 1][1]);
+  }
+
+  correct_defects<T>(dst, dst_step, width, height, defects);
+}
+
+void
+copy_raw_corrected(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int width, unsigned int height,
+                   unsigned int bits, BayerOrder order, const std::array<int32_t, 4> &black_levels, const std::vector<DefectPixel> &defects)
+{
+  switch (bits) {
+    case 8:
+      copy_raw_corrected<uint8_t>(src, src_step, dst, dst_step, width, height, order, black_levels, defects);
+      break;
+    case 16:
+      copy_raw_corrected<uint16_t>(src, src_step, dst, dst_step, width, height, order, black_levels, defects);
+      break;
+    default:
+      throw std::runtime_error("unsupported raw sample size of " + std::to_string(bits) + " bits");
+  }
+}
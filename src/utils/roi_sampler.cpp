@@ -0,0 +1,114 @@
+#include <libcamera_ros_driver/utils/roi_sampler.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+RoiSampler::RoiSampler(const RoiRect &rect, const double scale, const unsigned int image_width, const unsigned int image_height,
+                       const unsigned int bytes_per_pixel, const unsigned int block_width, const unsigned int block_height)
+    : bytes_per_pixel_(bytes_per_pixel), block_width_(std::max(block_width, 1u)), block_height_(std::max(block_height, 1u))
+{
+  if (!bytes_per_pixel_)
+    throw std::runtime_error("the image format can not be cropped");
+
+  if (!(scale > 0.0 && scale <= 1.0))
+    throw std::runtime_error("the scale must be in (0, 1]");
+
+  // an empty size extends the rectangle to the border of the image
+  const unsigned int x0 = std::min(rect.x, image_width) / block_width_ * block_width_;
+  const unsigned int y0 = std::min(rect.y, image_height) / block_height_ * block_height_;
+  const unsigned int x1 = rect.width ? std::min(rect.x + rect.width, image_width) : image_width;
+  const unsigned int y1 = rect.height ? std::min(rect.y + rect.height, image_height) : image_height;
+
+  rect_.x      = x0;
+  rect_.y      = y0;
+  rect_.width  = x1 > x0 ? (x1 - x0) / block_width_ * block_width_ : 0;
+  rect_.height = y1 > y0 ? (y1 - y0) / block_height_ * block_height_ : 0;
+
+  if (!rect_.width || !rect_.height)
+    throw std::runtime_error("the region is outside of the " + std::to_string(image_width) + "x" + std::to_string(image_height) + " image");
+
+  const unsigned int in_blocks_x  = rect_.width / block_width_;
+  const unsigned int in_blocks_y  = rect_.height / block_height_;
+  const unsigned int out_blocks_x = std::max(1u, unsigned(std::lround(in_blocks_x * scale)));
+  const unsigned int out_blocks_y = std::max(1u, unsigned(std::lround(in_blocks_y * scale)));
+
+  width_  = out_blocks_x * block_width_;
+  height_ = out_blocks_y * block_height_;
+
+  // every output block takes the source block under its centre
+  x_offsets_.resize(out_blocks_x);
+  for (unsigned int i = 0; i < out_blocks_x; i++) {
+    const unsigned int source = std::min(unsigned((i + 0.5) * in_blocks_x / out_blocks_x), in_blocks_x - 1);
+    x_offsets_[i]             = (rect_.x + source * block_width_) * bytes_per_pixel_;
+  }
+
+  y_rows_.resize(height_);
+  for (unsigned int i = 0; i < out_blocks_y; i++) {
+    const unsigned int source = std::min(unsigned((i + 0.5) * in_blocks_y / out_blocks_y), in_blocks_y - 1);
+    for (unsigned int r = 0; r < block_height_; r++) {
+      y_rows_[i * block_height_ + r] = rect_.y + source * block_height_ + r;
+    }
+  }
+}
+
+template <unsigned int BYTES>
+void
+RoiSampler::sampleRows(const uint8_t *src, const std::size_t src_step, uint8_t *dst) const
+{
+  // the fixed size lets the compiler replace the copies by single loads and stores
+  for (const uint32_t row : y_rows_) {
+    const uint8_t *in = src + std::size_t(row) * src_step;
+    for (const uint32_t offset : x_offsets_) {
+      std::memcpy(dst, in + offset, BYTES);
+      dst += BYTES;
+    }
+  }
+}
+
+void
+RoiSampler::sample(const uint8_t *src, const std::size_t src_step, uint8_t *dst) const
+{
+  const unsigned int bytes = block_width_ * bytes_per_pixel_;
+
+  // without scaling the rows of the crop are copied as a whole
+  if (width_ == rect_.width) {
+    const std::size_t offset = std::size_t(rect_.x) * bytes_per_pixel_;
+    for (const uint32_t row : y_rows_) {
+      std::memcpy(dst, src + std::size_t(row) * src_step + offset, step());
+      dst += step();
+    }
+    return;
+  }
+
+  switch (bytes) {
+    case 1:
+      sampleRows<1>(src, src_step, dst);
+      return;
+    case 2:
+      sampleRows<2>(src, src_step, dst);
+      return;
+    case 3:
+      sampleRows<3>(src, src_step, dst);
+      return;
+    case 4:
+      sampleRows<4>(src, src_step, dst);
+      return;
+    case 6:
+      sampleRows<6>(src, src_step, dst);
+      return;
+    case 8:
+      sampleRows<8>(src, src_step, dst);
+      return;
+  }
+
+  for (const uint32_t row : y_rows_) {
+    const uint8_t *in = src + std::size_t(row) * src_step;
+    for (const uint32_t offset : x_offsets_) {
+      std::memcpy(dst, in + offset, bytes);
+      dst += bytes;
+    }
+  }
+}
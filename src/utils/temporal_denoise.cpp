@@ -0,0 +1,48 @@
+#include <libcamera_ros_driver/utils/temporal_denoise.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+TemporalDenoise::TemporalDenoise(double strength, unsigned int motion_threshold, unsigned int threads) : stripes_(threads)
+{
+  // keep part of every new frame, a weight of 256 would freeze the image
+  strength_  = uint8_t(std::lround(std::clamp(strength, 0.0, 0.95) * 256));
+  threshold_ = uint8_t(std::clamp(motion_threshold, 1u, 255u));
+  slope_     = uint16_t((strength_ * 16 + threshold_ / 2) / threshold_);
+}
+
+void
+TemporalDenoise::reset()
+{
+  valid_ = false;
+}
+
+void
+TemporalDenoise::process(const uint8_t *src, std::size_t src_step, uint8_t *dst, std::size_t dst_step, unsigned int row_bytes, unsigned int height)
+{
+  if (!valid_ || row_bytes != row_bytes_ || height != height_) {
+    // start over from the current frame, the history is only reallocated when the layout grows
+    row_bytes_ = row_bytes;
+    height_    = height;
+    history_.resize(std::size_t(row_bytes) * height);
+
+    for (unsigned int y = 0; y < height; y++) {
+      std::memcpy(history_.data() + std::size_t(y) * row_bytes, src + y * src_step, row_bytes);
+      if (dst != src)
+        std::memcpy(dst + y * dst_step, src + y * src_step, row_bytes);
+    }
+
+    valid_ = true;
+    return;
+  }
+
+  const Kernels &k = kernels();
+
+  stripes_.run(height, [&](unsigned int begin, unsigned int end) {
+    for (unsigned int y = begin; y < end; y++) {
+      k.blend_row_u8(src + y * src_step, dst + y * dst_step, history_.data() + std::size_t(y) * row_bytes, row_bytes, strength_, threshold_, slope_);
+    }
+  });
+}
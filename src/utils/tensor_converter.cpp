@@ -0,0 +1,319 @@
+#include <libcamera_ros_driver/utils/tensor_converter.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+#include <sensor_msgs/image_encodings.h>
+
+
+namespace enc = sensor_msgs::image_encodings;
+
+// tensor pixels of a row interpolated into a buffer on the stack before they are normalized, and the source bytes
+// under them that are interpolated between two image rows first
+static constexpr unsigned int tensor_chunk = 256;
+static constexpr unsigned int tensor_span  = 4096;
+
+static std::string
+lower(std::string s)
+{
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+std::string
+to_string(const TensorLayout layout)
+{
+  switch (layout) {
+    case TensorLayout::NCHW:
+      return "NCHW";
+    case TensorLayout::NHWC:
+      return "NHWC";
+  }
+
+  return {};
+}
+
+std::string
+to_string(const TensorType type)
+{
+  switch (type) {
+    case TensorType::FLOAT32:
+      return "float32";
+    case TensorType::UINT8:
+      return "uint8";
+    case TensorType::INT8:
+      return "int8";
+  }
+
+  return {};
+}
+
+TensorLayout
+tensor_layout_from_string(const std::string &name)
+{
+  for (const TensorLayout layout : {TensorLayout::NCHW, TensorLayout::NHWC}) {
+    if (lower(to_string(layout)) == lower(name))
+      return layout;
+  }
+
+  throw std::runtime_error("unknown tensor layout \"" + name + "\"");
+}
+
+TensorType
+tensor_type_from_string(const std::string &name)
+{
+  for (const TensorType type : {TensorType::FLOAT32, TensorType::UINT8, TensorType::INT8}) {
+    if (to_string(type) == lower(name))
+      return type;
+  }
+
+  throw std::runtime_error("unknown tensor type \"" + name + "\"");
+}
+
+TensorConverter::TensorConverter(const TensorConfig &config, const unsigned int threads) : config_(config), stripes_(threads)
+{
+  if (!config_.width || !config_.height)
+    throw std::runtime_error("the tensor size must not be 0");
+
+  if (config_.type != TensorType::FLOAT32 && config_.quant_scale <= 0.0f)
+    throw std::runtime_error("the quantization scale must be positive");
+}
+
+bool
+TensorConverter::supports(const std::string &encoding)
+{
+  return encoding == enc::MONO8 || encoding == enc::RGB8 || encoding == enc::BGR8 || encoding == enc::RGBA8 || encoding == enc::BGRA8;
+}
+
+std::vector<uint32_t>
+TensorConverter::shape() const
+{
+  if (config_.layout == TensorLayout::NCHW)
+    return {1, channels_, config_.height, config_.width};
+
+  return {1, config_.height, config_.width, channels_};
+}
+
+std::size_t
+TensorConverter::bytes() const
+{
+  return std::size_t(channels_) * config_.width * config_.height * (config_.type == TensorType::FLOAT32 ? sizeof(float) : 1);
+}
+
+void
+TensorConverter::prepare(const unsigned int width, const unsigned int height, const std::string &encoding)
+{
+  if (!supports(encoding))
+    throw std::runtime_error("\"" + encoding + "\" images can not be converted to a tensor");
+
+  src_width_  = width;
+  src_height_ = height;
+  encoding_   = encoding;
+
+  // mono images give single-channel tensors, alpha is dropped
+  src_channels_ = enc::numChannels(encoding);
+  channels_     = encoding == enc::MONO8 ? 1 : 3;
+
+  const bool src_rgb = encoding == enc::RGB8 || encoding == enc::RGBA8;
+  for (unsigned int c = 0; c < channels_; c++) {
+    src_channel_[c] = channels_ == 1 || src_rgb == config_.rgb ? c : 2 - c;
+  }
+
+  // the image is scaled to fit and centred, the rest is border
+  Letterbox &l = letterbox_;
+  l.scale      = std::min(float(config_.width) / width, float(config_.height) / height);
+  l.width      = std::clamp<unsigned int>(std::lround(width * l.scale), 1, config_.width);
+  l.height     = std::clamp<unsigned int>(std::lround(height * l.scale), 1, config_.height);
+  l.offset_x   = (config_.width - l.width) / 2;
+  l.offset_y   = (config_.height - l.height) / 2;
+
+  // pixel centres of the tensor mapped back into the image
+  const auto sample = [](const unsigned int i, const unsigned int out, const unsigned int in, std::vector<uint32_t> &first, std::vector<uint32_t> &next,
+                         std::vector<uint16_t> &weight) {
+    const float    s  = std::clamp((i + 0.5f) * in / out - 0.5f, 0.0f, float(in - 1));
+    const uint32_t i0 = uint32_t(s);
+    first.push_back(i0);
+    next.push_back(std::min(i0 + 1, in - 1));
+    weight.push_back(uint16_t(std::lround((s - i0) * 256)));
+  };
+
+  x_offset_.clear();
+  x_next_.clear();
+  x_weight_.clear();
+  for (unsigned int x = 0; x < l.width; x++) {
+    sample(x, l.width, width, x_offset_, x_next_, x_weight_);
+  }
+
+  y_row_.clear();
+  y_next_.clear();
+  y_weight_.clear();
+  for (unsigned int y = 0; y < l.height; y++) {
+    sample(y, l.height, height, y_row_, y_next_, y_weight_);
+  }
+
+  // the byte offsets of the columns already include the pixel size
+  for (unsigned int x = 0; x < l.width; x++) {
+    x_offset_[x] *= src_channels_;
+    x_next_[x] *= src_channels_;
+  }
+
+  const int q_min = config_.type == TensorType::INT8 ? -128 : 0;
+  const int q_max = config_.type == TensorType::INT8 ? 127 : 255;
+
+  lut_byte_.resize(3 * 256);
+  for (unsigned int c = 0; c < 3; c++) {
+    for (unsigned int p = 0; p < 256; p++) {
+      const float value = (float(p) - config_.mean[c]) * config_.scale[c];
+      const int   q     = std::clamp(int(std::lround(value / config_.quant_scale)) + config_.quant_zero_point, q_min, q_max);
+
+      lut_byte_[c * 256 + p] = uint8_t(int8_t(q));  // the bit pattern of int8 values
+    }
+
+    pad_float_[c] = (float(config_.pad) - config_.mean[c]) * config_.scale[c];
+    pad_byte_[c]  = lut_byte_[c * 256 + config_.pad];
+  }
+
+  // (value / 256 - mean) * scale as one multiply-add on the interpolated value
+  chunk_scale_.resize(3 * tensor_chunk);
+  chunk_offset_.resize(3 * tensor_chunk);
+  for (unsigned int c = 0; c < channels_; c++) {
+    for (unsigned int i = 0; i < tensor_chunk; i++) {
+      const std::size_t e = config_.layout == TensorLayout::NCHW ? c * tensor_chunk + i : i * channels_ + c;
+      chunk_scale_[e]     = config_.scale[c] / 256;
+      chunk_offset_[e]    = -config_.mean[c] * config_.scale[c];
+    }
+  }
+}
+
+template <TensorLayout LAYOUT, typename T>
+void
+TensorConverter::convertRows(const uint8_t *src, const std::size_t src_step, T *dst, const unsigned int begin, const unsigned int end) const
+{
+  constexpr bool planar = LAYOUT == TensorLayout::NCHW;
+
+  const Letterbox &  l        = letterbox_;
+  const unsigned int width    = config_.width;
+  const unsigned int channels = channels_;
+  const std::size_t  plane    = std::size_t(config_.width) * config_.height;
+
+  std::array<T, 3> pad;
+  for (unsigned int c = 0; c < 3; c++) {
+    if constexpr (std::is_same_v<T, float>)
+      pad[c] = pad_float_[c];
+    else
+      pad[c] = pad_byte_[c];
+  }
+
+  const Kernels &k = kernels();
+
+  // source bytes of a chunk interpolated between two image rows, and the values of the chunk with 8 fractional bits
+  // in the layout of the tensor
+  uint16_t span[tensor_span];
+  uint16_t values[3 * tensor_chunk];
+
+  for (unsigned int y = begin; y < end; y++) {
+
+    // the channel planes of the row, or its interleaved pixels
+    T *const row = planar ? dst + std::size_t(y) * width : dst + std::size_t(y) * width * channels;
+
+    const auto fill = [&](const unsigned int x_begin, const unsigned int x_end) {
+      if constexpr (planar) {
+        for (unsigned int c = 0; c < channels; c++)
+          std::fill(row + c * plane + x_begin, row + c * plane + x_end, pad[c]);
+      } else {
+        for (unsigned int x = x_begin; x < x_end; x++)
+          for (unsigned int c = 0; c < channels; c++)
+            row[x * channels + c] = pad[c];
+      }
+    };
+
+    if (y < l.offset_y || y >= l.offset_y + l.height) {
+      fill(0, width);
+      continue;
+    }
+
+    fill(0, l.offset_x);
+    fill(l.offset_x + l.width, width);
+
+    const unsigned int iy = y - l.offset_y;
+    const uint8_t *    r0 = src + y_row_[iy] * src_step;
+    const uint8_t *    r1 = src + y_next_[iy] * src_step;
+    const uint16_t     wy = y_weight_[iy];
+
+    for (unsigned int chunk = 0; chunk < l.width;) {
+
+      // as many pixels as the span of their source bytes fits, at least one
+      const uint32_t first = x_offset_[chunk];
+      unsigned int   n     = 1;
+      while (n < tensor_chunk && chunk + n < l.width && x_next_[chunk + n] + src_channels_ - first <= tensor_span)
+        n++;
+
+      // bilinear in 8-bit fixed point: the vertical step on the source bytes, the horizontal one per tensor pixel,
+      // all channels of a pixel from the same two columns
+      k.lerp_rows_u8(r0 + first, r1 + first, span, x_next_[chunk + n - 1] + src_channels_ - first, wy);
+
+      for (unsigned int i = 0; i < n; i++) {
+        const uint16_t *p0 = span + x_offset_[chunk + i] - first;
+        const uint16_t *p1 = span + x_next_[chunk + i] - first;
+        const uint32_t  wx = x_weight_[chunk + i];
+
+        for (unsigned int c = 0; c < channels; c++) {
+          const unsigned int sc = src_channel_[c];
+
+          values[planar ? c * tensor_chunk + i : i * channels + c] = uint16_t((p0[sc] * (256 - wx) + p1[sc] * wx) >> 8);
+        }
+      }
+
+      T *const out = row + (planar ? l.offset_x + chunk : (l.offset_x + chunk) * channels);
+
+      if constexpr (std::is_same_v<T, float>) {
+        if constexpr (planar) {
+          for (unsigned int c = 0; c < channels; c++) {
+            const std::size_t e = c * tensor_chunk;
+            k.normalize_row_f32(values + e, out + c * plane, n, chunk_scale_.data() + e, chunk_offset_.data() + e);
+          }
+        } else {
+          k.normalize_row_f32(values, out, n * channels, chunk_scale_.data(), chunk_offset_.data());
+        }
+      } else {
+        // rounded to the pixel value that indexes the table, the same as rounding the bilinear sum once
+        if constexpr (planar) {
+          for (unsigned int c = 0; c < channels; c++)
+            for (unsigned int i = 0; i < n; i++)
+              out[c * plane + i] = lut_byte_[c * 256 + ((values[c * tensor_chunk + i] + 128) >> 8)];
+        } else {
+          for (unsigned int i = 0; i < n; i++)
+            for (unsigned int c = 0; c < channels; c++)
+              out[i * channels + c] = lut_byte_[c * 256 + ((values[i * channels + c] + 128) >> 8)];
+        }
+      }
+
+      chunk += n;
+    }
+  }
+}
+
+void
+TensorConverter::convert(const uint8_t *src, const std::size_t src_step, const unsigned int width, const unsigned int height, const std::string &encoding,
+                         uint8_t *dst)
+{
+  if (width != src_width_ || height != src_height_ || encoding != encoding_)
+    prepare(width, height, encoding);
+
+  const bool   nchw      = config_.layout == TensorLayout::NCHW;
+  float *const dst_float = reinterpret_cast<float *>(dst);
+
+  stripes_.run(config_.height, [&](unsigned int begin, unsigned int end) {
+    if (config_.type == TensorType::FLOAT32 && nchw)
+      convertRows<TensorLayout::NCHW, float>(src, src_step, dst_float, begin, end);
+    else if (config_.type == TensorType::FLOAT32)
+      convertRows<TensorLayout::NHWC, float>(src, src_step, dst_float, begin, end);
+    else if (nchw)
+      convertRows<TensorLayout::NCHW, uint8_t>(src, src_step, dst, begin, end);
+    else
+      convertRows<TensorLayout::NHWC, uint8_t>(src, src_step, dst, begin, end);
+  });
+}
@@ -0,0 +1,70 @@
+#include <libcamera_ros_driver/utils/test_pattern.h>
+#include <algorithm>
+#include <cstring>
+
+
+static constexpr uint8_t watermark_magic[4] = {'L', 'C', 'T', 'P'};
+
+void
+write_test_pattern(uint8_t *data, const std::size_t step, const std::size_t rows, const uint64_t sequence)
+{
+  for (std::size_t y = 0; y < rows; y++) {
+    uint8_t *     row   = data + y * step;
+    const uint8_t start = uint8_t(7 * y + sequence);
+    for (std::size_t i = 0; i < step; i++) {
+      row[i] = uint8_t(start + i);
+    }
+  }
+
+  if (rows == 0 || step < test_pattern_watermark_bytes)
+    return;
+
+  std::memcpy(data, watermark_magic, sizeof(watermark_magic));
+  for (std::size_t b = 0; b < 8; b++) {
+    data[4 + b] = uint8_t(sequence >> (8 * b));
+  }
+  std::memset(data + 12, 0, 4);
+}
+
+std::optional<uint64_t>
+read_test_pattern_watermark(const uint8_t *data, const std::size_t size)
+{
+  if (size < test_pattern_watermark_bytes || std::memcmp(data, watermark_magic, sizeof(watermark_magic)) != 0)
+    return std::nullopt;
+
+  uint64_t sequence = 0;
+  for (std::size_t b = 0; b < 8; b++) {
+    sequence |= uint64_t(data[4 + b]) << (8 * b);
+  }
+
+  return sequence;
+}
+
+std::size_t
+check_test_pattern(const uint8_t *data, const std::size_t step, const std::size_t rows, const uint64_t sequence)
+{
+  std::size_t wrong = 0;
+
+  for (std::size_t y = 0; y < rows; y++) {
+    const uint8_t *   row   = data + y * step;
+    const uint8_t     start = uint8_t(7 * y + sequence);
+    const std::size_t first = y == 0 ? std::min(step, test_pattern_watermark_bytes) : 0;
+    for (std::size_t i = first; i < step; i++) {
+      wrong += row[i] != uint8_t(start + i);
+    }
+  }
+
+  return wrong;
+}
+
+uint64_t
+hash_bytes(const uint8_t *data, const std::size_t size)
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  for (std::size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+
+  return hash;
+}
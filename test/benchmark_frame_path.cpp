@@ -0,0 +1,228 @@
+// Google Benchmark of the frame path without camera and ROS: the copy out of the camera buffer and the conversions
+// for every raw format at the resolutions of the lq, hq and uhq presets, and the control value helpers that validate
+// the parameters and commands; reports the time per frame and the throughput
+//
+//   rosrun libcamera_ros_driver benchmark_frame_path --benchmark_filter=FrameCopy/RGB888
+
+#include <libcamera_ros_driver/utils/clamp.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/mock_backend.h>
+#include <libcamera_ros_driver/utils/pv_to_cv.h>
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <array>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/span.h>
+#include <libcamera/controls.h>
+#include <libcamera/geometry.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <benchmark/benchmark.h>
+
+namespace enc = sensor_msgs::image_encodings;
+
+struct Preset
+{
+  const char *    name;
+  libcamera::Size size;  // resolution of config/<name>.yaml
+};
+
+static const std::array<Preset, 3> presets = {{
+    {"lq", {1333, 990}},
+    {"hq", {2028, 1520}},
+    {"uhq", {4056, 3040}},
+}};
+
+// frame as delivered by the mock camera, rows padded to its stride alignment, and the message data it is copied into
+struct Frame
+{
+  Frame(const libcamera::PixelFormat &format, const libcamera::Size &size, const bool remove_stride) : size(size) {
+    const unsigned int alignment = MockBackendOptions().stride_alignment;
+
+    bytes_per_pixel = get_bytes_per_pixel(format);
+    stride          = (size.width * bytes_per_pixel + alignment - 1) / alignment * alignment;
+    step            = remove_stride ? size.width * bytes_per_pixel : stride;
+
+    std::mt19937 rng(0);
+    src.resize(std::size_t(stride) * size.height);
+    for (uint8_t &e : src)
+      e = uint8_t(rng());
+
+    // resized once like the pooled messages, the benchmark measures the copy and not the allocation
+    dst.resize(std::size_t(step) * size.height);
+  }
+
+  libcamera::Size      size;
+  unsigned int         bytes_per_pixel;
+  unsigned int         stride;
+  unsigned int         step;
+  std::vector<uint8_t> src;
+  std::vector<uint8_t> dst;
+};
+
+static void
+report(benchmark::State &state, const Frame &frame)
+{
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.dst.size()));
+  state.counters["fps"] = benchmark::Counter(double(state.iterations()), benchmark::Counter::kIsRate);
+  state.SetLabel(to_string(kernels().backend));
+}
+
+// the copy of the driver without any correction: a single copy of the padded frame, or the rows without their padding
+static void
+BM_FrameCopy(benchmark::State &state, const libcamera::PixelFormat &format, const libcamera::Size &size, const bool remove_stride)
+{
+  Frame frame(format, size, remove_stride);
+
+  for (auto _ : state) {
+    if (remove_stride)
+      kernels().copy_rows(frame.src.data(), frame.stride, frame.dst.data(), frame.step, frame.step, size.height);
+    else
+      std::memcpy(frame.dst.data(), frame.src.data(), frame.src.size());
+    benchmark::ClobberMemory();
+  }
+
+  report(state, frame);
+}
+
+// black level subtraction and defect pixel replacement of the Bayer formats while copying
+static void
+BM_RawCorrection(benchmark::State &state, const libcamera::PixelFormat &format, const libcamera::Size &size, const bool remove_stride)
+{
+  Frame                          frame(format, size, remove_stride);
+  const BayerOrder               order        = *get_bayer_order(format);
+  const std::array<int32_t, 4>   black_levels = {4096, 4096, 4096, 4096};
+  const std::vector<DefectPixel> defects      = {{10, 10}, {size.width / 2, size.height / 2}, {size.width - 3, size.height - 3}};
+
+  for (auto _ : state) {
+    copy_raw_corrected(frame.src.data(), frame.stride, frame.dst.data(), frame.step, size.width, size.height, 8 * frame.bytes_per_pixel, order,
+                       black_levels, defects);
+    benchmark::ClobberMemory();
+  }
+
+  report(state, frame);
+}
+
+// 3D colour LUT of the 8-bit RGB formats, with the grid size of the common .cube files
+static void
+BM_ColorLut(benchmark::State &state, const libcamera::PixelFormat &format, const libcamera::Size &size, const bool remove_stride)
+{
+  const std::string encoding = get_ros_encoding(format);
+  const bool        bgr      = encoding == enc::BGR8 || encoding == enc::BGRA8;
+
+  constexpr unsigned int lut_size = 33;
+  std::vector<uint16_t>  table(3 * lut_size * lut_size * lut_size);
+  std::mt19937           rng(0);
+  for (uint16_t &e : table)
+    e = uint16_t(rng() % (255 << 8));
+  const ColorLut3D lut = make_color_lut(lut_size, std::move(table));
+
+  Frame frame(format, size, remove_stride);
+
+  for (auto _ : state) {
+    apply_color_lut(lut, frame.src.data(), frame.stride, frame.dst.data(), frame.step, size.width, size.height, enc::numChannels(encoding), bgr);
+    benchmark::ClobberMemory();
+  }
+
+  report(state, frame);
+}
+
+// control values of the types the parameters and commands of the driver are converted to
+static std::vector<std::pair<std::string, std::array<libcamera::ControlValue, 3>>>
+control_values()
+{
+  const std::array<int64_t, 2> durations     = {33333, 33333};
+  const std::array<int64_t, 2> durations_min = {1000, 1000};
+  const std::array<int64_t, 2> durations_max = {1000000, 1000000};
+
+  // value, min and max
+  return {
+      {"Integer32", {libcamera::ControlValue(int32_t(20000)), libcamera::ControlValue(int32_t(1)), libcamera::ControlValue(int32_t(1000000))}},
+      {"Float", {libcamera::ControlValue(2.5f), libcamera::ControlValue(1.0f), libcamera::ControlValue(16.0f)}},
+      {"Integer64Array",
+       {libcamera::ControlValue(libcamera::Span<const int64_t>(durations)), libcamera::ControlValue(libcamera::Span<const int64_t>(durations_min)),
+        libcamera::ControlValue(libcamera::Span<const int64_t>(durations_max))}},
+      {"Rectangle",
+       {libcamera::ControlValue(libcamera::Rectangle(100, 100, 1920, 1080)), libcamera::ControlValue(libcamera::Rectangle(0, 0, 64, 64)),
+        libcamera::ControlValue(libcamera::Rectangle(0, 0, 4056, 3040))}},
+  };
+}
+
+static void
+BM_Clamp(benchmark::State &state, const std::array<libcamera::ControlValue, 3> &values)
+{
+  for (auto _ : state) {
+    libcamera::ControlValue clamped = clamp(values[0], values[1], values[2]);
+    benchmark::DoNotOptimize(clamped);
+  }
+}
+
+static void
+BM_Less(benchmark::State &state, const std::array<libcamera::ControlValue, 3> &values)
+{
+  for (auto _ : state) {
+    bool less = values[0] < values[2];
+    benchmark::DoNotOptimize(less);
+  }
+}
+
+template <typename T>
+static void
+BM_PvToCv(benchmark::State &state, const T &parameter, const libcamera::ControlType type)
+{
+  for (auto _ : state) {
+    libcamera::ControlValue value = pv_to_cv(parameter, type);
+    benchmark::DoNotOptimize(value);
+  }
+}
+
+static void
+register_benchmarks()
+{
+  for (const libcamera::PixelFormat &format : get_raw_formats()) {
+    const std::string encoding = get_ros_encoding(format);
+    const bool        lut      = enc::bitDepth(encoding) == 8 && (enc::numChannels(encoding) == 3 || enc::numChannels(encoding) == 4);
+
+    for (const Preset &preset : presets) {
+      for (const bool remove_stride : {false, true}) {
+        const std::string suffix = "/" + format.toString() + "/" + preset.name + (remove_stride ? "/remove_stride" : "/stride");
+
+        benchmark::RegisterBenchmark(("FrameCopy" + suffix).c_str(), BM_FrameCopy, format, preset.size, remove_stride)->Unit(benchmark::kMillisecond);
+
+        if (get_bayer_order(format))
+          benchmark::RegisterBenchmark(("RawCorrection" + suffix).c_str(), BM_RawCorrection, format, preset.size, remove_stride)->Unit(benchmark::kMillisecond);
+
+        if (lut)
+          benchmark::RegisterBenchmark(("ColorLut" + suffix).c_str(), BM_ColorLut, format, preset.size, remove_stride)->Unit(benchmark::kMillisecond);
+      }
+    }
+  }
+
+  for (const auto &[name, values] : control_values()) {
+    benchmark::RegisterBenchmark(("Clamp/" + name).c_str(), BM_Clamp, values);
+    benchmark::RegisterBenchmark(("Less/" + name).c_str(), BM_Less, values);
+  }
+
+  benchmark::RegisterBenchmark("PvToCv/Integer32", BM_PvToCv<int>, 20000, libcamera::ControlTypeInteger32);
+  benchmark::RegisterBenchmark("PvToCv/Float", BM_PvToCv<double>, 2.5, libcamera::ControlTypeFloat);
+  benchmark::RegisterBenchmark("PvToCv/Integer64Array", BM_PvToCv<std::vector<int64_t>>, std::vector<int64_t>{33333, 33333}, libcamera::ControlTypeInteger64);
+  benchmark::RegisterBenchmark("PvToCv/Rectangle", BM_PvToCv<std::vector<int64_t>>, std::vector<int64_t>{100, 100, 1920, 1080}, libcamera::ControlTypeRectangle);
+  benchmark::RegisterBenchmark("PvToCv/FloatArray", BM_PvToCv<std::vector<double>>, std::vector<double>{1.5, 2.0}, libcamera::ControlTypeFloat);
+}
+
+int
+main(int argc, char **argv)
+{
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  register_benchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,175 @@
+// the processing stages of the frame path must not allocate once the first frames are through: frames of the mock
+// camera are processed like in the driver with the allocation counter linked in front of the C library, and the
+// allocations of the frame thread are counted for every frame after the warm-up
+
+#include <libcamera_ros_driver/utils/allocation_counter.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/mock_backend.h>
+#include <libcamera_ros_driver/utils/raw_correction.h>
+#include <libcamera_ros_driver/utils/temporal_denoise.h>
+#include <libcamera_ros_driver/utils/tensor_converter.h>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <libcamera/formats.h>
+
+#include <gtest/gtest.h>
+
+// processes a frame of the stream into the preallocated output, like the driver into a pooled message
+using stage_t = std::function<void(const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output)>;
+
+static constexpr unsigned int warmup_frames   = 5;
+static constexpr unsigned int measured_frames = 50;
+
+// allocations of the frame thread per frame after the warm-up, with the stream in 'format' of a typical sensor size
+static double
+allocations_per_frame(const libcamera::PixelFormat &format, const std::size_t output_bytes, const stage_t &stage)
+{
+  MockBackendOptions options;
+  options.formats = {format};
+  MockBackend backend(options);
+
+  StreamRequest request;
+  request.pixel_format    = format.toString();
+  request.size            = {1333, 990};
+  const StreamInfo stream = backend.configure(request);
+
+  ControlCommandValues values;
+  values.set[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)]    = true;
+  values.values[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)] = {5000.0, 5000.0};
+  backend.queueControls(values);
+
+  std::vector<uint8_t> output(output_bytes ? output_bytes : stream.frame_bytes);
+
+  std::mutex              mutex;
+  std::condition_variable cv;
+  unsigned int            frames      = 0;
+  uint64_t                allocations = 0;
+
+  backend.start(
+      [&](const FrameView &frame) {
+        const uint64_t before = thread_allocations().value_or(0);
+        stage(stream, frame, output);
+        const uint64_t after = thread_allocations().value_or(0);
+
+        std::scoped_lock lock(mutex);
+        if (frames >= warmup_frames && frames < warmup_frames + measured_frames)
+          allocations += after - before;
+        frames++;
+        cv.notify_all();
+      },
+      [](const std::string &) {});
+
+  bool done;
+  {
+    std::unique_lock lock(mutex);
+    done = cv.wait_for(lock, std::chrono::seconds(60), [&] { return frames >= warmup_frames + measured_frames; });
+  }
+  backend.stop();
+
+  EXPECT_TRUE(done) << "the mock camera delivered " << frames << " frames";
+  return double(allocations) / measured_frames;
+}
+
+// the copy without the row padding, every stage starts from it or replaces it
+static void
+copy_frame(const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output)
+{
+  const unsigned int row_bytes = stream.size.width * get_bytes_per_pixel(stream.format);
+  kernels().copy_rows(frame.data, stream.stride, output.data(), row_bytes, row_bytes, stream.size.height);
+}
+
+class Allocations : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_TRUE(thread_allocations()) << "the allocation counter is not loaded";
+
+    // and it counts
+    const uint64_t before = *thread_allocations();
+    void *volatile heap   = std::malloc(64);
+    std::free(heap);
+    ASSERT_EQ(*thread_allocations() - before, 1u);
+  }
+};
+
+TEST_F(Allocations, Copy) {
+  EXPECT_EQ(allocations_per_frame(libcamera::formats::RGB888, 0, copy_frame), 0.0);
+}
+
+TEST_F(Allocations, TemporalDenoise) {
+  TemporalDenoise denoise(0.5, 20, 2);
+
+  // filtered in place after the copy, like in the driver
+  EXPECT_EQ(allocations_per_frame(libcamera::formats::RGB888, 0,
+                                  [&](const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output) {
+                                    copy_frame(stream, frame, output);
+                                    const unsigned int row_bytes = stream.size.width * get_bytes_per_pixel(stream.format);
+                                    denoise.process(output.data(), row_bytes, output.data(), row_bytes, row_bytes, stream.size.height);
+                                  }),
+            0.0);
+}
+
+TEST_F(Allocations, ColorLut) {
+  constexpr unsigned int size = 17;
+  std::vector<uint16_t>  table(3 * size * size * size);
+  std::mt19937           rng(0);
+  for (uint16_t &e : table)
+    e = uint16_t(rng() % (255 << 8));
+  const ColorLut3D lut = make_color_lut(size, std::move(table));
+
+  EXPECT_EQ(allocations_per_frame(libcamera::formats::RGB888, 0,
+                                  [&](const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output) {
+                                    apply_color_lut(lut, frame.data, stream.stride, output.data(), stream.size.width * 3, stream.size.width,
+                                                    stream.size.height, 3, true);
+                                  }),
+            0.0);
+}
+
+TEST_F(Allocations, RawCorrection) {
+  const std::vector<DefectPixel> defects = {{10, 10}, {600, 400}, {1300, 980}};
+
+  EXPECT_EQ(allocations_per_frame(libcamera::formats::SRGGB16, 0,
+                                  [&](const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output) {
+                                    copy_raw_corrected(frame.data, stream.stride, output.data(), stream.size.width * 2, stream.size.width,
+                                                       stream.size.height, 16, BayerOrder::RGGB, frame.black_levels.value_or(std::array<int32_t, 4>{}),
+                                                       defects);
+                                  }),
+            0.0);
+}
+
+TEST_F(Allocations, Tensor) {
+  const std::string encoding = get_ros_encoding(libcamera::formats::RGB888);
+
+  for (const TensorType type : {TensorType::FLOAT32, TensorType::UINT8}) {
+    for (const TensorLayout layout : {TensorLayout::NCHW, TensorLayout::NHWC}) {
+      SCOPED_TRACE(to_string(type) + " " + to_string(layout));
+
+      TensorConfig config;
+      config.type   = type;
+      config.layout = layout;
+      TensorConverter converter(config, 2);
+
+      EXPECT_EQ(allocations_per_frame(libcamera::formats::RGB888, std::size_t(config.width) * config.height * 3 * sizeof(float),
+                                      [&](const StreamInfo &stream, const FrameView &frame, std::vector<uint8_t> &output) {
+                                        converter.convert(frame.data, stream.stride, stream.size.width, stream.size.height, encoding, output.data());
+                                      }),
+                0.0);
+    }
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
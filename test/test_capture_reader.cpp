@@ -0,0 +1,246 @@
+// capture files written by FrameRecorder and read back by CaptureReader: lookups, zero-copy access, the embedded
+// stream configuration and camera info, and the recovery of the index of an interrupted recording
+
+#include <libcamera_ros_driver/utils/capture_reader.h>
+#include <libcamera_ros_driver/utils/frame_recorder.h>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <ros/serialization.h>
+#include <sensor_msgs/CameraInfo.h>
+
+#include <gtest/gtest.h>
+
+static constexpr std::size_t  frame_bytes = 3 * 64 * 48;
+static constexpr unsigned int frames      = 12;
+
+// sequence numbers with gaps like after dropped frames, timestamps of a 10 ms frame period
+static uint64_t
+sequence_of(const unsigned int i)
+{
+  return 100 + 2 * i;
+}
+
+static uint64_t
+timestamp_of(const unsigned int i)
+{
+  return 5000000000ull + i * 10000000ull;
+}
+
+static uint8_t
+sample(const uint64_t sequence, const std::size_t i)
+{
+  return uint8_t(sequence * 31 + i * 7);
+}
+
+static sensor_msgs::CameraInfo
+camera_info()
+{
+  sensor_msgs::CameraInfo info;
+  info.header.frame_id  = "camera_optical";
+  info.width            = 64;
+  info.height           = 48;
+  info.distortion_model = "plumb_bob";
+  info.D                = {-0.1, 0.01, 0.0, 0.0, 0.0};
+  info.K                = {100.0, 0.0, 32.0, 0.0, 100.0, 24.0, 0.0, 0.0, 1.0};
+  return info;
+}
+
+class CaptureReaderTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "capture_reader_" + std::to_string(getpid()) + ".lcrcap";
+
+    CaptureFileHeader header = {};
+    header.width             = 64;
+    header.height            = 48;
+    header.stride            = 64 * 3;
+    header.fourcc            = 0x34324752;  // RG24
+    std::strncpy(header.encoding, "bgr8", sizeof(header.encoding) - 1);
+    std::strncpy(header.frame_id, "camera_optical", sizeof(header.frame_id) - 1);
+
+    const sensor_msgs::CameraInfo info = camera_info();
+    std::vector<uint8_t>          serialized(ros::serialization::serializationLength(info));
+    ros::serialization::OStream   stream(serialized.data(), serialized.size());
+    ros::serialization::serialize(stream, info);
+
+    // a slot per frame, no frame is dropped
+    FrameRecorder recorder(frame_bytes, frames);
+    recorder.start(path_, header, serialized);
+
+    std::vector<uint8_t> data(frame_bytes);
+    for (unsigned int i = 0; i < frames; i++) {
+      for (std::size_t j = 0; j < frame_bytes; j++)
+        data[j] = sample(sequence_of(i), j);
+
+      FrameRecordHeader record = {};
+      record.sequence          = sequence_of(i);
+      record.timestamp         = timestamp_of(i);
+      record.exposure_time     = 1000 + i;
+      ASSERT_TRUE(recorder.push(data.data(), data.size(), record));
+    }
+
+    recorder.stop();
+    ASSERT_EQ(recorder.written(), frames);
+    ASSERT_EQ(recorder.failed(), 0u);
+  }
+
+  void TearDown() override {
+    std::remove(path_.c_str());
+  }
+
+  // the frame carries the samples of its sequence number
+  static void expectFrame(const CaptureFrame &frame, const unsigned int i) {
+    EXPECT_EQ(frame.header->sequence, sequence_of(i));
+    EXPECT_EQ(frame.header->timestamp, timestamp_of(i));
+    EXPECT_EQ(frame.header->exposure_time, int32_t(1000 + i));
+    ASSERT_EQ(frame.size, frame_bytes);
+    for (std::size_t j = 0; j < frame_bytes; j++) {
+      ASSERT_EQ(frame.data[j], sample(sequence_of(i), j)) << "sample " << j << " of frame " << i;
+    }
+  }
+
+  std::string path_;
+};
+
+TEST_F(CaptureReaderTest, LooksUpFramesBySequence) {
+  const CaptureReader reader(path_);
+
+  ASSERT_EQ(reader.size(), frames);
+  EXPECT_FALSE(reader.recovered());
+
+  for (unsigned int i = 0; i < frames; i++) {
+    const std::optional<CaptureFrame> frame = reader.findSequence(sequence_of(i));
+    ASSERT_TRUE(frame) << "sequence " << sequence_of(i);
+    expectFrame(*frame, i);
+  }
+
+  // the gaps and both ends
+  EXPECT_FALSE(reader.findSequence(sequence_of(3) + 1));
+  EXPECT_FALSE(reader.findSequence(0));
+  EXPECT_FALSE(reader.findSequence(sequence_of(frames)));
+}
+
+TEST_F(CaptureReaderTest, LooksUpFramesByTimestamp) {
+  const CaptureReader reader(path_);
+
+  for (unsigned int i = 0; i < frames; i++) {
+    const std::optional<CaptureFrame> exact = reader.findTimestamp(timestamp_of(i));
+    ASSERT_TRUE(exact);
+    EXPECT_EQ(exact->header->sequence, sequence_of(i));
+
+    // between two frames the later one is returned
+    const std::optional<CaptureFrame> after = reader.findTimestamp(timestamp_of(i) - 1);
+    ASSERT_TRUE(after);
+    EXPECT_EQ(after->header->sequence, sequence_of(i));
+  }
+
+  EXPECT_EQ(reader.findTimestamp(0)->header->sequence, sequence_of(0));
+  EXPECT_FALSE(reader.findTimestamp(timestamp_of(frames - 1) + 1));
+}
+
+TEST_F(CaptureReaderTest, ReturnsFramesWithoutCopying) {
+  const CaptureReader reader(path_);
+
+  // the data directly follows its record header in the mapping, the records are 'record_size' apart
+  for (unsigned int i = 0; i < frames; i++) {
+    const CaptureFrame frame = reader.frame(i);
+    EXPECT_EQ(frame.data, reinterpret_cast<const uint8_t *>(frame.header) + sizeof(FrameRecordHeader));
+    EXPECT_EQ(reader.findSequence(sequence_of(i))->data, frame.data);
+
+    if (i > 0) {
+      EXPECT_EQ(std::size_t(frame.data - reader.frame(i - 1).data), reader.header().record_size);
+    }
+  }
+
+  // the records are aligned in the file, and so in the mapping
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(reader.frame(0).header) % capture_alignment, 0u);
+
+  EXPECT_THROW(reader.frame(frames), std::out_of_range);
+}
+
+TEST_F(CaptureReaderTest, StoresTheStreamConfiguration) {
+  const CaptureReader      reader(path_);
+  const CaptureFileHeader &header = reader.header();
+
+  EXPECT_EQ(header.version, capture_version);
+  EXPECT_EQ(header.width, 64u);
+  EXPECT_EQ(header.height, 48u);
+  EXPECT_EQ(header.stride, 64u * 3);
+  EXPECT_EQ(header.fourcc, 0x34324752u);
+  EXPECT_EQ(header.frame_bytes, frame_bytes);
+  EXPECT_STREQ(header.encoding, "bgr8");
+  EXPECT_STREQ(header.frame_id, "camera_optical");
+
+  const std::optional<sensor_msgs::CameraInfo> info = reader.cameraInfo();
+  ASSERT_TRUE(info);
+
+  const sensor_msgs::CameraInfo expected = camera_info();
+  EXPECT_EQ(info->header.frame_id, expected.header.frame_id);
+  EXPECT_EQ(info->width, expected.width);
+  EXPECT_EQ(info->height, expected.height);
+  EXPECT_EQ(info->distortion_model, expected.distortion_model);
+  EXPECT_EQ(info->D, expected.D);
+  EXPECT_EQ(info->K, expected.K);
+}
+
+TEST_F(CaptureReaderTest, RecoversTheIndexOfATruncatedFile) {
+  std::size_t record_size, header_size;
+  {
+    const CaptureReader reader(path_);
+    record_size = reader.header().record_size;
+    header_size = reader.header().header_size;
+  }
+
+  // without the index and the footer, as after a recording that was killed
+  ASSERT_EQ(truncate(path_.c_str(), header_size + frames * record_size), 0);
+  {
+    const CaptureReader reader(path_);
+    EXPECT_TRUE(reader.recovered());
+    ASSERT_EQ(reader.size(), frames);
+
+    for (unsigned int i = 0; i < frames; i++) {
+      const std::optional<CaptureFrame> frame = reader.findSequence(sequence_of(i));
+      ASSERT_TRUE(frame);
+      expectFrame(*frame, i);
+    }
+    EXPECT_EQ(reader.findTimestamp(timestamp_of(5))->header->sequence, sequence_of(5));
+  }
+
+  // a partially written last record is left out
+  ASSERT_EQ(truncate(path_.c_str(), header_size + (frames - 1) * record_size + record_size / 2), 0);
+  {
+    const CaptureReader reader(path_);
+    EXPECT_TRUE(reader.recovered());
+    ASSERT_EQ(reader.size(), frames - 1);
+    EXPECT_FALSE(reader.findSequence(sequence_of(frames - 1)));
+    expectFrame(*reader.findSequence(sequence_of(frames - 2)), frames - 2);
+  }
+}
+
+TEST(CaptureReader, RejectsOtherFiles) {
+  const std::string path = ::testing::TempDir() + "capture_reader_invalid_" + std::to_string(getpid());
+
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  const std::vector<uint8_t> zeros(2 * capture_alignment, 0);
+  std::fwrite(zeros.data(), 1, zeros.size(), file);
+  std::fclose(file);
+
+  EXPECT_THROW(CaptureReader reader(path), std::runtime_error);
+  EXPECT_THROW(CaptureReader reader(path + ".missing"), std::runtime_error);
+
+  std::remove(path.c_str());
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,226 @@
+// every pixel kernel of every backend that is compiled in and supported by the CPU has to produce the same
+// output as the scalar reference, on randomized rows of all widths and alignments
+
+#include <libcamera_ros_driver/utils/kernels.h>
+#include <libcamera_ros_driver/utils/color_lut.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+template <typename T>
+static std::vector<T>
+random_vector(std::mt19937 &rng, const std::size_t n)
+{
+  std::uniform_int_distribution<uint32_t> dist(0, std::numeric_limits<T>::max());
+  std::vector<T>                          v(n);
+  for (T &e : v)
+    e = T(dist(rng));
+  return v;
+}
+
+class KernelsTest : public ::testing::TestWithParam<KernelBackend> {
+protected:
+  void SetUp() override {
+    candidate_ = kernels_for(GetParam());
+
+    if (!candidate_)
+      GTEST_SKIP() << to_string(GetParam()) << " is not compiled for this architecture";
+
+    const std::vector<KernelBackend> available = available_kernel_backends();
+    if (std::find(available.begin(), available.end(), GetParam()) == available.end())
+      GTEST_SKIP() << to_string(GetParam()) << " is not supported by this CPU";
+  }
+
+  // empty rows, widths that leave a scalar tail and long rows
+  unsigned int width(const int iteration) {
+    return iteration < 40 ? iteration : byte() * 4 + byte() % 64;
+  }
+
+  // start addresses off the vector alignment
+  unsigned int offset() {
+    return byte() % 16;
+  }
+
+  uint8_t byte() {
+    return uint8_t(dist_(rng_));
+  }
+
+  static constexpr int iterations = 256;
+
+  const Kernels &reference_ = *kernels_scalar();
+  const Kernels *candidate_ = nullptr;
+
+  // fixed seed, a failure has to be reproducible
+  std::mt19937                            rng_{0x5eed};
+  std::uniform_int_distribution<uint32_t> dist_{0, 255};
+};
+
+TEST_P(KernelsTest, CopyRows) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int         w        = width(iteration);
+    const unsigned int         height   = 1 + byte() % 8;
+    const std::size_t          src_step = w + offset();
+    const std::vector<uint8_t> src      = random_vector<uint8_t>(rng_, src_step * height);
+    std::vector<uint8_t>       out_ref(std::size_t(w) * height), out(std::size_t(w) * height);
+
+    reference_.copy_rows(src.data(), src_step, out_ref.data(), w, w, height);
+    candidate_->copy_rows(src.data(), src_step, out.data(), w, w, height);
+    ASSERT_EQ(out, out_ref) << "width " << w;
+  }
+}
+
+TEST_P(KernelsTest, SubtractRowU8) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int         w   = width(iteration);
+    const unsigned int         o   = offset();
+    const uint8_t              a   = byte();
+    const uint8_t              b   = byte();
+    const std::vector<uint8_t> src = random_vector<uint8_t>(rng_, w + o);
+    std::vector<uint8_t>       out_ref(w), out(w);
+
+    reference_.subtract_row_u8(src.data() + o, out_ref.data(), w, a, b);
+    candidate_->subtract_row_u8(src.data() + o, out.data(), w, a, b);
+    ASSERT_EQ(out, out_ref) << "width " << w;
+  }
+}
+
+TEST_P(KernelsTest, SubtractRowU16) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int          w   = width(iteration);
+    const unsigned int          o   = offset();
+    const uint16_t              a   = uint16_t(byte() << 8 | byte());
+    const uint16_t              b   = uint16_t(byte() << 8 | byte());
+    const std::vector<uint16_t> src = random_vector<uint16_t>(rng_, w + o);
+    std::vector<uint16_t>       out_ref(w), out(w);
+
+    reference_.subtract_row_u16(src.data() + o, out_ref.data(), w, a, b);
+    candidate_->subtract_row_u16(src.data() + o, out.data(), w, a, b);
+    ASSERT_EQ(out, out_ref) << "width " << w;
+  }
+}
+
+TEST_P(KernelsTest, BlendRowU8) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int w = width(iteration);
+    const unsigned int o = offset();
+
+    // same parameter derivation as TemporalDenoise
+    const uint8_t  strength  = uint8_t(byte() * 243 / 255);
+    const uint8_t  threshold = uint8_t(1 + byte() % 255);
+    const uint16_t slope     = uint16_t((strength * 16 + threshold / 2) / threshold);
+
+    const std::vector<uint8_t> src     = random_vector<uint8_t>(rng_, w + o);
+    std::vector<uint8_t>       history = random_vector<uint8_t>(rng_, w);
+    std::vector<uint8_t>       history_ref(history), out_ref(w), out(w);
+
+    reference_.blend_row_u8(src.data() + o, out_ref.data(), history_ref.data(), w, strength, threshold, slope);
+    candidate_->blend_row_u8(src.data() + o, out.data(), history.data(), w, strength, threshold, slope);
+    ASSERT_EQ(out, out_ref) << "width " << w;
+    ASSERT_EQ(history, history_ref) << "width " << w;
+  }
+}
+
+TEST_P(KernelsTest, ApplyLutRow) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int w        = width(iteration);
+    const unsigned int o        = offset();
+    const unsigned int size     = 2 + byte() % 32;
+    const unsigned int channels = 3 + byte() % 2;
+    const bool         bgr      = byte() % 2;
+
+    // grid values up to the full fixed-point range
+    std::vector<uint16_t> table(3 * size * size * size);
+    for (uint16_t &e : table)
+      e = uint16_t(byte() * (255 << 8) / 255);
+    const ColorLut3D lut = make_color_lut(size, std::move(table));
+
+    const std::vector<uint8_t> src = random_vector<uint8_t>(rng_, std::size_t(w) * channels + o);
+    std::vector<uint8_t>       out_ref(std::size_t(w) * channels), out(std::size_t(w) * channels);
+    std::vector<uint8_t>       in_place(src.begin() + o, src.end());
+
+    reference_.apply_lut_row(lut, src.data() + o, out_ref.data(), w, channels, bgr);
+    candidate_->apply_lut_row(lut, src.data() + o, out.data(), w, channels, bgr);
+    ASSERT_EQ(out, out_ref) << "width " << w << ", " << channels << " channels";
+
+    // in place as well, the output may overwrite the input row
+    candidate_->apply_lut_row(lut, in_place.data(), in_place.data(), w, channels, bgr);
+    ASSERT_EQ(in_place, out_ref) << "in place, width " << w << ", " << channels << " channels";
+  }
+}
+
+TEST_P(KernelsTest, LerpRowsU8) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int         w      = width(iteration);
+    const unsigned int         o      = offset();
+    const uint16_t             weight = iteration % 3 ? byte() : (iteration % 2) * 256;  // including both ends
+    const std::vector<uint8_t> row0   = random_vector<uint8_t>(rng_, w + o);
+    const std::vector<uint8_t> row1   = random_vector<uint8_t>(rng_, w + o);
+    std::vector<uint16_t>      out_ref(w), out(w);
+
+    reference_.lerp_rows_u8(row0.data() + o, row1.data() + o, out_ref.data(), w, weight);
+    candidate_->lerp_rows_u8(row0.data() + o, row1.data() + o, out.data(), w, weight);
+    ASSERT_EQ(out, out_ref) << "width " << w << ", weight " << weight;
+  }
+}
+
+TEST_P(KernelsTest, AccumulateRowU8) {
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int          w    = width(iteration);
+    const unsigned int          o    = offset();
+    const std::vector<uint8_t>  src  = random_vector<uint8_t>(rng_, w + o);
+    const std::vector<uint32_t> sums = random_vector<uint32_t>(rng_, w);
+    std::vector<uint32_t>       out_ref(sums), out(sums);
+
+    // sums close to the limit of 32 bits wrap the same way
+    reference_.accumulate_row_u8(src.data() + o, out_ref.data(), w);
+    candidate_->accumulate_row_u8(src.data() + o, out.data(), w);
+    ASSERT_EQ(out, out_ref) << "width " << w;
+  }
+}
+
+TEST_P(KernelsTest, NormalizeRowF32) {
+  std::uniform_real_distribution<float> factor(-0.1f, 0.1f);
+
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    const unsigned int          w   = width(iteration);
+    const unsigned int          o   = offset();
+    const std::vector<uint16_t> src = random_vector<uint16_t>(rng_, w + o);
+    std::vector<float>          scale(w), offset(w), out_ref(w), out(w);
+    for (unsigned int i = 0; i < w; i++) {
+      scale[i]  = factor(rng_);
+      offset[i] = factor(rng_) * 255;
+    }
+
+    // bit-exact, a multiply-add that is not fused rounds twice and differs
+    reference_.normalize_row_f32(src.data() + o, out_ref.data(), w, scale.data(), offset.data());
+    candidate_->normalize_row_f32(src.data() + o, out.data(), w, scale.data(), offset.data());
+    ASSERT_EQ(out, out_ref) << "width " << w;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, KernelsTest, ::testing::Values(KernelBackend::SSE4, KernelBackend::AVX2, KernelBackend::NEON),
+                         [](const ::testing::TestParamInfo<KernelBackend> &info) { return to_string(info.param); });
+
+TEST(KernelSelection, SelectsAvailableBackends) {
+  for (const KernelBackend backend : available_kernel_backends()) {
+    select_kernel_backend(to_string(backend));
+    EXPECT_EQ(kernels().backend, backend);
+  }
+
+  EXPECT_THROW(select_kernel_backend("mmx"), std::runtime_error);
+
+  // the widest one, listed last
+  select_kernel_backend("auto");
+  EXPECT_EQ(kernels().backend, available_kernel_backends().back());
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,253 @@
+// the MJPEG preview served to a local HTTP client: the multipart stream and the snapshot with their headers and
+// the published JPEG frames, the rejected requests, and the JPEG buffers of the encoder that are reused once released
+
+#include <libcamera_ros_driver/utils/mjpeg_server.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <gtest/gtest.h>
+
+// blocking HTTP client on the loopback interface, every read fails after a timeout instead of hanging the test
+class HttpClient {
+public:
+  HttpClient(const uint16_t port, const std::string &path) {
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    const timeval timeout = {5, 0};
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in addr     = {};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connected_           = connect(fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0;
+
+    const std::string request = "GET " + path + " HTTP/1.0\r\nHost: localhost\r\n\r\n";
+    connected_                = connected_ && send(fd_, request.data(), request.size(), MSG_NOSIGNAL) == ssize_t(request.size());
+  }
+
+  ~HttpClient() {
+    close(fd_);
+  }
+
+  bool connected() const {
+    return connected_;
+  }
+
+  // everything up to and including 'delimiter', empty on timeout or when the server closes the connection first
+  std::string readUntil(const std::string &delimiter) {
+    while (buffer_.find(delimiter) == std::string::npos) {
+      if (!receive())
+        return {};
+    }
+
+    const std::size_t end  = buffer_.find(delimiter) + delimiter.size();
+    const std::string text = buffer_.substr(0, end);
+    buffer_.erase(0, end);
+    return text;
+  }
+
+  // exactly 'length' bytes, fewer on timeout or when the server closes the connection
+  std::string read(const std::size_t length) {
+    while (buffer_.size() < length) {
+      if (!receive())
+        break;
+    }
+
+    const std::string data = buffer_.substr(0, length);
+    buffer_.erase(0, data.size());
+    return data;
+  }
+
+private:
+  bool receive() {
+    char          chunk[4096];
+    const ssize_t received = recv(fd_, chunk, sizeof(chunk), 0);
+    if (received <= 0)
+      return false;
+    buffer_.append(chunk, received);
+    return true;
+  }
+
+  int         fd_        = -1;
+  bool        connected_ = false;
+  std::string buffer_;
+};
+
+// value of a header in a block of headers, empty if it is missing
+static std::string
+header_value(const std::string &headers, const std::string &name)
+{
+  const std::size_t start = headers.find("\r\n" + name + ": ");
+  if (start == std::string::npos)
+    return {};
+
+  const std::size_t value = start + name.size() + 4;
+  return headers.substr(value, headers.find("\r\n", value) - value);
+}
+
+static bool
+is_jpeg(const std::string &data)
+{
+  return data.size() > 4 && uint8_t(data[0]) == 0xFF && uint8_t(data[1]) == 0xD8 && uint8_t(data[data.size() - 2]) == 0xFF &&
+         uint8_t(data[data.size() - 1]) == 0xD9;
+}
+
+// publishes the frame to the server until it is stopped, a client only gets the frames published after its request
+class MjpegServerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    server_ = std::make_unique<MjpegServer>("127.0.0.1", 0, 2);
+    ASSERT_NE(server_->port(), 0);
+
+    // an encoded gradient, a buffer with the JPEG markers without libjpeg, the server does not look into the frames
+    if (PreviewEncoder::available()) {
+      constexpr unsigned int width = 64, height = 48;
+      std::vector<uint8_t>   image(width * height * 3);
+      for (std::size_t i = 0; i < image.size(); i++)
+        image[i] = uint8_t(i * 7);
+
+      PreviewEncoder encoder(32, 80);
+      frame_ = encoder.encode(image.data(), width * 3, width, height, sensor_msgs::image_encodings::RGB8);
+    } else {
+      frame_ = std::make_shared<const std::vector<uint8_t>>(std::vector<uint8_t>{0xFF, 0xD8, 0xFF, 0xE0, 1, 2, 3, 0xFF, 0xD9});
+    }
+
+    publisher_ = std::thread([this] {
+      while (!stop_) {
+        server_->publish(frame_);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    });
+  }
+
+  void TearDown() override {
+    stop_ = true;
+    if (publisher_.joinable())
+      publisher_.join();
+    server_.reset();
+  }
+
+  std::string frame() const {
+    return std::string(frame_->begin(), frame_->end());
+  }
+
+  std::unique_ptr<MjpegServer>                server_;
+  std::shared_ptr<const std::vector<uint8_t>> frame_;
+  std::thread                                 publisher_;
+  std::atomic<bool>                           stop_{false};
+};
+
+TEST_F(MjpegServerTest, StreamsMultipartJpegFrames) {
+  HttpClient client(server_->port(), "/stream");
+  ASSERT_TRUE(client.connected());
+
+  const std::string headers = client.readUntil("\r\n\r\n");
+  ASSERT_FALSE(headers.empty());
+  EXPECT_EQ(headers.substr(0, headers.find("\r\n")), "HTTP/1.0 200 OK");
+  EXPECT_EQ(header_value(headers, "Content-Type"), "multipart/x-mixed-replace; boundary=frame");
+
+  // every part is a complete frame behind the boundary
+  for (int i = 0; i < 3; i++) {
+    SCOPED_TRACE("part " + std::to_string(i));
+
+    const std::string part = client.readUntil("\r\n\r\n");
+    ASSERT_EQ(part.substr(0, part.find("\r\n")), "--frame");
+    EXPECT_EQ(header_value(part, "Content-Type"), "image/jpeg");
+
+    const std::string length = header_value(part, "Content-Length");
+    ASSERT_EQ(length, std::to_string(frame_->size()));
+
+    const std::string data = client.read(std::stoul(length));
+    EXPECT_TRUE(is_jpeg(data));
+    EXPECT_EQ(data, frame());
+    EXPECT_EQ(client.read(2), "\r\n");
+  }
+
+  EXPECT_EQ(server_->clients(), 1u);
+}
+
+TEST_F(MjpegServerTest, ServesASnapshot) {
+  HttpClient client(server_->port(), "/snapshot?cache=0");
+  ASSERT_TRUE(client.connected());
+
+  const std::string headers = client.readUntil("\r\n\r\n");
+  ASSERT_FALSE(headers.empty());
+  EXPECT_EQ(headers.substr(0, headers.find("\r\n")), "HTTP/1.0 200 OK");
+  EXPECT_EQ(header_value(headers, "Content-Type"), "image/jpeg");
+  ASSERT_EQ(header_value(headers, "Content-Length"), std::to_string(frame_->size()));
+
+  const std::string data = client.read(frame_->size() + 1);
+  EXPECT_TRUE(is_jpeg(data));
+  EXPECT_EQ(data, frame());
+}
+
+TEST_F(MjpegServerTest, RejectsOtherPathsAndTooManyClients) {
+  {
+    HttpClient client(server_->port(), "/index.html");
+    ASSERT_TRUE(client.connected());
+    const std::string headers = client.readUntil("\r\n\r\n");
+    EXPECT_EQ(headers.substr(0, headers.find("\r\n")), "HTTP/1.0 404 Not Found");
+  }
+
+  // two streams are served, the third client is turned away
+  HttpClient first(server_->port(), "/stream");
+  HttpClient second(server_->port(), "/");
+  ASSERT_FALSE(first.readUntil("\r\n\r\n").empty());
+  ASSERT_FALSE(second.readUntil("\r\n\r\n").empty());
+
+  HttpClient        third(server_->port(), "/stream");
+  const std::string headers = third.readUntil("\r\n\r\n");
+  EXPECT_EQ(headers.substr(0, headers.find("\r\n")), "HTTP/1.0 503 Service Unavailable");
+}
+
+TEST(PreviewEncoder, ReusesReleasedBuffers) {
+  if (!PreviewEncoder::available())
+    GTEST_SKIP() << "built without libjpeg";
+
+  constexpr unsigned int width = 640, height = 480;
+  std::vector<uint8_t>   image(width * height);
+  for (std::size_t i = 0; i < image.size(); i++)
+    image[i] = uint8_t(i % width);
+
+  PreviewEncoder encoder(160, 75, 2);
+
+  const auto encode = [&] { return encoder.encode(image.data(), width, width, height, sensor_msgs::image_encodings::MONO8); };
+
+  // released buffers are taken in turn
+  const std::vector<uint8_t> *first  = encode().get();
+  const std::vector<uint8_t> *second = encode().get();
+  EXPECT_NE(first, second);
+  EXPECT_EQ(encode().get(), first);
+
+  // the buffers still held by the server are not touched, with both of them held a buffer outside of the pool is used
+  const std::shared_ptr<const std::vector<uint8_t>> held_a = encode();
+  const std::shared_ptr<const std::vector<uint8_t>> held_b = encode();
+  const std::shared_ptr<const std::vector<uint8_t>> extra  = encode();
+  EXPECT_NE(held_a, held_b);
+  EXPECT_NE(extra.get(), first);
+  EXPECT_NE(extra.get(), second);
+
+  for (const std::shared_ptr<const std::vector<uint8_t>> &jpeg : {held_a, held_b, extra})
+    EXPECT_TRUE(is_jpeg(std::string(jpeg->begin(), jpeg->end())));
+  EXPECT_EQ(*held_a, *extra);
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
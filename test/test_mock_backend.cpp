@@ -0,0 +1,302 @@
+// the mock camera that the driver, the launch files and the benchmarks run on: the layout of the frames it
+// delivers with padded rows, the accounting of the injected drops and cancellations, and a camera that fails to start
+
+#include <libcamera_ros_driver/utils/mock_backend.h>
+#include <libcamera_ros_driver/utils/format_mapping.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <libcamera/formats.h>
+
+#include <gtest/gtest.h>
+
+// frames and cancellations delivered by a backend, checked on its thread as the data is only valid during the call
+class FrameSink {
+public:
+  explicit FrameSink(const StreamInfo &stream, const unsigned int buffers) : stream_(stream), buffers_(buffers) {
+  }
+
+  CameraBackend::FrameCallback onFrame() {
+    return [this](const FrameView &frame) {
+      const bool valid = check(frame);
+
+      std::scoped_lock lock(mutex_);
+      frames_.insert(frame.sequence);
+      invalid_ += !valid;
+      cv_.notify_all();
+    };
+  }
+
+  CameraBackend::CancelCallback onCancel() {
+    return [this](const std::string &reason) {
+      unsigned long long sequence = 0;
+
+      std::scoped_lock lock(mutex_);
+      if (std::sscanf(reason.c_str(), "request %llu cancelled", &sequence) == 1) {
+        cancelled_.insert(sequence);
+      } else {
+        unparsed_++;
+      }
+      cv_.notify_all();
+    };
+  }
+
+  // false on timeout
+  bool waitForFrames(const std::size_t count, const std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    std::unique_lock lock(mutex_);
+    return cv_.wait_for(lock, timeout, [&] { return frames_.size() >= count; });
+  }
+
+  std::set<uint64_t> frames() {
+    std::scoped_lock lock(mutex_);
+    return frames_;
+  }
+
+  std::set<uint64_t> cancelled() {
+    std::scoped_lock lock(mutex_);
+    return cancelled_;
+  }
+
+  unsigned int invalid() {
+    std::scoped_lock lock(mutex_);
+    return invalid_;
+  }
+
+  unsigned int unparsed() {
+    std::scoped_lock lock(mutex_);
+    return unparsed_;
+  }
+
+private:
+  // the gradient the mock camera fills its buffers with, the row padding is zero
+  bool check(const FrameView &frame) const {
+    if (frame.size != stream_.frame_bytes)
+      return false;
+
+    const unsigned int row_bytes = stream_.size.width * get_bytes_per_pixel(stream_.format);
+    const std::size_t  buffer    = frame.sequence % buffers_;
+
+    for (unsigned int y = 0; y < stream_.size.height; y++) {
+      const uint8_t *row = frame.data + std::size_t(y) * stream_.stride;
+      for (unsigned int i = 0; i < stream_.stride; i++) {
+        if (row[i] != (i < row_bytes ? uint8_t(i + y + buffer * 8) : 0))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  const StreamInfo   stream_;
+  const unsigned int buffers_;
+
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  std::set<uint64_t>      frames_;
+  std::set<uint64_t>      cancelled_;
+  unsigned int            invalid_  = 0;
+  unsigned int            unparsed_ = 0;
+};
+
+static StreamRequest
+stream_request(const libcamera::PixelFormat &format, const libcamera::Size &size)
+{
+  StreamRequest request;
+  request.pixel_format = format.toString();
+  request.size         = size;
+  return request;
+}
+
+// the first frame comes after the default frame duration, the following ones after 'period'
+static void
+set_frame_duration(MockBackend &backend, const int64_t period)
+{
+  ControlCommandValues values;
+  values.set[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)]    = true;
+  values.values[std::size_t(ControlSlot::FRAME_DURATION_LIMITS)] = {double(period), double(period)};
+  backend.queueControls(values);
+}
+
+TEST(MockBackend, PadsRowsToTheStrideAlignment) {
+  struct Case
+  {
+    libcamera::PixelFormat format;
+    libcamera::Size        size;
+    unsigned int           alignment;
+  };
+
+  // rows that are already aligned, rows with padding, and no alignment at all
+  const std::vector<Case> cases = {
+      {libcamera::formats::RGB888, {64, 8}, 64},   {libcamera::formats::RGB888, {101, 7}, 64}, {libcamera::formats::RGB888, {101, 7}, 256},
+      {libcamera::formats::SRGGB16, {33, 5}, 32},  {libcamera::formats::R8, {17, 3}, 16},       {libcamera::formats::RGB888, {101, 7}, 0},
+      {libcamera::formats::XRGB8888, {13, 4}, 128},
+  };
+
+  for (const Case &c : cases) {
+    SCOPED_TRACE(c.format.toString() + " " + std::to_string(c.size.width) + "x" + std::to_string(c.size.height) + ", alignment " +
+                 std::to_string(c.alignment));
+
+    MockBackendOptions options;
+    options.formats          = {c.format};
+    options.stride_alignment = c.alignment;
+    options.buffers          = 3;
+    MockBackend backend(options);
+
+    const StreamInfo   stream    = backend.configure(stream_request(c.format, c.size));
+    const unsigned int row_bytes = c.size.width * get_bytes_per_pixel(c.format);
+    const unsigned int alignment = std::max(c.alignment, 1u);
+
+    EXPECT_EQ(stream.format, c.format);
+    EXPECT_EQ(stream.size.width, c.size.width);
+    EXPECT_EQ(stream.size.height, c.size.height);
+    EXPECT_EQ(stream.stride % alignment, 0u);
+    EXPECT_GE(stream.stride, row_bytes);
+    EXPECT_LT(stream.stride - row_bytes, alignment);
+    EXPECT_EQ(stream.frame_bytes, std::size_t(stream.stride) * c.size.height);
+
+    set_frame_duration(backend, 2000);
+
+    FrameSink sink(stream, options.buffers);
+    backend.start(sink.onFrame(), sink.onCancel());
+    const bool delivered = sink.waitForFrames(2 * options.buffers);
+    backend.stop();
+
+    ASSERT_TRUE(delivered);
+    EXPECT_EQ(sink.invalid(), 0u);
+    EXPECT_TRUE(sink.cancelled().empty());
+  }
+}
+
+TEST(MockBackend, SelectsTheDefaultSizeAndRejectsOtherFormats) {
+  MockBackendOptions options;
+  options.formats      = {libcamera::formats::RGB888};
+  options.default_size = {320, 240};
+  MockBackend backend(options);
+
+  const StreamInfo stream = backend.configure(stream_request(libcamera::formats::RGB888, {}));
+  EXPECT_EQ(stream.size.width, 320u);
+  EXPECT_EQ(stream.size.height, 240u);
+
+  EXPECT_THROW(backend.configure(stream_request(libcamera::formats::R8, {64, 64})), std::runtime_error);
+}
+
+TEST(MockBackend, CountsInjectedDropsAndCancellations) {
+  MockBackendOptions options;
+  options.formats     = {libcamera::formats::R8};
+  options.drop_rate   = 0.2;
+  options.cancel_rate = 0.1;
+  options.seed        = 7;
+  MockBackend backend(options);
+
+  const StreamInfo stream = backend.configure(stream_request(libcamera::formats::R8, {32, 4}));
+  set_frame_duration(backend, 2000);
+
+  FrameSink sink(stream, options.buffers);
+  backend.start(sink.onFrame(), sink.onCancel());
+  const bool delivered = sink.waitForFrames(300, std::chrono::seconds(30));
+  backend.stop();
+
+  ASSERT_TRUE(delivered);
+  EXPECT_EQ(sink.invalid(), 0u);
+  ASSERT_EQ(sink.unparsed(), 0u);
+
+  // every sequence number is either delivered, cancelled or a gap, never both delivered and cancelled
+  const std::set<uint64_t> frames    = sink.frames();
+  const std::set<uint64_t> cancelled = sink.cancelled();
+  for (const uint64_t sequence : cancelled)
+    EXPECT_EQ(frames.count(sequence), 0u) << "sequence " << sequence << " is delivered and cancelled";
+
+  const uint64_t last  = std::max(*frames.rbegin(), cancelled.empty() ? 0 : *cancelled.rbegin());
+  const double   total = double(last + 1);
+  const double   drops = total - frames.size() - cancelled.size();
+
+  // the rates are probabilities, a loaded machine can only add gaps of late frames
+  EXPECT_GT(drops / total, 0.1);
+  EXPECT_LT(drops / total, 0.4);
+  EXPECT_GT(cancelled.size() / (total - drops), 0.03);
+  EXPECT_LT(cancelled.size() / (total - drops), 0.2);
+}
+
+TEST(MockBackend, CancelsNothingWithoutInjectedFailures) {
+  MockBackendOptions options;
+  options.formats = {libcamera::formats::R8};
+  MockBackend backend(options);
+
+  const StreamInfo stream = backend.configure(stream_request(libcamera::formats::R8, {32, 4}));
+  set_frame_duration(backend, 5000);
+
+  FrameSink sink(stream, options.buffers);
+  backend.start(sink.onFrame(), sink.onCancel());
+  const bool delivered = sink.waitForFrames(50);
+  backend.stop();
+
+  ASSERT_TRUE(delivered);
+  EXPECT_TRUE(sink.cancelled().empty());
+  EXPECT_EQ(*sink.frames().begin(), 0u);
+}
+
+TEST(MockBackend, FailsToStartAndRecovers) {
+  MockBackendOptions options;
+  options.formats    = {libcamera::formats::RGB888, libcamera::formats::R8};
+  options.fail_start = true;
+  MockBackend failing(options);
+
+  StreamInfo stream = failing.configure(stream_request(libcamera::formats::RGB888, {64, 8}));
+  set_frame_duration(failing, 2000);
+
+  // no callback is ever called, stopping the camera that did not start returns
+  FrameSink sink(stream, options.buffers);
+  EXPECT_THROW(failing.start(sink.onFrame(), sink.onCancel()), std::runtime_error);
+  EXPECT_FALSE(sink.waitForFrames(1, std::chrono::seconds(1)));
+  failing.stop();
+
+  // it can be reconfigured and fails again like a camera that stays broken
+  stream = failing.configure(stream_request(libcamera::formats::R8, {64, 8}));
+  EXPECT_EQ(stream.format, libcamera::formats::R8);
+  EXPECT_THROW(failing.start(sink.onFrame(), sink.onCancel()), std::runtime_error);
+  failing.stop();
+  EXPECT_TRUE(sink.frames().empty());
+  EXPECT_TRUE(sink.cancelled().empty());
+
+  // a working camera is restarted with another format like on a reconfiguration of the driver, the sequence
+  // numbers start over and the frames have the new layout
+  options.fail_start = false;
+  MockBackend backend(options);
+
+  stream = backend.configure(stream_request(libcamera::formats::RGB888, {64, 8}));
+  set_frame_duration(backend, 2000);
+  {
+    FrameSink first(stream, options.buffers);
+    backend.start(first.onFrame(), first.onCancel());
+    const bool delivered = first.waitForFrames(5);
+    backend.stop();
+    ASSERT_TRUE(delivered);
+    EXPECT_EQ(first.invalid(), 0u);
+  }
+
+  stream = backend.configure(stream_request(libcamera::formats::R8, {50, 6}));
+  set_frame_duration(backend, 2000);
+  {
+    FrameSink second(stream, options.buffers);
+    backend.start(second.onFrame(), second.onCancel());
+    const bool delivered = second.waitForFrames(5);
+    backend.stop();
+    ASSERT_TRUE(delivered);
+    EXPECT_EQ(second.invalid(), 0u);
+    EXPECT_EQ(*second.frames().begin(), 0u);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
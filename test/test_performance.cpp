@@ -0,0 +1,129 @@
+// rostest node next to the driver running on the mock camera with profiling (test/performance.test): collects the
+// profiling reports the driver publishes after its warm-up and checks their numbers, no stage of the driver may
+// allocate and, with a recorded baseline, no stage may take more CPU time per frame than its threshold
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ros/ros.h>
+#include <libcamera_ros_driver/ProfilingReport.h>
+
+#include <gtest/gtest.h>
+
+class ProfilingReports {
+public:
+  explicit ProfilingReports(ros::NodeHandle &nh) {
+    sub_ = nh.subscribe("profiling", 10, &ProfilingReports::callback, this);
+  }
+
+  // reports after the warm-up of the driver
+  std::vector<libcamera_ros_driver::ProfilingReport> reports() {
+    std::scoped_lock lock(mutex_);
+    return reports_;
+  }
+
+private:
+  void callback(const libcamera_ros_driver::ProfilingReport::ConstPtr &msg) {
+    if (msg->warmup)
+      return;
+
+    std::scoped_lock lock(mutex_);
+    reports_.push_back(*msg);
+  }
+
+  ros::Subscriber                                    sub_;
+  std::mutex                                         mutex_;
+  std::vector<libcamera_ros_driver::ProfilingReport> reports_;
+};
+
+// the reports are collected once and checked by every test
+class Performance : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    int    reports = 3;
+    double timeout = 120.0;
+    pnh.getParam("reports", reports);
+    pnh.getParam("timeout", timeout);
+    pnh.getParam("baseline", baseline_);
+
+    ProfilingReports profiling(nh);
+
+    const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+    while (ros::ok() && profiling.reports().size() < std::size_t(reports) && ros::WallTime::now() < deadline) {
+      ros::spinOnce();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    reports_ = profiling.reports();
+    if (reports_.size() < std::size_t(reports))
+      missing_ = "the driver published " + std::to_string(reports_.size()) + " of " + std::to_string(reports) + " profiling reports within " +
+                 std::to_string(timeout) + " s";
+  }
+
+  void SetUp() override {
+    ASSERT_TRUE(missing_.empty()) << missing_;
+  }
+
+  static inline std::vector<libcamera_ros_driver::ProfilingReport> reports_;
+  static inline std::string                                        missing_;
+  static inline bool                                               baseline_ = false;
+};
+
+TEST_F(Performance, StagesDoNotAllocate) {
+  for (const libcamera_ros_driver::ProfilingReport &report : reports_) {
+    ASSERT_TRUE(report.counts_allocations) << "the allocation counter is not preloaded into the driver";
+    ASSERT_FALSE(report.stages.empty());
+
+    for (const libcamera_ros_driver::StageProfile &profile : report.stages) {
+      SCOPED_TRACE("stage " + profile.stage + " of the report at " + std::to_string(report.header.stamp.toSec()));
+
+      EXPECT_GT(profile.frames, 0u);
+      EXPECT_GT(profile.ms_per_frame, 0.0);
+
+      // publishing allocates inside of roscpp and the transport plugins
+      if (profile.stage != "publish" && profile.stage != "total") {
+        EXPECT_EQ(profile.allocations_per_frame, 0.0);
+        EXPECT_FALSE(profile.allocates);
+      }
+    }
+  }
+}
+
+TEST_F(Performance, StagesKeepTheirBaseline) {
+  if (!baseline_)
+    GTEST_SKIP() << "no baseline recorded for this configuration, record one with scripts/performance_check.sh record";
+
+  for (const libcamera_ros_driver::ProfilingReport &report : reports_) {
+    ASSERT_TRUE(report.has_baseline) << "the driver did not load the baseline";
+    EXPECT_GT(report.machine_speed, 0.0);
+
+    bool checked = false;
+    for (const libcamera_ros_driver::StageProfile &profile : report.stages) {
+      if (profile.threshold_ms_per_frame <= 0.0)
+        continue;
+
+      SCOPED_TRACE("stage " + profile.stage + " of the report at " + std::to_string(report.header.stamp.toSec()));
+      checked = true;
+
+      EXPECT_LE(profile.ms_per_frame, profile.threshold_ms_per_frame)
+          << "baseline " << profile.baseline_ms_per_frame << " ms/frame on this machine, tolerance " << report.tolerance * 100.0 << " %";
+      EXPECT_FALSE(profile.regressed);
+    }
+
+    EXPECT_TRUE(checked) << "the baseline has none of the profiled stages";
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_performance");
+  return RUN_ALL_TESTS();
+}